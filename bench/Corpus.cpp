@@ -0,0 +1,205 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include "Corpus.h"
+
+// Bits of names, so identifiers repeat about as often as they do in real code.
+static const char* const Words[] = {
+  "Player", "Vehicle", "Object", "Pos", "Health", "Armour", "Name", "Text", "Draw", "Timer",
+  "Dynamic", "Area", "Zone", "Weapon", "Skin", "Team", "Score", "Money", "Interior", "World",
+  "Camera", "Pickup", "Checkpoint", "Label", "Menu", "Dialog", "Gang", "House", "Business", "Job",
+};
+static const char* const Verbs[] = {
+  "Get", "Set", "Create", "Destroy", "Is", "Give", "Reset", "Show", "Hide", "Update", "Attach",
+};
+static const char* const Tags[] = { "", "", "", "Float:", "bool:", "Text:", "PlayerText:" };
+
+quint32 corpus_random_s::next() {
+  // Numerical Recipes' LCG, with the top bits being the good ones.
+  State = State * 1664525u + 1013904223u;
+  return State >> 8;
+}
+
+int corpus_random_s::below(int n) {
+  return static_cast<int>(next() % static_cast<quint32>(n));
+}
+
+template <typename T, int N>
+static const char* pick(corpus_random_s &random, T (&words)[N]) {
+  return words[random.below(N)];
+}
+
+static QString identifier(corpus_random_s &random, bool verb) {
+  QString name = verb ? pick(random, Verbs) : "";
+  for (int parts = 1 + random.below(3); parts--; ) {
+    name += pick(random, Words);
+  }
+  return name;
+}
+
+static QString number(corpus_random_s &random) {
+  int whole = random.below(20000) - 10000;
+  int fraction = random.below(10000);
+  return QString("%1.%2").arg(whole).arg(fraction, 4, 10, QChar('0'));
+}
+
+// Every draw is a statement of its own: the order arguments are worked out in isn't fixed, and
+// two of them in one expression would make different text with different compilers.
+
+QString Corpus::script(int lines, quint32 seed) {
+  corpus_random_s random { seed };
+  QStringList out;
+  out << "#include <open.mp>" << "#include <streamer>" << "" << "#define MAX_GANGS (32)" << "";
+  while (out.size() < lines) {
+    QString name = identifier(random, true);
+    QString variable = identifier(random, false).toLower();
+    QString system = identifier(random, false);
+    out << QString("// %1 for the %2 system.").arg(name, system);
+    if (random.below(2)) {
+      out << QString("forward On%1(playerid, Float:amount);").arg(name);
+      out << QString("public On%1(playerid, Float:amount)").arg(name);
+    } else {
+      QString tag = pick(random, Tags);
+      int value = random.below(100);
+      out << QString("stock %1%2(playerid, const %3[], value = %4)").arg(tag, name, variable).arg(value);
+    }
+    out << "{";
+    QString initial = number(random);
+    out << QString("\tnew string[128], Float:%1 = %2;").arg(variable, initial);
+    for (int statements = 2 + random.below(6); statements--; ) {
+      QString first = identifier(random, true);
+      QString second = identifier(random, true);
+      QString noun = identifier(random, false);
+      QString x = number(random);
+      QString y = number(random);
+      switch (random.below(5)) {
+      case 0:
+        out << QString("\tif (%1(playerid) && %2 > %3)").arg(first, variable, x);
+        out << "\t{";
+        out << QString("\t\tformat(string, sizeof (string), \"%1 %d has %.2f\", playerid, %2);")
+               .arg(noun, variable);
+        out << QString("\t\tSendClientMessage(playerid, 0x%1, string);").arg(random.next(), 8, 16, QChar('0'));
+        out << "\t}";
+        break;
+      case 1:
+        out << "\t/*";
+        out << QString("\t * %1 needs to happen before %2.").arg(first, second);
+        out << "\t */";
+        break;
+      case 2:
+        out << QString("\tfor (new i = 0; i != MAX_GANGS; ++i) %1[i] += %2;").arg(variable, y);
+        break;
+      case 3:
+        out << QString("\t%1(playerid, %2, %3, '\\n'); // %4").arg(first, x, y, noun);
+        break;
+      default:
+        out << QString("\t#if defined %1").arg(noun.toUpper());
+        out << QString("\t\treturn %1(playerid);").arg(second);
+        out << "\t#endif";
+        break;
+      }
+    }
+    out << "\treturn 1;" << "}" << "";
+  }
+  out.erase(out.begin() + lines, out.end());
+  return out.join('\n');
+}
+
+QString Corpus::map(int lines, quint32 seed) {
+  corpus_random_s random { seed };
+  QStringList out;
+  while (out.size() < lines) {
+    QStringList numbers;
+    numbers << QString::number(615 + random.below(19000));
+    for (int i = 0; i != 6; ++i) {
+      numbers << number(random);
+    }
+    out << QString("CreateDynamicObject(%1, -1, -1, -1, 300.0, 300.0);").arg(numbers.join(", "));
+  }
+  return out.join('\n');
+}
+
+static QString prototype(corpus_random_s &random) {
+  QString tag = pick(random, Tags);
+  QString out = tag + identifier(random, true) + "(";
+  for (int parameters = random.below(6), i = 0; i != parameters; ++i) {
+    if (i) {
+      out += ", ";
+    }
+    int kind = random.below(6);
+    QString name = identifier(random, false).toLower();
+    switch (kind) {
+    case 0:
+      out += "playerid";
+      break;
+    case 1:
+      out += QString("const %1[]").arg(name);
+      break;
+    case 2:
+      out += QString("&Float:%1").arg(name);
+      break;
+    case 3:
+      out += QString("Float:%1 = ").arg(name) + number(random);
+      break;
+    case 4:
+      out += QString("%1[%2] = \"\"").arg(name).arg(16 + random.below(128));
+      break;
+    default:
+      out += QString("bool:%1 = false").arg(name);
+      break;
+    }
+  }
+  if (random.below(10) == 0) {
+    out += "{Float, _}:...";
+  }
+  return out + ")";
+}
+
+QVector<corpus_include_s> Corpus::includes(int files, int nativesPerFile, quint32 seed) {
+  corpus_random_s random { seed };
+  QVector<corpus_include_s> out;
+  for (int file = 0; file != files; ++file) {
+    QString name = QString("omp_%1").arg(identifier(random, false).toLower());
+    QStringList text;
+    text << QString("#if defined _INC_%1").arg(name) << "\t#endinput" << "#endif"
+         << QString("#define _INC_%1").arg(name) << "" << QString("native #%1();").arg(name) << "";
+    for (int i = 0; i != nativesPerFile; ++i) {
+      QString verb = identifier(random, true);
+      QString noun = identifier(random, false);
+      text << "/**" << " * <library>" + name + "</library>"
+           << QString(" * <summary>%1 %2.</summary>").arg(verb, noun)
+           << " * <param name=\"playerid\">The ID of the player.</param>"
+           << " * <returns><b><c>true</c></b> - The function was executed successfully.</returns>"
+           << " * <remarks>Will always be called after the player has been created.</remarks>"
+           << " */"
+           << QString("native %1;").arg(prototype(random)) << "";
+    }
+    out.push_back({ QString("%1_%2.inc").arg(name).arg(file), text.join("\r\n") });
+  }
+  return out;
+}
+
+QStringList Corpus::prototypes(int count, quint32 seed) {
+  corpus_random_s random { seed };
+  QStringList out;
+  while (count--) {
+    out << prototype(random);
+  }
+  return out;
+}
+
+int Corpus::lineCount(const QString &text) {
+  return text.count('\n') + 1;
+}
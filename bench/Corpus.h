@@ -0,0 +1,57 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// A tiny random number generator, so every corpus is the same on every machine and every run (the
+// standard ones aren't guaranteed to be).
+struct corpus_random_s {
+  quint32 State;
+
+  quint32 next();
+  int below(int n);
+};
+
+struct corpus_include_s {
+  QString FileName;
+  QString Text;
+};
+
+// Synthetic Pawn, shaped like the real thing, for the benchmarks.  Everything comes from `seed`, so
+// two runs (or two commits) measure exactly the same input.
+class Corpus {
+ public:
+  // A script made of callbacks and stocks, with the usual mix of comments, strings, numbers, and
+  // preprocessor lines.
+  static QString script(int lines, quint32 seed);
+
+  // A map file: one long object call per line, almost entirely numbers.
+  static QString map(int lines, quint32 seed);
+
+  // A set of includes, mostly documentation comments around natives, like the open.mp ones.
+  static QVector<corpus_include_s> includes(int files, int nativesPerFile, quint32 seed);
+
+  // Native prototypes as they appear in the natives list, for `deprototype`.
+  static QStringList prototypes(int count, quint32 seed);
+
+  static int lineCount(const QString &text);
+};
+
+#endif // CORPUS_H
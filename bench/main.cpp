@@ -0,0 +1,314 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <functional>
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <stdio.h>
+
+#include <qawno.h>
+#include "Corpus.h"
+#include "src/MainWindow.h"
+#include "src/NativeScanner.h"
+#include "src/SearchEngine.h"
+#include "src/SyntaxHighlighter.h"
+
+// Micro-benchmarks for the parts of Qawno that run on every keypress or every file.  Prints JSON,
+// so runs from two commits can be compared:
+//
+//   qawno_bench --min-time 2000 --out before.json
+//
+static const quint32 Seed = 0x5157414E; // `QAWN`.
+
+struct bench_result_s {
+  QString Name;
+  qint64 Bytes;  // Of input, per iteration.
+  qint64 Items;  // Lines, files, or calls, per iteration.
+  int Iterations;
+  qint64 MinNs;
+  qint64 MedianNs;
+  qint64 MeanNs;
+};
+
+// Somewhere for results to go, so the compiler can't decide they aren't needed.
+static volatile qint64 Sink = 0;
+
+class Bench {
+ public:
+  Bench(const QString &filter, qint64 minTime)
+    : filter_(filter),
+      minTime_(minTime * 1000000)
+  {
+  }
+
+  // Runs `work` once to warm up, then again until it has taken at least the minimum time (and at
+  // least three times), timing each run.
+  void run(const QString &name, qint64 bytes, qint64 items, std::function<qint64()> work) {
+    if (!filter_.isEmpty() && !name.contains(filter_)) {
+      return;
+    }
+    fprintf(stderr, "%s...\n", qPrintable(name));
+    Sink += work();
+    QVector<qint64> times;
+    qint64 total = 0;
+    QElapsedTimer timer;
+    while (times.size() < 3 || (total < minTime_ && times.size() < 10000)) {
+      timer.start();
+      Sink += work();
+      qint64 elapsed = timer.nsecsElapsed();
+      times.push_back(elapsed);
+      total += elapsed;
+    }
+    std::sort(times.begin(), times.end());
+    results_.push_back({ name, bytes, items, times.size(), times.first(), times[times.size() / 2],
+                         total / times.size() });
+  }
+
+  QJsonArray results() const {
+    QJsonArray out;
+    for (auto const & result : results_) {
+      QJsonObject object;
+      object.insert("name", result.Name);
+      object.insert("bytes", result.Bytes);
+      object.insert("items", result.Items);
+      object.insert("iterations", result.Iterations);
+      object.insert("minNs", result.MinNs);
+      object.insert("medianNs", result.MedianNs);
+      object.insert("meanNs", result.MeanNs);
+      // The median, since it is the least thrown by the odd slow run.
+      object.insert("nsPerItem", static_cast<double>(result.MedianNs) / qMax<qint64>(result.Items, 1));
+      object.insert("mbPerSecond", result.MedianNs ? result.Bytes * 1000.0 / result.MedianNs : 0.0);
+      out.push_back(object);
+    }
+    return out;
+  }
+
+ private:
+  QString filter_;
+  qint64 minTime_;
+  QVector<bench_result_s> results_;
+};
+
+static qint64 bytesOf(const QString &text) {
+  return text.length() * static_cast<qint64>(sizeof (QChar));
+}
+
+int main(int argc, char **argv) {
+  // Highlighting needs fonts, but nothing here needs a screen.
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QGuiApplication app(argc, argv);
+  QCoreApplication::setApplicationName("qawno_bench");
+  QCoreApplication::setApplicationVersion(QAWNO_VERSION_STRING);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Times Qawno's lexer, completion, searching, and native parsing on synthetic Pawn.");
+  parser.addHelpOption();
+  QCommandLineOption filterOption("filter", "Only run benchmarks whose names contain <text>.", "text");
+  QCommandLineOption timeOption("min-time", "Keep repeating each one for at least <ms> (default 1000).", "ms", "1000");
+  QCommandLineOption outOption("out", "Write the JSON to <file> instead of stdout.", "file");
+  parser.addOptions({ filterOption, timeOption, outOption });
+  parser.process(app);
+
+  fprintf(stderr, "Generating corpora...\n");
+  struct corpus_s {
+    QString Name;
+    QString Text;
+  };
+  QVector<corpus_s> corpora {
+    { "small", Corpus::script(300, Seed) },
+    { "gamemode", Corpus::script(100000, Seed + 1) },
+    { "map", Corpus::map(100000, Seed + 2) },
+  };
+  // About the size of the open.mp includes.
+  QVector<corpus_include_s> includes = Corpus::includes(40, 60, Seed + 3);
+  QStringList prototypes = Corpus::prototypes(2400, Seed + 4);
+
+  Bench bench(parser.value(filterOption), parser.value(timeOption).toLongLong());
+
+  // `SyntaxHighlighter::highlightBlock`, for every line, through the document as the editor does it.
+  for (auto const & corpus : corpora) {
+    QTextDocument document;
+    document.setPlainText(corpus.Text);
+    SyntaxHighlighter highlighter(nullptr);
+    highlighter.setDocument(&document);
+    bench.run("highlight/" + corpus.Name, bytesOf(corpus.Text), document.blockCount(), [&]() -> qint64 {
+      highlighter.rehighlight();
+      return static_cast<qint64>(document.blockCount());
+    });
+  }
+
+  // `parseFile`, which is all in counting the symbols.
+  for (auto const & corpus : corpora) {
+    bench.run("parseFile/" + corpus.Name, bytesOf(corpus.Text), Corpus::lineCount(corpus.Text), [&]() -> qint64 {
+      return static_cast<qint64>(MainWindow::countSymbols(corpus.Text, false).size());
+    });
+  }
+
+  // The completion search from `on_editor_textChanged`, against the predictions a big gamemode and
+  // the includes would give.
+  {
+    QHash<QString, MainWindow::predictions_s> predictions;
+    auto add = [&](const QHash<QString, int> &symbols) {
+      for (auto it = symbols.constBegin(); it != symbols.constEnd(); ++it) {
+        predictions.insert(it.key(), { 1, predictions.value(it.key(), { 1, 0 }).Count + it.value() });
+      }
+    };
+    add(MainWindow::countSymbols(corpora[1].Text, false));
+    for (auto const & include : includes) {
+      add(MainWindow::countSymbols(include.Text, false));
+    }
+    QStringList typed { "Get", "SetPla", "vehic", "CreateDyn", "xyz", "PlayerTextDraw" };
+    QVector<MainWindow::suggestions_s> suggestions;
+    bench.run("completion/" + QString::number(predictions.size()), 0, typed.size(), [&]() -> qint64 {
+      qint64 found = 0;
+      for (auto const & word : typed) {
+        MainWindow::findSuggestions(predictions, word.constData(), word.length(), suggestions);
+        found += suggestions.size();
+      }
+      return found;
+    });
+  }
+
+  // Find, Replace All, and Find in Files through `SearchEngine::findAll`, against what they used
+  // to do: `QTextDocument::find` from the end of each match to the next.
+  {
+    struct query_s {
+      QString Name;
+      search_options_s Options;
+    };
+    QVector<query_s> queries {
+      { "plain", { "Player", true, false, false } },
+      { "nocase", { "player", false, false, false } },
+      { "words", { "Pos", true, true, false } },
+      { "regexp", { "Create\\w+Object\\(", true, false, true } },
+      { "rare", { "zzzNotThere", true, false, false } },
+    };
+    for (auto const & corpus : corpora) {
+      QTextDocument document;
+      document.setPlainText(corpus.Text);
+      for (auto const & query : queries) {
+        bench.run("search/engine/" + corpus.Name + "/" + query.Name, bytesOf(corpus.Text), 1, [&]() -> qint64 {
+          return static_cast<qint64>(SearchEngine::findAll(corpus.Text, query.Options).size());
+        });
+        QTextDocument::FindFlags flags;
+        if (query.Options.MatchCase) {
+          flags |= QTextDocument::FindCaseSensitively;
+        }
+        if (query.Options.WholeWords) {
+          flags |= QTextDocument::FindWholeWords;
+        }
+        QRegularExpression pattern(query.Options.Text, query.Options.MatchCase
+                                   ? QRegularExpression::NoPatternOption
+                                   : QRegularExpression::CaseInsensitiveOption);
+        bench.run("search/document/" + corpus.Name + "/" + query.Name, bytesOf(corpus.Text), 1, [&]() -> qint64 {
+          qint64 found = 0;
+          QTextCursor cursor(&document);
+          for ( ; ; ) {
+            cursor = query.Options.RegExp ? document.find(pattern, cursor, flags)
+                                          : document.find(query.Options.Text, cursor, flags);
+            if (cursor.isNull()) {
+              break;
+            }
+            ++found;
+          }
+          return found;
+        });
+      }
+    }
+  }
+
+  // `loadNativeList`: the parsing alone, then a whole directory with and without the cache.
+  {
+    QVector<QByteArray> data;
+    qint64 bytes = 0;
+    for (auto const & include : includes) {
+      data.push_back(include.Text.toLatin1());
+      bytes += data.last().size();
+    }
+    bench.run("natives/parse", bytes, data.size(), [&]() -> qint64 {
+      qint64 count = 0;
+      for (auto const & file : data) {
+        QVector<native_entry_s> natives;
+        NativeScanner::parse(file.constData(), file.size(), natives);
+        count += natives.size();
+      }
+      return count;
+    });
+
+    QTemporaryDir directory;
+    for (int i = 0; i != includes.size(); ++i) {
+      QFile file(directory.filePath(includes[i].FileName));
+      if (file.open(QFile::WriteOnly)) {
+        file.write(data[i]);
+      }
+    }
+    QString cachePath = directory.filePath("natives.cache");
+    bench.run("natives/scanDirectory/cold", bytes, data.size(), [&]() -> qint64 {
+      QFile::remove(cachePath);
+      return static_cast<qint64>(NativeScanner::scanDirectory(directory.path(), cachePath).size());
+    });
+    bench.run("natives/scanDirectory/cached", bytes, data.size(), [&]() -> qint64 {
+      return static_cast<qint64>(NativeScanner::scanDirectory(directory.path(), cachePath).size());
+    });
+  }
+
+  // `deprototype`, once for every native.
+  {
+    qint64 bytes = 0;
+    for (auto const & prototype : prototypes) {
+      bytes += bytesOf(prototype);
+    }
+    bench.run("deprototype", bytes, prototypes.size(), [&]() -> qint64 {
+      qint64 length = 0;
+      for (auto const & prototype : prototypes) {
+        length += MainWindow::deprototype(prototype).length();
+      }
+      return length;
+    });
+  }
+
+  QJsonObject report;
+  report.insert("version", QAWNO_VERSION_STRING);
+  report.insert("qt", qVersion());
+  report.insert("seed", static_cast<qint64>(Seed));
+  report.insert("minTimeMs", parser.value(timeOption).toLongLong());
+  report.insert("benchmarks", bench.results());
+  QByteArray json = QJsonDocument(report).toJson();
+  if (parser.isSet(outOption)) {
+    QFile out(parser.value(outOption));
+    if (!out.open(QFile::WriteOnly) || out.write(json) != json.size()) {
+      fprintf(stderr, "Could not write %s: %s\n", qPrintable(out.fileName()), qPrintable(out.errorString()));
+      return 1;
+    }
+  } else {
+    fwrite(json.constData(), 1, json.size(), stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,201 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QHash>
+#include <QTextBlock>
+#include <QtConcurrent>
+
+#include "BufferReferences.h"
+#include "PawnLexer.h"
+
+// Edited lines `find` will lex itself rather than leave out.  Far more than are ever typed (or
+// renamed) between two indexes, and far fewer than a file that has only just gone in.
+static const int MaxInline = 4096;
+
+static quint64 maskFor(const QStringRef &name) {
+  return Q_UINT64_C(1) << (qHash(name) & 63);
+}
+
+// Lexes one line, starting inside a block comment or not.
+static void lexLine(const QString &text, bool comment, reference_line_s &line) {
+  line.StartsInComment = comment;
+  line.Mask = 0;
+  line.Identifiers.clear();
+  PawnLexer lexer(text, comment);
+  pawn_token_s token;
+  while (lexer.next(token)) {
+    if (token.Type == pawn_token_identifier) {
+      line.Identifiers.push_back({ token.Start, token.Length });
+      line.Mask |= maskFor(text.midRef(token.Start, token.Length));
+    }
+  }
+  line.EndsInComment = lexer.inComment();
+}
+
+BufferReferences::BufferReferences(QTextDocument *document)
+  : QObject(document),
+    document_(document)
+{
+  indexTimer_.setSingleShot(true);
+  indexTimer_.setInterval(250);
+  connect(&indexTimer_, SIGNAL(timeout()), SLOT(reindex()));
+  connect(&indexer_, SIGNAL(finished()), SLOT(indexed()));
+  connect(document_, SIGNAL(contentsChange(int, int, int)), SLOT(contentsChange(int, int, int)));
+  // Whatever is there already is all new.
+  lines_.resize(document_->blockCount());
+  markDirty(0, lines_.size());
+  indexTimer_.start();
+}
+
+BufferReferences::~BufferReferences() {
+  // The worker only has its own copy of the lines, but its result would arrive at nothing.
+  indexer_.waitForFinished();
+}
+
+QVector<reference_run_s> BufferReferences::index(QVector<reference_run_s> runs) {
+  for (auto & run : runs) {
+    bool comment = run.StartsInComment;
+    run.Indexed.resize(run.Lines.size());
+    for (int i = 0; i != run.Lines.size(); ++i) {
+      reference_line_s& line = run.Indexed[i];
+      line.Id = run.Ids[i];
+      line.Dirty = false;
+      lexLine(run.Lines[i], comment, line);
+      comment = line.EndsInComment;
+    }
+  }
+  return runs;
+}
+
+void BufferReferences::markDirty(int from, int to) {
+  for (int i = from; i != to; ++i) {
+    reference_line_s& line = lines_[i];
+    if (!line.Dirty) {
+      line.Dirty = true;
+      ++dirty_;
+    }
+    // Even if it was already, so that an answer for what it used to say is thrown away.
+    line.Id = nextId_++;
+  }
+}
+
+void BufferReferences::contentsChange(int position, int removed, int added) {
+  Q_UNUSED(removed);
+  // The lines from the first one touched to the last one touched now replace however many there
+  // were before, which is the same number less however many the document has gained.
+  int first = document_->findBlock(position).blockNumber();
+  QTextBlock end = document_->findBlock(position + added);
+  int last = end.isValid() ? end.blockNumber() : document_->blockCount() - 1;
+  first = qMax(first, 0);
+  int gained = document_->blockCount() - lines_.size();
+  int oldLast = qBound(first - 1, last - gained, lines_.size() - 1);
+  for (int i = first; i <= oldLast; ++i) {
+    dirty_ -= lines_[i].Dirty ? 1 : 0;
+  }
+  lines_.remove(first, oldLast - first + 1);
+  reference_line_s fresh { 0, false, false, false, 0, QVector<QPair<int, int>>() };
+  lines_.insert(first, last - first + 1, fresh);
+  markDirty(first, last + 1);
+  indexTimer_.start();
+}
+
+void BufferReferences::reindex() {
+  if (indexer_.isRunning()) {
+    pending_ = true;
+    return;
+  }
+  if (dirty_ == 0) {
+    return;
+  }
+  // Only the edited lines are copied, in runs so that each one's comment state carries on to the
+  // next.  Each run starts from the line above it, which is never dirty.
+  QVector<reference_run_s> runs;
+  QTextBlock block = document_->begin();
+  for (int i = 0, n = lines_.size(); i != n && block.isValid(); ++i, block = block.next()) {
+    if (!lines_[i].Dirty) {
+      continue;
+    }
+    if (i == 0 || !lines_[i - 1].Dirty) {
+      runs.push_back({ i != 0 && lines_[i - 1].EndsInComment, QVector<quint32>(), QStringList(),
+                       QVector<reference_line_s>() });
+    }
+    runs.last().Ids.push_back(lines_[i].Id);
+    runs.last().Lines.push_back(block.text());
+  }
+  indexer_.setFuture(QtConcurrent::run(&BufferReferences::index, runs));
+}
+
+void BufferReferences::indexed() {
+  // Edits since the lines were sent gave them new ids, so whatever they said then is dropped here.
+  QHash<quint32, const reference_line_s*> answers;
+  QVector<reference_run_s> runs = indexer_.result();
+  for (auto const & run : runs) {
+    for (auto const & line : run.Indexed) {
+      answers.insert(line.Id, &line);
+    }
+  }
+  for (auto & line : lines_) {
+    if (line.Dirty) {
+      if (const reference_line_s* answer = answers.value(line.Id, nullptr)) {
+        line = *answer;
+        --dirty_;
+      }
+    }
+  }
+  // A comment opened or closed changes every line after it until one agrees again, which can't be
+  // known without lexing them.  The rest go, once, rather than a line at a time.
+  for (int i = 1, n = lines_.size(); i != n; ++i) {
+    if (!lines_[i].Dirty && !lines_[i - 1].Dirty
+        && lines_[i].StartsInComment != lines_[i - 1].EndsInComment) {
+      markDirty(i, n);
+      break;
+    }
+  }
+  if (pending_ || dirty_ != 0) {
+    pending_ = false;
+    reindex();
+  }
+}
+
+QVector<result_s> BufferReferences::find(const QString &name) const {
+  QVector<result_s> results;
+  quint64 mask = maskFor(QStringRef(&name));
+  bool lexing = dirty_ <= MaxInline;
+  bool comment = false;
+  int i = 0;
+  for (QTextBlock block = document_->begin(); block.isValid() && i != lines_.size(); block = block.next(), ++i) {
+    reference_line_s const* line = &lines_[i];
+    reference_line_s lexed;
+    if (line->Dirty) {
+      if (!lexing) {
+        continue;
+      }
+      lexLine(block.text(), comment, lexed);
+      line = &lexed;
+    }
+    comment = line->EndsInComment;
+    if (!(line->Mask & mask)) {
+      continue;
+    }
+    // Clean lines haven't changed since they were lexed, so the text is the same as it was.
+    QString text = block.text();
+    for (auto const & identifier : line->Identifiers) {
+      if (identifier.second == name.length() && text.midRef(identifier.first, identifier.second) == name) {
+        results.push_back({ i, identifier.first, identifier.second, text });
+      }
+    }
+  }
+  return results;
+}
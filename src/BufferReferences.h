@@ -0,0 +1,84 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BUFFERREFERENCES_H
+#define BUFFERREFERENCES_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPair>
+#include <QStringList>
+#include <QTextDocument>
+#include <QTimer>
+#include <QVector>
+
+#include "ResultsWidget.h"
+
+// Where the identifiers on one line are, plus a small hash mask so that most lines can be skipped
+// without looking at their text at all.  There is one for every block in the document, in order.
+struct reference_line_s {
+  quint32 Id;    // New for every edit to the line, so a late answer for it can be told apart.
+  bool Dirty;    // Edited since it was last lexed, so nothing below is right yet.
+  bool StartsInComment;
+  bool EndsInComment;
+  quint64 Mask;
+  QVector<QPair<int, int>> Identifiers; // Column and length.
+};
+
+// Consecutive edited lines, sent to a worker to be lexed together.
+struct reference_run_s {
+  bool StartsInComment;
+  QVector<quint32> Ids;
+  QStringList Lines;
+  QVector<reference_line_s> Indexed; // Filled in by the worker.
+};
+
+// Every identifier in an open document, kept up to date one edited line at a time.  An edit only
+// marks the lines it touched, and a short timer later just those lines are copied and lexed on a
+// worker, so typing never waits for it.  Opening or closing a block comment carries on down the
+// lines below until they agree again.
+class BufferReferences: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit BufferReferences(QTextDocument *document);
+  ~BufferReferences() override;
+
+  // Every use of `name`, in document order, from the last index.  Lines edited since are lexed here
+  // as long as there are only a few of them (as there are after typing), so what is found is what
+  // is there now.  Straight after a whole file has gone in, they are left to the worker.
+  QVector<result_s> find(const QString &name) const;
+
+  // Blocking, for workers.
+  static QVector<reference_run_s> index(QVector<reference_run_s> runs);
+
+ private slots:
+  void contentsChange(int position, int removed, int added);
+  void reindex();
+  void indexed();
+
+ private:
+  void markDirty(int from, int to);
+
+  QTextDocument *document_;
+  QVector<reference_line_s> lines_;
+  quint32 nextId_ = 0;
+  int dirty_ = 0;
+  bool pending_ = false;
+  QTimer indexTimer_;
+  QFutureWatcher<QVector<reference_run_s>> indexer_;
+};
+
+#endif // BUFFERREFERENCES_H
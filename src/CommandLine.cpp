@@ -0,0 +1,264 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QJsonDocument>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef Q_OS_WIN32
+  #include <windows.h>
+#endif
+
+#include "CommandLine.h"
+#include "Compiler.h"
+#include "IncludeGraph.h"
+#include "NativeCache.h"
+#include "NativeScanner.h"
+#include "SymbolIndex.h"
+
+struct build_result_s {
+  QString Target;
+  QString Command;
+  int ExitCode;
+  QString Output;
+};
+
+// Compiles one target on a worker.  A function object so that the compiler can come along.
+struct target_builder_s {
+  typedef build_result_s result_type;
+
+  QString Path;
+  QStringList Options;
+
+  build_result_s operator()(const QString &target) const {
+    Compiler compiler(Path, Options);
+    compiler.run(target);
+    return { target, compiler.commandFor(target), compiler.exitCode(), compiler.output() };
+  }
+};
+
+bool CommandLine::wanted(int argc, char **argv) {
+  static const char* const flags[] = { "--build", "--index", "--help", "-h", "-?", "--version", "-v" };
+  for (int i = 1; i < argc; ++i) {
+    for (const char* flag : flags) {
+      size_t length = strlen(flag);
+      if (strncmp(argv[i], flag, length) == 0 && (argv[i][length] == '\0' || argv[i][length] == '=')) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void CommandLine::print(const QJsonObject &object) {
+  QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact);
+  line += '\n';
+  fwrite(line.constData(), 1, line.size(), stdout);
+  fflush(stdout);
+}
+
+int CommandLine::fail(exit_code_e code, const QString &message) {
+  QJsonObject error;
+  error.insert("type", "error");
+  error.insert("message", message);
+  print(error);
+  return code;
+}
+
+int CommandLine::run() {
+#ifdef Q_OS_WIN32
+  // Built as a windowed program, so there is nowhere for output to go unless it was redirected or
+  // the console it was started from is borrowed.
+  if (GetFileType(GetStdHandle(STD_OUTPUT_HANDLE)) == FILE_TYPE_UNKNOWN
+      && AttachConsole(ATTACH_PARENT_PROCESS)) {
+    freopen("CONOUT$", "w", stdout);
+    freopen("CONOUT$", "w", stderr);
+  }
+#endif
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QCoreApplication::translate("CommandLine",
+    "Builds scripts and indexes includes without opening a window.  Prints one JSON object per line."));
+  QCommandLineOption help = parser.addHelpOption();
+  QCommandLineOption version = parser.addVersionOption();
+  QCommandLineOption buildOption("build",
+    QCoreApplication::translate("CommandLine", "Compile <file>.  May be given more than once."), "file");
+  QCommandLineOption jobsOption("jobs",
+    QCoreApplication::translate("CommandLine", "Compile up to <n> files at once (default: one per core)."), "n");
+  QCommandLineOption compilerOption("compiler",
+    QCoreApplication::translate("CommandLine", "Use the compiler at <path> instead of the one set in Qawno."), "path");
+  QCommandLineOption optionsOption("options",
+    QCoreApplication::translate("CommandLine", "Use <options> instead of the compiler options set in Qawno."), "options");
+  QCommandLineOption indexOption("index",
+    QCoreApplication::translate("CommandLine", "Index the symbols and natives of every include in <dir>."), "dir");
+  QCommandLineOption outOption("out",
+    QCoreApplication::translate("CommandLine", "Write the symbol index to <file> (default: Qawno's own)."), "file");
+  parser.addOptions({ buildOption, jobsOption, compilerOption, optionsOption, indexOption, outOption });
+  parser.addPositionalArgument("files", QCoreApplication::translate("CommandLine", "More files to compile."),
+                               "[files...]");
+
+  if (!parser.parse(QCoreApplication::arguments())) {
+    return fail(exit_code_usage, parser.errorText());
+  }
+  if (parser.isSet(help)) {
+    fputs(qPrintable(parser.helpText()), stdout);
+    return exit_code_success;
+  }
+  if (parser.isSet(version)) {
+    fputs(qPrintable(QString("%1 %2\n").arg(QCoreApplication::applicationName(),
+                                             QCoreApplication::applicationVersion())), stdout);
+    return exit_code_success;
+  }
+
+  int result = exit_code_success;
+  if (parser.isSet(indexOption)) {
+    result = qMax(result, index(parser.value(indexOption), parser.value(outOption)));
+  }
+  if (parser.isSet(buildOption)) {
+    if (parser.isSet(jobsOption)) {
+      bool ok = false;
+      int jobs = parser.value(jobsOption).toInt(&ok);
+      if (!ok || jobs < 1) {
+        return fail(exit_code_usage, QString("--jobs needs a number of at least 1, not \"%1\"")
+                                       .arg(parser.value(jobsOption)));
+      }
+      QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+    }
+    QStringList targets = parser.values(buildOption) + parser.positionalArguments();
+    result = qMax(result, build(targets, parser.value(compilerOption), parser.value(optionsOption)));
+  }
+  return result;
+}
+
+int CommandLine::build(const QStringList &targets, const QString &compiler, const QString &options) {
+  // Expanded exactly as the window does it, from the same settings unless told otherwise.
+  target_builder_s builder;
+  {
+    // Read rather than default-constructed, so a build from a script never writes them back.
+    Compiler configured = Compiler::fromSettings();
+    if (!compiler.isEmpty()) {
+      configured.setPath(compiler);
+    }
+    if (!options.isEmpty()) {
+      configured.setOptions(options);
+    }
+    builder.Path = configured.path();
+    builder.Options = configured.options();
+  }
+  for (auto const & target : targets) {
+    if (!QFileInfo(target).isFile()) {
+      return fail(exit_code_usage, QString("No such file: %1").arg(target));
+    }
+  }
+  QVector<build_result_s> results =
+    QtConcurrent::blockingMapped<QVector<build_result_s>>(targets, builder);
+  int code = exit_code_success;
+  for (auto const & result : results) {
+    int errors = 0, warnings = 0;
+    for (auto const & message : Compiler::messages(result.Output)) {
+      QJsonObject diagnostic;
+      diagnostic.insert("type", "diagnostic");
+      diagnostic.insert("target", result.Target);
+      diagnostic.insert("file", message.File);
+      diagnostic.insert("line", message.Line);
+      diagnostic.insert("endLine", message.EndLine);
+      diagnostic.insert("severity", message.Severity);
+      diagnostic.insert("code", message.Code);
+      diagnostic.insert("message", message.Text);
+      print(diagnostic);
+      if (message.Severity == "warning") {
+        ++warnings;
+      } else {
+        ++errors;
+      }
+    }
+    QJsonObject build;
+    build.insert("type", "build");
+    build.insert("target", result.Target);
+    build.insert("command", result.Command);
+    build.insert("exitCode", result.ExitCode);
+    build.insert("errors", errors);
+    build.insert("warnings", warnings);
+    if (result.ExitCode == -1) {
+      // Nothing it printed, so whatever `QProcess` said instead.
+      build.insert("message", result.Output.trimmed());
+    }
+    print(build);
+    if (result.ExitCode != 0 || errors != 0) {
+      code = exit_code_failed;
+    }
+  }
+  return code;
+}
+
+int CommandLine::index(const QString &directory, const QString &out) {
+  QString root = QDir(directory).absolutePath();
+  if (!QFileInfo(root).isDir()) {
+    return fail(exit_code_usage, QString("No such directory: %1").arg(directory));
+  }
+  QStringList files;
+  QDirIterator it(root, { "*.inc", "*.pwn", "*.p" }, QDir::Files | QDir::Readable,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    files.push_back(IncludeGraph::normalise(it.next()));
+  }
+  files.sort();
+  // Into Qawno's own cache unless told otherwise, where it is added to whatever else is there.  A
+  // file of its own gets only this directory, so it can be handed around.
+  QString cachePath = out.isEmpty() ? SymbolIndex::cachePath() : out;
+  symbol_result_s symbols = SymbolIndex::build(files, QStringList(), QHash<QString, QString>(),
+                                               QHash<QString, symbol_file_s>(),
+                                               QHash<QString, symbol_buffer_s>(), cachePath, true, false);
+  QHash<QString, symbol_file_s> indexed = symbols.Files;
+  if (!out.isEmpty()) {
+    indexed.clear();
+    for (auto const & path : files) {
+      auto found = symbols.Files.constFind(path);
+      if (found != symbols.Files.constEnd()) {
+        indexed.insert(path, *found);
+      }
+    }
+  }
+  if (!SymbolIndex::saveCache(cachePath, indexed)) {
+    return fail(exit_code_usage, QString("Could not write %1").arg(cachePath));
+  }
+  int count = 0;
+  for (auto const & path : files) {
+    count += symbols.Files.value(path).Symbols.size();
+  }
+  // The natives list only ever shows the top level, and is cached the same way the window does it,
+  // so the next time Qawno starts in here it has nothing to read.
+  int natives = 0;
+  for (auto const & file : NativeScanner::scanDirectory(root, NativeCache::pathFor(root))) {
+    for (auto const & native : file.Natives) {
+      natives += native.Heading ? 0 : 1;
+    }
+  }
+  QJsonObject index;
+  index.insert("type", "index");
+  index.insert("directory", root);
+  index.insert("out", cachePath);
+  index.insert("files", files.size());
+  index.insert("symbols", count);
+  index.insert("natives", natives);
+  print(index);
+  return exit_code_success;
+}
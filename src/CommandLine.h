@@ -0,0 +1,52 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QJsonObject>
+#include <QStringList>
+
+enum exit_code_e {
+  exit_code_success = 0,
+  exit_code_failed = 1, // A build had errors, or the compiler wouldn't run.
+  exit_code_usage = 2,  // Bad arguments, or a file that couldn't be read or written.
+};
+
+// Qawno without a window, for build scripts, CI, and pre-commit hooks:
+//
+//   qawno --build gamemodes/main.pwn [--build ...] [--jobs 4]
+//   qawno --index pawno/include [--out symbols.bin]
+//
+// Only needs a `QCoreApplication`, so runs without a display.  Everything it has to say goes to
+// stdout as one JSON object per line, and the exit code says whether it worked.
+class CommandLine {
+ public:
+  // Whether `argv` asks for any of this, decided before there is an application to parse it with.
+  static bool wanted(int argc, char **argv);
+
+  // Parses the application's arguments and does what they say.
+  static int run();
+
+ private:
+  static int build(const QStringList &targets, const QString &compiler, const QString &options);
+  static int index(const QString &directory, const QString &out);
+
+  static void print(const QJsonObject &object);
+  // Prints `message` as an error, and returns `code`.
+  static int fail(exit_code_e code, const QString &message);
+};
+
+#endif // COMMANDLINE_H
@@ -15,19 +15,40 @@
 
 #include <QFileInfo>
 #include <QProcess>
+#include <QRegularExpression>
 #include <QSettings>
 #include <QDir>
 #include <QCoreApplication>
 
 #include "Compiler.h"
 
-Compiler::Compiler() {
+Compiler::Compiler()
+  : Compiler(fromSettings())
+{
+  save_ = true;
+}
+
+Compiler::Compiler(const QString &path, const QStringList &options)
+  : path_(path),
+    options_(options),
+    save_(false)
+{
+}
+
+Compiler Compiler::fromSettings() {
   QSettings settings;
-  path_ = settings.value("CompilerPath", "./pawncc").toString();
-  options_ = settings.value("CompilerOptions", "-;+ -(+ -\\ -Z- \"-i%p/%o\" \"-r%p/%o\" \"-i%q/include\" -d3 -t4 \"-o%p/%o\" \"%p/%i\"").toString().split("\\s*");
+  return Compiler(settings.value("CompilerPath", "./pawncc").toString(),
+                  settings.value("CompilerOptions", "-;+ -(+ -\\ -Z- \"-i%p/%o\" \"-r%p/%o\" \"-i%q/include\" -d3 -t4 \"-o%p/%o\" \"%p/%i\"").toString().split("\\s*"));
+}
+
+QString Compiler::includeDirectory() {
+  return QDir(QCoreApplication::applicationDirPath() + "/include").absolutePath();
 }
 
 Compiler::~Compiler() {
+  if (!save_) {
+    return;
+  }
   QSettings settings;
   settings.setValue("CompilerPath", path_);
   settings.setValue("CompilerOptions", options_.join(" "));
@@ -95,7 +116,29 @@ void Compiler::run(const QString &inputFile) {
 
   if (process.waitForFinished()) {
     output_ = process.readAll();
+    exitCode_ = process.exitStatus() == QProcess::NormalExit ? process.exitCode() : -1;
   } else {
     output_ = process.errorString();
+    exitCode_ = -1;
+  }
+}
+
+int Compiler::exitCode() const {
+  return exitCode_;
+}
+
+QVector<compiler_message_s> Compiler::messages(const QString &output) {
+  static const QRegularExpression message(
+    "^(.*?)\\((\\d+)(?: -- (\\d+))?\\) : (warning|error|fatal error) (\\d+): (.*?)\\r?$",
+    QRegularExpression::MultilineOption);
+  QVector<compiler_message_s> messages;
+  QRegularExpressionMatchIterator it = message.globalMatch(output);
+  while (it.hasNext()) {
+    QRegularExpressionMatch match = it.next();
+    int line = match.captured(2).toInt();
+    int endLine = match.capturedLength(3) ? match.captured(3).toInt() : line;
+    messages.push_back({ match.captured(1), line, endLine, match.captured(4),
+                         match.captured(5).toInt(), match.captured(6) });
   }
+  return messages;
 }
@@ -18,12 +18,35 @@
 
 #include <QString>
 #include <QStringList>
+#include <QVector>
+
+// One error or warning, as the compiler prints them:
+//
+//   D:\open.mp\gamemodes\independence.pwn(9) : warning 203: symbol is never used: "warning"
+//
+struct compiler_message_s {
+  QString File;
+  int Line;    // From 1.
+  int EndLine; // The same as `Line` unless it was given as a range (`(9 -- 12)`).
+  QString Severity; // `warning`, `error`, or `fatal error`.
+  int Code;
+  QString Text;
+};
 
 class Compiler {
  public:
+  // Uses (and saves again) the settings.
   Compiler();
+  // Leaves the settings alone, for the command line and for workers.
+  Compiler(const QString &path, const QStringList &options);
   ~Compiler();
 
+  // The compiler as set in the settings, for reading only: nothing is written back afterwards.
+  static Compiler fromSettings();
+
+  // The includes that come with Qawno (`%q/include`), wherever it was started from.
+  static QString includeDirectory();
+
   QString path() const;
   void setPath(const QString &path);
 
@@ -38,10 +61,18 @@ class Compiler {
 
   void run(const QString &inputFile);
 
+  // What the compiler exited with, or `-1` if it didn't start or didn't finish.
+  int exitCode() const;
+
+  // Every error and warning in some compiler output.
+  static QVector<compiler_message_s> messages(const QString &output);
+
  private:
   QString path_;
   QStringList options_;
   QString output_;
+  int exitCode_ = -1;
+  bool save_ = true;
 };
 
 #endif // COMPILER_H
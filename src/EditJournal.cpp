@@ -0,0 +1,250 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QUuid>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "EditJournal.h"
+
+static const quint32 Magic = 0x514A4E4C; // `QJNL`.
+static const quint32 Version = 1;
+
+// What follows each header: the whole text, or one edit to it.
+static const quint8 SnapshotRecord = 'S';
+static const quint8 EditRecord = 'E';
+
+static QString directory() {
+  return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/journal";
+}
+
+static bool readHeader(QDataStream &in, loaded_file_s &file) {
+  quint32 magic = 0, version = 0;
+  qint32 encoding = 0;
+  in.setVersion(QDataStream::Qt_5_0);
+  in >> magic >> version >> file.Path >> encoding >> file.Bom;
+  file.Encoding = static_cast<file_encoding_e>(encoding);
+  return in.status() == QDataStream::Ok && magic == Magic && version == Version;
+}
+
+EditJournal::EditJournal(QTextDocument *document, QObject *parent)
+  : QObject(parent),
+    document_(document)
+{
+  flushTimer_.setSingleShot(true);
+  flushTimer_.setInterval(1000);
+  connect(&flushTimer_, SIGNAL(timeout()), SLOT(flush()));
+  connect(document_, SIGNAL(contentsChange(int, int, int)), SLOT(contentsChanged(int, int, int)));
+  connect(document_, SIGNAL(modificationChanged(bool)), SLOT(modificationChanged(bool)));
+}
+
+EditJournal::~EditJournal() {
+  // Closing normally, so whatever wasn't saved was meant not to be.
+  discard();
+}
+
+void EditJournal::setFile(const QString &path, file_encoding_e encoding, bool bom) {
+  path_ = path;
+  encoding_ = encoding;
+  bom_ = bom;
+  enabled_ = true;
+}
+
+void EditJournal::resume(const QString &journal) {
+  discard();
+  QFile f{journal};
+  if (f.open(QFile::ReadOnly)) {
+    loaded_file_s file;
+    QDataStream in(&f);
+    if (readHeader(in, file)) {
+      setFile(file.Path, file.Encoding, file.Bom);
+    }
+  }
+  lock_.reset(new QLockFile(journal + ".lock"));
+  lock_->tryLock(0);
+  file_.setFileName(journal);
+  // The last edit might have been cut off, so start it again from what was recovered rather than
+  // appending after it.
+  snapshot();
+}
+
+void EditJournal::discard() {
+  flushTimer_.stop();
+  pending_.clear();
+  if (!file_.fileName().isEmpty()) {
+    file_.close();
+    QFile::remove(file_.fileName());
+    file_.setFileName(QString());
+  }
+  lock_.reset();
+}
+
+QStringList EditJournal::orphans() {
+  QStringList journals;
+  QDir dir(directory());
+  for (auto const & name : dir.entryList(QStringList("*.journal"), QDir::Files)) {
+    QString journal = dir.filePath(name);
+    // A lock left by a process that has gone is stale, and is taken over.
+    QLockFile lock(journal + ".lock");
+    if (lock.tryLock(0)) {
+      journals.push_back(journal);
+    }
+  }
+  return journals;
+}
+
+void EditJournal::remove(const QString &journal) {
+  QFile::remove(journal);
+  QFile::remove(journal + ".lock");
+}
+
+QString EditJournal::fileName(const QString &journal) {
+  loaded_file_s file;
+  QFile f{journal};
+  if (!f.open(QFile::ReadOnly)) {
+    return QString();
+  }
+  QDataStream in(&f);
+  return readHeader(in, file) ? file.Path : QString();
+}
+
+loaded_file_s EditJournal::replay(const QString &journal) {
+  loaded_file_s file { QString(), QString(), file_encoding_ascii, false, QString() };
+  QFile f{journal};
+  if (!f.open(QFile::ReadOnly)) {
+    file.Error = f.errorString();
+    return file;
+  }
+  QDataStream in(&f);
+  if (!readHeader(in, file)) {
+    file.Error = QCoreApplication::translate("EditJournal", "The recovery journal is damaged");
+    return file;
+  }
+  while (!in.atEnd()) {
+    quint8 type = 0;
+    qint32 position = 0, removed = 0;
+    QString text;
+    in >> type;
+    if (type == SnapshotRecord) {
+      in >> text;
+      if (in.status() != QDataStream::Ok) {
+        break;
+      }
+      file.Text = text;
+    } else if (type == EditRecord) {
+      in >> position >> removed >> text;
+      if (in.status() != QDataStream::Ok || position < 0 || position > file.Text.length()) {
+        break;
+      }
+      file.Text.replace(position, qMax(removed, 0), text);
+    } else {
+      break;
+    }
+  }
+  return file;
+}
+
+void EditJournal::contentsChanged(int position, int removed, int added) {
+  if (!enabled_) {
+    return;
+  }
+  if (file_.isOpen()) {
+    // The end can be reported one past the last character.
+    QTextCursor cursor(document_);
+    cursor.setPosition(position);
+    cursor.setPosition(qMin(position + added, document_->characterCount() - 1), QTextCursor::KeepAnchor);
+    QString text = cursor.selectedText();
+    text.replace(QChar::ParagraphSeparator, '\n').replace(QChar::LineSeparator, '\n');
+    QDataStream out(&pending_, QIODevice::Append);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << EditRecord << qint32(position) << qint32(removed) << text;
+  }
+  // Otherwise the copy of the whole text taken on the first flush will have it anyway.  Either way
+  // typing without stopping still gets synced every second.
+  if (!flushTimer_.isActive()) {
+    flushTimer_.start();
+  }
+}
+
+void EditJournal::modificationChanged(bool changed) {
+  if (!changed) {
+    // Saved, or undone back to how it was.
+    discard();
+  } else if (enabled_ && !flushTimer_.isActive()) {
+    flushTimer_.start();
+  }
+}
+
+void EditJournal::flush() {
+  if (!file_.isOpen()) {
+    if (enabled_ && document_->isModified()) {
+      snapshot();
+    }
+    return;
+  }
+  if (pending_.isEmpty()) {
+    return;
+  }
+  if (file_.size() + pending_.size() > snapshotSize_ * 2 + (1 << 20)) {
+    // More edits than text, so start again from a new copy.
+    snapshot();
+    return;
+  }
+  file_.write(pending_);
+  pending_.clear();
+  file_.flush();
+#ifdef Q_OS_WIN
+  _commit(file_.handle());
+#else
+  fsync(file_.handle());
+#endif
+}
+
+void EditJournal::snapshot() {
+  QString journal = file_.fileName();
+  if (journal.isEmpty()) {
+    QDir().mkpath(directory());
+    journal = QString("%1/%2.journal").arg(directory(), QUuid::createUuid().toString().mid(1, 36));
+    lock_.reset(new QLockFile(journal + ".lock"));
+    lock_->tryLock(0);
+  }
+  file_.close();
+  pending_.clear();
+  // Written next to the old one, synced, then swapped in, so there is always one whole journal.
+  QString text = document_->toPlainText();
+  QSaveFile out{journal};
+  if (!out.open(QFile::WriteOnly)) {
+    return;
+  }
+  QDataStream stream(&out);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << Magic << Version << path_ << qint32(encoding_) << bom_ << SnapshotRecord << text;
+  snapshotSize_ = out.size();
+  file_.setFileName(journal);
+  if (out.commit()) {
+    file_.open(QFile::WriteOnly | QFile::Append);
+  }
+}
@@ -0,0 +1,89 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QLockFile>
+#include <QObject>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTimer>
+
+#include "FileLoader.h"
+
+class QTextDocument;
+
+// Keeps unsaved changes to one document on disk, so they survive a crash.  Once the document has
+// changed the journal starts with a copy of the whole text, then every edit is appended as it is
+// made (where, how much went, and what came in), so each keystroke only costs its own size.  Edits
+// are buffered and synced at most once a second, and when the edits outgrow the copy they are
+// folded back in to a new one.  Saving or closing the document throws the journal away; one still
+// there the next time Qawno starts means the changes were never saved.
+class EditJournal: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit EditJournal(QTextDocument *document, QObject *parent = 0);
+  ~EditJournal() override;
+
+  // What to recover the text as.  Nothing is written until this has been called, so loading the
+  // file in the first place is never journalled.
+  void setFile(const QString &path, file_encoding_e encoding, bool bom);
+
+  // Carry on appending to a journal left from before, once its text is back in the document.
+  void resume(const QString &journal);
+
+  // Stop, and delete the journal.  The changes are either saved or not wanted.
+  void discard();
+
+  // Journals left by an editor that didn't get to throw them away, and no longer in use by one.
+  static QStringList orphans();
+
+  // Delete a journal that isn't wanted.
+  static void remove(const QString &journal);
+
+  // The file a journal was for (empty for a new one).
+  static QString fileName(const QString &journal);
+
+  // The text a journal ends with, ready for an editor.  Stops at the last complete edit, since a
+  // crash can cut one off.  Blocking, for workers.
+  static loaded_file_s replay(const QString &journal);
+
+ private slots:
+  void contentsChanged(int position, int removed, int added);
+  void modificationChanged(bool changed);
+  void flush();
+
+ private:
+  bool open(const QString &journal, QIODevice::OpenMode mode);
+  void snapshot();
+
+  QTextDocument* document_;
+  QString path_;
+  file_encoding_e encoding_ = file_encoding_ascii;
+  bool bom_ = false;
+  bool enabled_ = false;
+
+  QFile file_;
+  QScopedPointer<QLockFile> lock_;
+  QByteArray pending_;
+  qint64 snapshotSize_ = 0;
+  QTimer flushTimer_;
+};
+
+#endif // EDITJOURNAL_H
@@ -13,11 +13,15 @@
 // You should have received a copy of the GNU General Public License
 // along with qawno. If not, see <http://www.gnu.org/licenses/>.
 
+#include <QElapsedTimer>
+#include <QMouseEvent>
 #include <QPainter>
+#include <QScrollBar>
 #include <QSettings>
 #include <QTextEdit>
 #include <QTextBlock>
 #include <QTextCursor>
+#include <QtConcurrent>
 
 #include "EditorWidget.h"
 #include "SyntaxHighlighter.h"
@@ -51,6 +55,12 @@ void EditorLineNumberWidget::paintEvent(QPaintEvent *event) {
   painter.setPen(palette().windowText().color());
   painter.fillRect(event->rect(), palette().window().color());
 
+  // Changed lines are marked down the right hand side, in the space left after the numbers.
+  int digitWidth = fontMetrics().horizontalAdvance(QLatin1Char('0'));
+  int barWidth = qMax(digitWidth / 3, 2);
+  int barLeft = width() - digitWidth / 2 - barWidth / 2;
+  const LineChanges &changes = editor()->changes_;
+
   QTextBlock block = editor()->firstVisibleBlock();
   QPointF contentOffset = editor()->contentOffset();
   QRectF boundingGeometry = editor()->blockBoundingGeometry(block);
@@ -61,10 +71,14 @@ void EditorLineNumberWidget::paintEvent(QPaintEvent *event) {
   do {
     if (bottom >= event->rect().top()) {
       QString lineNumber = QString::number(block.blockNumber() + 1);
-      int digitWidth = fontMetrics().horizontalAdvance(QLatin1Char('0'));
       int numDigits = lineNumber.length();
       QRect rect(digitWidth, static_cast<int>(top), digitWidth * numDigits, static_cast<int>(bottom));
       painter.drawText(rect, Qt::AlignRight, lineNumber);
+      int change = changes.at(block.blockNumber());
+      if (change != line_change_none) {
+        paintChange(painter, change, QRect(barLeft, static_cast<int>(top), barWidth,
+                                           static_cast<int>(bottom - top)));
+      }
     }
     block = block.next();
     top = bottom;
@@ -74,6 +88,32 @@ void EditorLineNumberWidget::paintEvent(QPaintEvent *event) {
          && top <= event->rect().bottom());
 }
 
+void EditorLineNumberWidget::paintChange(QPainter &painter, int change, const QRect &bar) {
+  if (change & line_change_added) {
+    painter.fillRect(bar, QColor(0x4CAF50));
+  } else if (change & line_change_modified) {
+    painter.fillRect(bar, QColor(0x2196F3));
+  }
+  // Removed lines have nowhere to go, so get a little arrow on the boundary where they were.
+  int size = bar.width() + 1;
+  QPolygon arrow;
+  if (change & line_change_removed_above) {
+    arrow << QPoint(bar.left(), bar.top() - size) << QPoint(bar.left() + size * 2, bar.top())
+          << QPoint(bar.left(), bar.top() + size);
+  }
+  if (change & line_change_removed_below) {
+    arrow << QPoint(bar.left(), bar.bottom() - size) << QPoint(bar.left() + size * 2, bar.bottom())
+          << QPoint(bar.left(), bar.bottom() + size);
+  }
+  if (!arrow.isEmpty()) {
+    painter.save();
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0xE53935));
+    painter.drawPolygon(arrow);
+    painter.restore();
+  }
+}
+
 void EditorLineNumberWidget::resizeEvent(QResizeEvent *event) {
   Q_UNUSED(event);
   updateGeometry();
@@ -111,13 +151,13 @@ static QFont defaultFont() {
 EditorWidget::EditorWidget(QWidget *parent)
   : QPlainTextEdit(parent),
     lineNumberArea_(this),
-    highlighter_(this)
+    highlighter_(this),
+    references_(document()),
+    journal_(document()),
+    changes_(document())
 {
-  QSettings settings;
-
-  QFont font = defaultFont();
-  font.fromString(settings.value("EditorFont", font).toString());
-  setFont(font);
+  setFont(editorFont());
+  hidden_.start();
 
   setTabWidth(tabWidth_);
   setIndentWidth(indentWidth_);
@@ -135,6 +175,19 @@ EditorWidget::EditorWidget(QWidget *parent)
 
   connect(this, SIGNAL(cursorPositionChanged()), SLOT(highlightCurrentLine()));
   highlightCurrentLine();
+
+  connect(&changes_, SIGNAL(changed()), &lineNumberArea_, SLOT(update()));
+
+  loadTimer_.setInterval(0);
+  connect(&loadTimer_, SIGNAL(timeout()), SLOT(loadChunk()));
+  connect(&reader_, SIGNAL(finished()), SLOT(fileRead()));
+}
+
+QFont EditorWidget::editorFont() {
+  QSettings settings;
+  QFont font = defaultFont();
+  font.fromString(settings.value("EditorFont", font).toString());
+  return font;
 }
 
 EditorWidget::~EditorWidget() {
@@ -175,11 +228,294 @@ void EditorWidget::toggleDarkMode(bool toggle) {
   highlightCurrentLine();
 }
 
-void EditorWidget::jumpToLine(long line) {
+EditJournal &EditorWidget::journal() {
+  return journal_;
+}
+
+const BufferReferences &EditorWidget::references() const {
+  return references_;
+}
+
+void EditorWidget::replaceMatches(const QVector<result_s> &matches, const QString &replacement) {
+  // Absolute positions, found in one walk down the document.
+  QVector<QPair<int, int>> ranges;
+  ranges.reserve(matches.size());
+  QTextBlock block = document()->begin();
+  int line = 0;
+  for (auto const & match : matches) {
+    while (line < match.Line && block.isValid()) {
+      block = block.next();
+      ++line;
+    }
+    if (!block.isValid()) {
+      break;
+    }
+    ranges.push_back({ block.position() + match.Column, match.Length });
+  }
+  replaceRanges(ranges, replacement);
+}
+
+void EditorWidget::replaceRanges(const QVector<QPair<int, int>> &ranges, const QString &replacement) {
+  if (ranges.isEmpty()) {
+    return;
+  }
+  // Back to front, so that each edit leaves the positions of those still to do alone.  Within one
+  // edit block the document reports the change (and so lays out and highlights it) once, at the
+  // end, and every other cursor, including the one on screen, moves with the text around it.
+  QTextCursor cursor(document());
+  cursor.beginEditBlock();
+  for (int i = ranges.size(); i--; ) {
+    cursor.setPosition(ranges[i].first);
+    cursor.setPosition(ranges[i].first + ranges[i].second, QTextCursor::KeepAnchor);
+    cursor.insertText(replacement);
+  }
+  cursor.endEditBlock();
+}
+
+void EditorWidget::reload(const QVector<diff_hunk_s> &hunks, const QStringList &lines,
+                          file_encoding_e encoding, bool bom) {
+  encoding_ = encoding;
+  bom_ = bom;
+  // Back to front again, but each hunk is its own edit (joined on to the first for undo), so the
+  // highlighter only goes over the lines that changed rather than everything between the first and
+  // the last.
+  QTextCursor cursor(document());
+  for (int i = hunks.size(); i--; ) {
+    diff_hunk_s const & hunk = hunks[i];
+    QString text = QStringList(lines.mid(hunk.NewStart, hunk.NewCount)).join('\n');
+    if (i == hunks.size() - 1) {
+      cursor.beginEditBlock();
+    } else {
+      cursor.joinPreviousEditBlock();
+    }
+    int blocks = document()->blockCount();
+    QTextBlock first = document()->findBlockByNumber(hunk.OldStart);
+    QTextBlock last = document()->findBlockByNumber(hunk.OldStart + hunk.OldCount - 1);
+    if (hunk.OldCount == 0) {
+      // Only new lines, before an old one or after the last.
+      if (hunk.OldStart < blocks) {
+        cursor.setPosition(first.position());
+        cursor.insertText(text + '\n');
+      } else {
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText('\n' + text);
+      }
+    } else if (hunk.NewCount == 0) {
+      // Only old lines, so their line breaks go too.
+      if (hunk.OldStart + hunk.OldCount < blocks) {
+        cursor.setPosition(first.position());
+        cursor.setPosition(last.next().position(), QTextCursor::KeepAnchor);
+      } else if (hunk.OldStart != 0) {
+        cursor.setPosition(first.previous().position() + first.previous().length() - 1);
+        cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+      } else {
+        cursor.select(QTextCursor::Document);
+      }
+      cursor.removeSelectedText();
+    } else {
+      cursor.setPosition(first.position());
+      cursor.setPosition(last.position() + last.length() - 1, QTextCursor::KeepAnchor);
+      cursor.insertText(text);
+    }
+    cursor.endEditBlock();
+  }
+}
+
+void EditorWidget::setDiskState(qint64 modified, qint64 size) {
+  diskModified_ = modified;
+  diskSize_ = size;
+}
+
+bool EditorWidget::matchesDisk(qint64 modified, qint64 size) const {
+  return diskModified_ == modified && diskSize_ == size;
+}
+
+void EditorWidget::load(const QString &path) {
+  loading_ = true;
+  loadError_.clear();
+  setReadOnly(true);
+  emit loadProgress(0);
+  reader_.setFuture(QtConcurrent::run(&FileLoader::read, path));
+}
+
+void EditorWidget::loadLater(const QString &path) {
+  loading_ = true;
+  hibernating_ = false;
+  packed_ = packed_file_s {};
+  deferred_ = path;
+  setReadOnly(true);
+}
+
+void EditorWidget::loadLater(const packed_file_s &file) {
+  loading_ = true;
+  hibernating_ = true;
+  packed_ = file;
+  setReadOnly(true);
+}
+
+void EditorWidget::loadNow() {
+  if (hibernating_) {
+    hibernating_ = false;
+    loadError_.clear();
+    emit loadProgress(0);
+    reader_.setFuture(QtConcurrent::run(&FileLoader::unpack, packed_));
+    packed_ = packed_file_s {};
+  } else if (!deferred_.isEmpty()) {
+    QString path = deferred_;
+    deferred_.clear();
+    load(path);
+  }
+}
+
+void EditorWidget::recover(const QString &journal) {
+  loading_ = true;
+  recovered_ = journal;
+  loadError_.clear();
+  setReadOnly(true);
+  // This may be a tab that already has (some of) the file in it, or is waiting to read it.  Setting
+  // a new future drops any read still going, so nothing of the old text turns up afterwards.
+  loadTimer_.stop();
+  loadText_.clear();
+  deferred_.clear();
+  hibernating_ = false;
+  packed_ = packed_file_s {};
+  document()->setUndoRedoEnabled(false);
+  document()->clear();
+  emit loadProgress(0);
+  reader_.setFuture(QtConcurrent::run(&EditJournal::replay, journal));
+}
+
+bool EditorWidget::isLoading() const {
+  return loading_;
+}
+
+bool EditorWidget::isDeferred() const {
+  return hibernating_ || !deferred_.isEmpty();
+}
+
+bool EditorWidget::isHibernating() const {
+  return hibernating_;
+}
+
+qint64 EditorWidget::idleTime() const {
+  return isVisible() ? 0 : hidden_.elapsed();
+}
+
+void EditorWidget::hideEvent(QHideEvent *event) {
+  hidden_.restart();
+  QPlainTextEdit::hideEvent(event);
+}
+
+const QString &EditorWidget::loadError() const {
+  return loadError_;
+}
+
+file_encoding_e EditorWidget::encoding() const {
+  return encoding_;
+}
+
+bool EditorWidget::hasByteOrderMark() const {
+  return bom_;
+}
+
+void EditorWidget::fileRead() {
+  loaded_file_s file = reader_.result();
+  encoding_ = file.Encoding;
+  bom_ = file.Bom;
+  loadError_ = file.Error;
+  loadText_ = file.Text;
+  loadPosition_ = 0;
+  // Nobody wants to undo the file appearing, and every piece would be another step.
+  document()->setUndoRedoEnabled(false);
+  loadTimer_.start();
+}
+
+void EditorWidget::loadChunk() {
+  // Put in whole lines for about a frame, then let everything else have a go.  The highlighter and
+  // the layout only ever see the new lines, so each piece costs the same however big the file is.
+  QElapsedTimer elapsed;
+  elapsed.start();
+  QTextCursor cursor(document());
+  cursor.movePosition(QTextCursor::End);
+  int length = loadText_.length();
+  while (loadPosition_ != length && elapsed.elapsed() < 15) {
+    int end = loadText_.indexOf('\n', qMin(loadPosition_ + 0x10000, length - 1));
+    end = end == -1 ? length : end + 1;
+    cursor.insertText(loadText_.mid(loadPosition_, end - loadPosition_));
+    loadPosition_ = end;
+  }
+  // Filling it in isn't a change they made.
+  document()->setModified(false);
+  if (loadPosition_ != length) {
+    emit loadProgress(static_cast<int>(static_cast<qint64>(loadPosition_) * 100 / length));
+    return;
+  }
+  loadTimer_.stop();
+  loadText_.clear();
+  loading_ = false;
+  document()->setUndoRedoEnabled(true);
+  setReadOnly(false);
+  // The cursor was pushed along by the first piece.
+  QTextCursor start = textCursor();
+  start.setPosition(0);
+  setTextCursor(start);
+  if (pendingView_.Anchor != -1) {
+    setView(pendingView_);
+  } else if (pendingLine_) {
+    jumpToLine(pendingLine_, pendingColumn_);
+  }
+  pendingView_.Anchor = -1;
+  pendingLine_ = 0;
+  if (!recovered_.isEmpty() && loadError_.isEmpty()) {
+    // Still not saved, so it carries on in the journal it came from, and the changes are the ones
+    // from the file it was for.
+    journal_.resume(recovered_);
+    document()->setModified(true);
+    changes_.compareWithFile(EditJournal::fileName(recovered_));
+  } else {
+    changes_.reset();
+  }
+  recovered_.clear();
+  highlightCurrentLine();
+  emit loadProgress(100);
+  emit loaded();
+}
+
+editor_view_s EditorWidget::view() const {
+  if (loading_ && pendingView_.Anchor != -1) {
+    return pendingView_;
+  }
+  QTextCursor cursor = textCursor();
+  return { cursor.anchor(), cursor.position(), verticalScrollBar()->value() };
+}
+
+void EditorWidget::setView(const editor_view_s &view) {
+  if (loading_) {
+    pendingView_ = view;
+    pendingLine_ = 0;
+    return;
+  }
+  int end = document()->characterCount() - 1;
+  QTextCursor cursor = textCursor();
+  cursor.setPosition(qBound(0, view.Anchor, end), QTextCursor::MoveAnchor);
+  cursor.setPosition(qBound(0, view.Position, end), QTextCursor::KeepAnchor);
+  setTextCursor(cursor);
+  if (view.Scroll != -1) {
+    verticalScrollBar()->setValue(view.Scroll);
+  }
+}
+
+void EditorWidget::jumpToLine(long line, int column) {
+  if (loading_) {
+    pendingView_.Anchor = -1;
+    pendingLine_ = line;
+    pendingColumn_ = column;
+    return;
+  }
   if (line > 0 && line <= blockCount()) {
     QTextCursor cursor = textCursor();
-    int pos = document()->findBlockByLineNumber(line - 1).position();
-    cursor.setPosition(pos);
+    QTextBlock block = document()->findBlockByLineNumber(line - 1);
+    cursor.setPosition(block.position() + qBound(0, column, block.length() - 1));
     setTextCursor(cursor);
   }
 }
@@ -190,6 +526,16 @@ void EditorWidget::resizeEvent(QResizeEvent *event) {
   lineNumberArea_.updateGeometry();
 }
 
+void EditorWidget::mousePressEvent(QMouseEvent *event) {
+  if (event->button() == Qt::LeftButton && (event->modifiers() & Qt::ControlModifier)) {
+    setTextCursor(cursorForPosition(event->pos()));
+    emit definitionRequested();
+    event->accept();
+    return;
+  }
+  QPlainTextEdit::mousePressEvent(event);
+}
+
 void EditorWidget::keyPressEvent(QKeyEvent *event) {
   QTextCursor cursor = textCursor();
   bool removePrevChar = false;
@@ -229,9 +575,14 @@ void EditorWidget::keyPressEvent(QKeyEvent *event) {
   }
 }
 
+void EditorWidget::setHighlights(const QList<QTextEdit::ExtraSelection> &highlights) {
+  highlights_ = highlights;
+  highlightCurrentLine();
+}
+
 void EditorWidget::highlightCurrentLine() {
+  QList<QTextEdit::ExtraSelection> extraSelections;
   if (!isReadOnly()) {
-    QList<QTextEdit::ExtraSelection> extraSelections;
     QTextEdit::ExtraSelection selection;
     if (usingDarkMode) {
       selection.format.setBackground(QColor(0x2D333D));
@@ -241,8 +592,9 @@ void EditorWidget::highlightCurrentLine() {
     selection.format.setProperty(QTextFormat::FullWidthSelection, true);
     selection.cursor = textCursor();
     selection.cursor.clearSelection();
-    setExtraSelections(extraSelections << selection);
+    extraSelections << selection;
   }
+  setExtraSelections(extraSelections << highlights_);
 }
 
 void EditorWidget::editSelectedText(QTextCursor cursor,
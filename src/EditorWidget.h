@@ -18,11 +18,28 @@
 
 #include <functional>
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QPlainTextEdit>
-
+#include <QTextEdit>
+#include <QTimer>
+
+#include "BufferReferences.h"
+#include "EditJournal.h"
+#include "FileLoader.h"
+#include "LineChanges.h"
+#include "LineDiff.h"
 #include "SyntaxHighlighter.h"
 
 class EditorWidget;
+class QPainter;
+
+// Where the cursor is and how far down the file is scrolled, for putting a tab back as it was.
+struct editor_view_s {
+  int Anchor;
+  int Position;
+  int Scroll; // `-1` to leave it wherever the cursor puts it.
+};
 
 class EditorLineNumberWidget: public QWidget {
  Q_OBJECT
@@ -42,6 +59,9 @@ class EditorLineNumberWidget: public QWidget {
  protected:
   void paintEvent(QPaintEvent *event) override;
   void resizeEvent(QResizeEvent *event) override;
+
+ private:
+  void paintChange(QPainter &painter, int change, const QRect &bar);
 };
 
 class EditorWidget: public QPlainTextEdit {
@@ -53,6 +73,9 @@ class EditorWidget: public QPlainTextEdit {
   explicit EditorWidget(QWidget *parent = 0);
   ~EditorWidget() override;
 
+  // The font chosen for editors, or the default one.
+  static QFont editorFont();
+
   int tabWidth() const;
   void setTabWidth(int width);
 
@@ -65,15 +88,74 @@ class EditorWidget: public QPlainTextEdit {
   void duplicateSelection(bool lines);
   void deleteSelection();
 
+  const BufferReferences &references() const;
+  EditJournal &journal();
+
+  // Replace every one of `matches` (in document order) with `replacement`, as one edit and one undo
+  // step.  The cursor stays where it was relative to the text around it.
+  void replaceMatches(const QVector<result_s> &matches, const QString &replacement);
+  // The same, for sorted, non-overlapping (position, length) pairs.
+  void replaceRanges(const QVector<QPair<int, int>> &ranges, const QString &replacement);
+
+  // Turns the text in to `lines` (the file as it now is on disk) by changing only the lines in
+  // `hunks`, as one undo step.  The cursor and everything else on the lines around stay put.
+  void reload(const QVector<diff_hunk_s> &hunks, const QStringList &lines,
+              file_encoding_e encoding, bool bom);
+
+  // When the file was last read or written, and how big it was, for telling when something else
+  // changes it.
+  void setDiskState(qint64 modified, qint64 size);
+  bool matchesDisk(qint64 modified, qint64 size) const;
+
+  // Extra highlighting drawn on top of the current line, such as find matches.
+  void setHighlights(const QList<QTextEdit::ExtraSelection> &highlights);
+
+  // Reads `path` on a worker, then fills the document a piece at a time between events.  Read-only
+  // until it is all in, and emits `loaded` once it is (or once it has failed).
+  void load(const QString &path);
+  // The same, but not until `loadNow` is called.  Counts as loading until then.
+  void loadLater(const QString &path);
+  // The same again, but from text packed away when the tab was hibernated instead of the disk.
+  void loadLater(const packed_file_s &file);
+  void loadNow();
+  // Loads the unsaved text left in a journal by a crash, still unsaved, in place of anything else.
+  void recover(const QString &journal);
+  bool isLoading() const;
+  bool isDeferred() const;
+  bool isHibernating() const;
+  const QString &loadError() const;
+
+  // What the file was in, so that it is saved back out the same way.
+  file_encoding_e encoding() const;
+  bool hasByteOrderMark() const;
+
+  // The view now, or the one it will have once it has loaded.  Setting it waits for the file if it
+  // is still loading.
+  editor_view_s view() const;
+  void setView(const editor_view_s &view);
+
+  // How long since it was last on screen, or `0` if it is now.
+  qint64 idleTime() const;
+
+ signals:
+  // Ctrl+click, with the cursor already moved to where they clicked.
+  void definitionRequested();
+  void loadProgress(int percent);
+  void loaded();
+
  public slots:
-  void jumpToLine(long line);
+  void jumpToLine(long line, int column = 0);
 
  protected:
   void resizeEvent(QResizeEvent *event) override;
   void keyPressEvent(QKeyEvent *event) override;
+  void mousePressEvent(QMouseEvent *event) override;
+  void hideEvent(QHideEvent *event) override;
 
  private slots:
   void highlightCurrentLine();
+  void fileRead();
+  void loadChunk();
 
  private:
   void editSelectedText(QTextCursor cursor,
@@ -90,6 +172,30 @@ class EditorWidget: public QPlainTextEdit {
  private:
   EditorLineNumberWidget lineNumberArea_;
   SyntaxHighlighter highlighter_;
+  BufferReferences references_;
+  EditJournal journal_;
+  LineChanges changes_;
+  QList<QTextEdit::ExtraSelection> highlights_;
+
+  // Loading, and where to go once it is done.
+  QFutureWatcher<loaded_file_s> reader_;
+  QTimer loadTimer_;
+  QString loadText_;
+  int loadPosition_ = 0;
+  bool loading_ = false;
+  QString deferred_;
+  QString recovered_;
+  qint64 diskModified_ = 0;
+  qint64 diskSize_ = -1;
+  bool hibernating_ = false;
+  packed_file_s packed_ {};
+  QElapsedTimer hidden_;
+  QString loadError_;
+  file_encoding_e encoding_ = file_encoding_ascii;
+  bool bom_ = false;
+  editor_view_s pendingView_ { -1, -1, -1 };
+  long pendingLine_ = 0;
+  int pendingColumn_ = 0;
   bool usingDarkMode = false;
   int tabWidth_ = 4;
   int indentWidth_ = 4;
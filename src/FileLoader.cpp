@@ -0,0 +1,152 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextCodec>
+
+#include <limits>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LOADER_SSE2
+#endif
+
+#include "FileLoader.h"
+
+loaded_file_s FileLoader::read(const QString &path) {
+  loaded_file_s file { path, QString(), file_encoding_ascii, false, QString() };
+  QFile f{path};
+  if (!f.open(QFile::ReadOnly)) {
+    file.Error = f.errorString();
+    return file;
+  }
+  qint64 size = f.size();
+  if (size > std::numeric_limits<int>::max()) {
+    file.Error = QCoreApplication::translate("FileLoader", "The file is too large");
+    return file;
+  }
+  // Mapped where possible, so the only copy made is the decoded text.
+  QByteArray copy;
+  const char* data;
+  uchar* mapped = size ? f.map(0, size) : nullptr;
+  if (mapped) {
+    data = reinterpret_cast<const char*>(mapped);
+  } else {
+    copy = f.readAll();
+    data = copy.constData();
+    size = copy.size();
+  }
+  decode(data, size, file);
+  if (mapped) {
+    f.unmap(mapped);
+  }
+  return file;
+}
+
+void FileLoader::decode(const char *data, qint64 size, loaded_file_s &file) {
+  file.Bom = false;
+  if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+    // A byte order mark settles it.
+    file.Encoding = file_encoding_utf8;
+    file.Bom = true;
+    data += 3;
+    size -= 3;
+  } else {
+    file.Encoding = detect(data, size);
+  }
+  int length = static_cast<int>(size);
+  switch (file.Encoding) {
+  case file_encoding_ascii:
+    file.Text = QString::fromLatin1(data, length);
+    break;
+  case file_encoding_utf8:
+    file.Text = QString::fromUtf8(data, length);
+    break;
+  case file_encoding_windows1251:
+    file.Text = QTextCodec::codecForName("Windows-1251")->toUnicode(data, length);
+    break;
+  }
+}
+
+file_encoding_e FileLoader::detect(const char *data, qint64 size) {
+  const uchar* p = reinterpret_cast<const uchar*>(data);
+  const uchar* end = p + size;
+  bool ascii = true;
+  while (p != end) {
+#ifdef LOADER_SSE2
+    // Nearly all of any script is ASCII, so skip over it sixteen bytes at a time.
+    while (end - p >= 16
+           && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) == 0) {
+      p += 16;
+    }
+    if (p == end) {
+      break;
+    }
+#endif
+    uchar c = *p;
+    if (c < 0x80) {
+      ++p;
+      continue;
+    }
+    ascii = false;
+    int n;
+    uint code, lowest;
+    if ((c & 0xE0) == 0xC0) {
+      n = 1;
+      code = c & 0x1F;
+      lowest = 0x80;
+    } else if ((c & 0xF0) == 0xE0) {
+      n = 2;
+      code = c & 0x0F;
+      lowest = 0x800;
+    } else if ((c & 0xF8) == 0xF0) {
+      n = 3;
+      code = c & 0x07;
+      lowest = 0x10000;
+    } else {
+      return file_encoding_windows1251;
+    }
+    if (end - p <= n) {
+      return file_encoding_windows1251;
+    }
+    for (int i = 1; i <= n; ++i) {
+      if ((p[i] & 0xC0) != 0x80) {
+        return file_encoding_windows1251;
+      }
+      code = (code << 6) | (p[i] & 0x3F);
+    }
+    // Overlong encodings, surrogates, and anything past the end of Unicode aren't real UTF-8.
+    if (code < lowest || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+      return file_encoding_windows1251;
+    }
+    p += n + 1;
+  }
+  return ascii ? file_encoding_ascii : file_encoding_utf8;
+}
+
+packed_file_s FileLoader::pack(const loaded_file_s &file) {
+  // Scripts are mostly ASCII, so UTF-8 halves it before zlib even starts.
+  return { file.Path, qCompress(file.Text.toUtf8()), file.Encoding, file.Bom };
+}
+
+loaded_file_s FileLoader::unpack(const packed_file_s &file) {
+  return { file.Path, QString::fromUtf8(qUncompress(file.Data)), file.Encoding, file.Bom, QString() };
+}
+
+QByteArray FileLoader::codecName(file_encoding_e encoding) {
+  return encoding == file_encoding_utf8 ? "UTF-8" : "Windows-1251";
+}
@@ -0,0 +1,69 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QByteArray>
+#include <QString>
+
+// Which way the bytes of a file become text.
+enum file_encoding_e {
+  file_encoding_ascii, // Nothing over 0x7F, so it could be either of the others.
+  file_encoding_utf8,
+  file_encoding_windows1251,
+};
+
+// One file read and decoded, ready to go in to an editor.
+struct loaded_file_s {
+  QString Path;
+  QString Text;
+  file_encoding_e Encoding;
+  bool Bom;
+  QString Error;
+};
+
+// A file's text compressed, for keeping a hibernating tab in as little memory as possible.
+struct packed_file_s {
+  QString Path;
+  QByteArray Data;
+  file_encoding_e Encoding;
+  bool Bom;
+};
+
+// Reading files for the editor.  Everything here blocks, and is meant to be run on a worker so that
+// opening a huge file doesn't stop the window responding.
+class FileLoader {
+ public:
+  // Maps `path`, works out what it is encoded in, and decodes it.
+  static loaded_file_s read(const QString &path);
+
+  // Works out what `data` is encoded in, and decodes it in to `file`.
+  static void decode(const char *data, qint64 size, loaded_file_s &file);
+
+  // Anything that isn't plain ASCII and is entirely valid UTF-8 is almost certainly UTF-8, since
+  // Cyrillic in Windows-1251 very rarely forms valid multi-byte sequences.  Everything else is
+  // assumed to be Windows-1251, as the compiler has always been fed.
+  static file_encoding_e detect(const char *data, qint64 size);
+
+  // Squeeze `file` down, and back up again.
+  static packed_file_s pack(const loaded_file_s &file);
+  static loaded_file_s unpack(const packed_file_s &file);
+
+  // The codec name to save `encoding` back out with.
+  static QByteArray codecName(file_encoding_e encoding);
+};
+
+#endif // FILELOADER_H
@@ -0,0 +1,57 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDateTime>
+#include <QFile>
+#include <QSaveFile>
+#include <QTextCodec>
+#include <QtConcurrent>
+
+#include <string.h>
+
+#include "FileSaver.h"
+#include "LocalHistory.h"
+
+saved_file_s FileSaver::save(const save_job_s &job) {
+  saved_file_s saved { job.Path, QString(), false };
+  QTextCodec* codec = QTextCodec::codecForName(FileLoader::codecName(job.Encoding));
+  QByteArray data = codec->fromUnicode(job.Text);
+  if (job.Bom && job.Encoding == file_encoding_utf8) {
+    data.prepend("\xEF\xBB\xBF");
+  }
+  QFile old{job.Path};
+  if (old.open(QFile::ReadOnly) && old.size() == data.size()) {
+    uchar* mapped = data.size() ? old.map(0, data.size()) : nullptr;
+    bool same = mapped ? memcmp(mapped, data.constData(), data.size()) == 0 : old.readAll() == data;
+    if (mapped) {
+      old.unmap(mapped);
+    }
+    if (same) {
+      return saved;
+    }
+  }
+  old.close();
+  // Written next to the old one, synced, then renamed over it.
+  QSaveFile file{job.Path};
+  if (!file.open(QFile::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+    saved.Error = file.errorString();
+    return saved;
+  }
+  saved.Written = true;
+  // Cutting and compressing a big file takes a while, and saving one file happens on the window's
+  // thread, so the history is left to a worker.  It has its own copy of the bytes written.
+  QtConcurrent::run(&LocalHistory::record, job.Path, data, QDateTime::currentMSecsSinceEpoch());
+  return saved;
+}
@@ -0,0 +1,47 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include <QString>
+
+#include "FileLoader.h"
+
+// One document to write out, copied from the editor so that it can carry on while it is.
+struct save_job_s {
+  QString Path;
+  QString Text;
+  file_encoding_e Encoding;
+  bool Bom;
+};
+
+struct saved_file_s {
+  QString Path;
+  QString Error;
+  bool Written; // `false` when the file already said exactly this.
+};
+
+// Writing files for the editor.  Blocking, so meant for workers (apart from saving one file).
+class FileSaver {
+ public:
+  // Encodes `job` the way the file came in and replaces the file with it in one go, so nothing ever
+  // sees it half written.  A file that wouldn't change isn't touched at all, so that it keeps its
+  // modified time and nothing watching it thinks it needs rebuilding.  Everything that is written
+  // is also kept in the local history, in the background so that this doesn't wait for it.
+  static saved_file_s save(const save_job_s &job);
+};
+
+#endif // FILESAVER_H
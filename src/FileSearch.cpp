@@ -0,0 +1,178 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QByteArrayMatcher>
+#include <QDirIterator>
+#include <QFile>
+#include <QSet>
+#include <QTextCodec>
+#include <QtConcurrent>
+
+#include <string.h>
+
+#include "FileLoader.h"
+#include "FileSearch.h"
+#include "IncludeGraph.h"
+
+// Letters and digits in ASCII and Cyrillic, plus the extra symbol characters Pawn allows.
+static bool isWordByte(unsigned char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'
+      || c == '@' || c >= 0xC0 || c == 0xA8 || c == 0xB8;
+}
+
+// Searches one file on a worker.  A function object so that the options can come along.
+struct file_searcher_s {
+  typedef result_file_s result_type;
+
+  // Case sensitive plain text is matched on the raw bytes of Windows-1251 and ASCII files,
+  // everything else is decoded first.
+  bool Literal;
+  QByteArray Needle;
+  QByteArrayMatcher Matcher;
+  search_options_s Options;
+  std::function<bool(const QString &path)> Filter;
+
+  result_file_s operator()(const search_job_s &job) const {
+    result_file_s file { job.Path, QVector<result_s>(), QString() };
+    if (job.Open) {
+      // Already decoded by the editor, however it was encoded on disk.
+      searchText(job.Text, file);
+      return file;
+    }
+    if (Filter && !Filter(job.Path)) {
+      return file;
+    }
+    QFile f{job.Path};
+    if (!f.open(QFile::ReadOnly)) {
+      file.Error = f.errorString();
+      return file;
+    }
+    qint64 size = f.size();
+    if (size == 0) {
+      return file;
+    }
+    QByteArray buffer;
+    const char* data = nullptr;
+    uchar* mapped = f.map(0, size);
+    if (mapped) {
+      data = reinterpret_cast<const char*>(mapped);
+    } else {
+      buffer = f.readAll();
+      data = buffer.constData();
+      size = buffer.size();
+    }
+    // The same guess the editor makes when it opens the file, so both find the same things.
+    bool bom = size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0;
+    if (bom || FileLoader::detect(data, size) == file_encoding_utf8) {
+      loaded_file_s decoded;
+      FileLoader::decode(data, size, decoded);
+      searchText(decoded.Text, file);
+    } else {
+      searchBytes(data, size, file);
+    }
+    if (mapped) {
+      f.unmap(mapped);
+    }
+    return file;
+  }
+
+  // Windows-1251 is one byte per character, so byte offsets are also offsets in to the text.
+  void searchBytes(const char *data, qint64 size, result_file_s &file) const {
+    QTextCodec* codec = QTextCodec::codecForName("Windows-1251");
+    find_matches_t matches;
+    if (Literal) {
+      int length = Needle.size();
+      for (int at = Matcher.indexIn(data, static_cast<int>(size)); at != -1;
+           at = Matcher.indexIn(data, static_cast<int>(size), at + length)) {
+        if (Options.WholeWords && ((at > 0 && isWordByte(data[at - 1]))
+                           || (at + length < size && isWordByte(data[at + length])))) {
+          continue;
+        }
+        matches.push_back({ at, length });
+      }
+    } else {
+      matches = SearchEngine::findAll(codec->toUnicode(data, static_cast<int>(size)), Options);
+    }
+    // Matches are in file order, so lines are counted in one pass however many there are.
+    const char* end = data + size;
+    const char* line = data;
+    int number = 0;
+    for (auto const & match : matches) {
+      const char* at = data + match.first;
+      while (const char* next = static_cast<const char*>(memchr(line, '\n', at - line))) {
+        line = next + 1;
+        ++number;
+      }
+      const char* eol = static_cast<const char*>(memchr(line, '\n', end - line));
+      QString text = codec->toUnicode(line, static_cast<int>((eol ? eol : end) - line));
+      if (text.endsWith('\r')) {
+        text.chop(1);
+      }
+      file.Results.push_back({ number, static_cast<int>(at - line), match.second, text });
+    }
+  }
+
+  void searchText(const QString &text, result_file_s &file) const {
+    find_matches_t matches = SearchEngine::findAll(text, Options);
+    int line = 0;
+    int number = 0;
+    for (auto const & match : matches) {
+      for (int next; (next = text.indexOf('\n', line)) != -1 && next < match.first; ) {
+        line = next + 1;
+        ++number;
+      }
+      int eol = text.indexOf('\n', line);
+      QString content = text.mid(line, (eol == -1 ? text.length() : eol) - line);
+      if (content.endsWith('\r')) {
+        content.chop(1);
+      }
+      file.Results.push_back({ number, match.first - line, match.second, content });
+    }
+  }
+};
+
+QStringList FileSearch::files(const QStringList &directories, int limit) {
+  QStringList files;
+  QSet<QString> seen;
+  for (auto const & directory : directories) {
+    QDirIterator it(directory, QStringList() << "*.pwn" << "*.inc" << "*.p" << "*.pawn",
+                    QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    while (it.hasNext() && files.size() != limit) {
+      QString path = IncludeGraph::normalise(it.next());
+      if (!seen.contains(path)) {
+        seen.insert(path);
+        files.push_back(path);
+      }
+    }
+  }
+  return files;
+}
+
+QFuture<result_file_s> FileSearch::start(const QVector<search_job_s> &jobs, const search_options_s &options,
+                                         std::function<bool(const QString &path)> filter) {
+  QTextCodec* codec = QTextCodec::codecForName("Windows-1251");
+  file_searcher_s searcher;
+  searcher.Literal = options.MatchCase && !options.RegExp && codec->canEncode(options.Text);
+  searcher.Options = options;
+  searcher.Filter = filter;
+  if (searcher.Literal) {
+    searcher.Needle = codec->fromUnicode(options.Text);
+    searcher.Matcher.setPattern(searcher.Needle);
+  } else if (options.RegExp) {
+    // Compile it once here, so the workers all find it in the cache.
+    SearchEngine::pattern(options);
+  }
+  return QtConcurrent::mapped(jobs, searcher);
+}
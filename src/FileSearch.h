@@ -0,0 +1,52 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FILESEARCH_H
+#define FILESEARCH_H
+
+#include <functional>
+
+#include <QFuture>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "ResultsWidget.h"
+#include "SearchEngine.h"
+
+// One file to look through.  Open files bring their current text with them, so that unsaved
+// changes are searched rather than what is on disk.
+struct search_job_s {
+  QString Path;
+  bool Open;
+  QString Text;
+};
+
+// Find in Files.  Every file is searched on the thread pool, straight from a mapping of its raw
+// bytes where they are Windows-1251 or ASCII, and decoded first where they are UTF-8.  Results are
+// returned one file at a time as each finishes.
+class FileSearch {
+ public:
+  // Every Pawn source file in `directories` and their subdirectories, each listed once.  Stops after
+  // `limit` files, unless it is negative.
+  static QStringList files(const QStringList &directories, int limit = -1);
+
+  // Files that aren't open are skipped without being read if `filter` says they can't match.  It
+  // is called on the workers, so can check the disk without holding up the window.
+  static QFuture<result_file_s> start(const QVector<search_job_s> &jobs, const search_options_s &options,
+                                      std::function<bool(const QString &path)> filter = nullptr);
+};
+
+#endif // FILESEARCH_H
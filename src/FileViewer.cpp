@@ -0,0 +1,567 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPlainTextDocumentLayout>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextCodec>
+#include <QTextLayout>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+#include "EditorWidget.h"
+#include "FileViewer.h"
+
+static const qint64 SliceSize = Q_INT64_C(32) << 20;
+static const int Stride = 256;
+static const qint64 LongestLine = 4096; // Bytes of one line shown, past that is cut off.
+static const int Context = 16; // Lines above the screen given to the highlighter.
+static const qint64 SearchWindow = Q_INT64_C(1) << 20;
+
+static QString decodeBytes(const char *data, qint64 length, file_encoding_e encoding) {
+  int n = static_cast<int>(length);
+  switch (encoding) {
+  case file_encoding_utf8:
+    return QString::fromUtf8(data, n);
+  case file_encoding_windows1251:
+    return QTextCodec::codecForName("Windows-1251")->toUnicode(data, n);
+  default:
+    return QString::fromLatin1(data, n);
+  }
+}
+
+// Counts the newlines in one slice of the file, remembering every `Stride`th.
+struct line_indexer_s {
+  typedef line_slice_s result_type;
+
+  const char* Data;
+
+  line_slice_s operator()(const QPair<qint64, qint64> &range) const {
+    line_slice_s slice { range.first, range.second, 0, QVector<qint64>() };
+    const char* p = Data + range.first;
+    const char* end = Data + range.second;
+    while (p != end) {
+      const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+      if (!newline) {
+        break;
+      }
+      if (slice.Newlines % Stride == 0) {
+        slice.Checkpoints.push_back(newline - Data);
+      }
+      ++slice.Newlines;
+      p = newline + 1;
+    }
+    return slice;
+  }
+};
+
+// Looks through the mapped bytes a window of whole lines at a time, decoding each window and
+// handing it to the search engine, so that every option works exactly as it does in the editor.
+// Matches can't span two windows, which only matters for patterns matching across lines.
+struct viewer_search_s {
+  typedef QPair<qint64, qint64> result_type;
+
+  const char* Data;
+  qint64 Size;
+  file_encoding_e Encoding;
+  search_options_s Options;
+  qint64 From;
+  bool Backwards;
+  QAtomicInt* Current;
+  int Generation;
+
+  result_type operator()() const {
+    result_type result(-1, 0);
+    // To the end (or start), then wrap around to where it started.
+    if (Backwards) {
+      if (!backward(From, 0, result)) {
+        backward(Size, From, result);
+      }
+    } else if (!forward(From, Size, result)) {
+      forward(0, From, result);
+    }
+    return result;
+  }
+
+  bool stopped() const {
+    return Current->load() != Generation;
+  }
+
+  // The start of the line holding `offset`, not looking back more than a window.
+  qint64 lineStart(qint64 offset) const {
+    qint64 limit = qMax<qint64>(0, offset - SearchWindow);
+    while (offset > limit && Data[offset - 1] != '\n') {
+      --offset;
+    }
+    return offset;
+  }
+
+  // Just past the end of the line holding `offset`, not looking on more than a window.
+  qint64 lineEnd(qint64 offset) const {
+    if (offset >= Size) {
+      return Size;
+    }
+    qint64 limit = qMin(Size - offset, SearchWindow);
+    const char* newline = static_cast<const char*>(memchr(Data + offset, '\n', limit));
+    if (newline) {
+      return newline - Data + 1;
+    }
+    offset += limit;
+    // Don't cut a character in half.
+    while (Encoding == file_encoding_utf8 && offset < Size && (Data[offset] & 0xC0) == 0x80) {
+      ++offset;
+    }
+    return offset;
+  }
+
+  bool forward(qint64 from, qint64 stop, result_type &result) const {
+    qint64 begin = lineStart(from);
+    while (begin < stop && !stopped()) {
+      qint64 end = lineEnd(qMin(begin + SearchWindow, Size));
+      if (search(begin, end, from, result)) {
+        return true;
+      }
+      begin = end;
+    }
+    return false;
+  }
+
+  bool backward(qint64 from, qint64 stop, result_type &result) const {
+    qint64 end = lineEnd(from);
+    while (end > stop && !stopped()) {
+      qint64 begin = end <= SearchWindow ? 0 : lineStart(end - SearchWindow);
+      if (search(begin, end, from, result)) {
+        return true;
+      }
+      end = begin;
+    }
+    return false;
+  }
+
+  // The first match at or after `from` in `begin` to `end` (or the last one before it).
+  bool search(qint64 begin, qint64 end, qint64 from, result_type &result) const {
+    QString text = decodeBytes(Data + begin, end - begin, Encoding);
+    find_matches_t matches = SearchEngine::findAll(text, Options, Current, Generation);
+    if (matches.isEmpty()) {
+      return false;
+    }
+    int at;
+    if (from <= begin) {
+      at = 0;
+    } else if (from >= end) {
+      at = std::numeric_limits<int>::max();
+    } else {
+      at = Encoding == file_encoding_utf8
+        ? decodeBytes(Data + begin, from - begin, Encoding).length()
+        : static_cast<int>(from - begin);
+    }
+    const QPair<int, int>* match = nullptr;
+    if (Backwards) {
+      for (auto const & candidate : matches) {
+        if (candidate.first >= at) {
+          break;
+        }
+        match = &candidate;
+      }
+    } else {
+      for (auto const & candidate : matches) {
+        if (candidate.first >= at) {
+          match = &candidate;
+          break;
+        }
+      }
+    }
+    if (!match) {
+      return false;
+    }
+    if (Encoding == file_encoding_utf8) {
+      result.first = begin + text.leftRef(match->first).toUtf8().size();
+      result.second = text.midRef(match->first, match->second).toUtf8().size();
+    } else {
+      result.first = begin + match->first;
+      result.second = match->second;
+    }
+    return true;
+  }
+};
+
+FileViewer::FileViewer(QWidget *parent)
+  : QAbstractScrollArea(parent),
+    highlighter_(this)
+{
+  setFont(EditorWidget::editorFont());
+  // The same layout as the editor, so lines look just the same.
+  lines_.setDocumentLayout(new QPlainTextDocumentLayout(&lines_));
+  lines_.setDocumentMargin(0);
+  lines_.setDefaultFont(font());
+  QTextOption option = lines_.defaultTextOption();
+  option.setWrapMode(QTextOption::NoWrap);
+  option.setTabStopDistance(static_cast<double>(fontMetrics().horizontalAdvance(' ')) * 4.0);
+  lines_.setDefaultTextOption(option);
+  lines_.setUndoRedoEnabled(false);
+  highlighter_.setDocument(&lines_);
+
+  connect(&indexer_, SIGNAL(resultReadyAt(int)), SLOT(sliceIndexed(int)));
+  connect(&searcher_, SIGNAL(finished()), SLOT(searchFinished()));
+}
+
+FileViewer::~FileViewer() {
+  // Both read straight from the mapping.
+  generation_.fetchAndAddOrdered(1);
+  indexer_.cancel();
+  indexer_.waitForFinished();
+  searcher_.waitForFinished();
+}
+
+bool FileViewer::open(const QString &path) {
+  file_.setFileName(path);
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+  size_ = file_.size();
+  if (size_) {
+    uchar* mapped = file_.map(0, size_);
+    if (!mapped) {
+      return false;
+    }
+    data_ = reinterpret_cast<const char*>(mapped);
+  }
+  if (size_ >= 3 && memcmp(data_, "\xEF\xBB\xBF", 3) == 0) {
+    encoding_ = file_encoding_utf8;
+    bom_ = 3;
+  } else {
+    // Judge by the first megabyte, in whole lines.
+    qint64 sample = qMin(size_, Q_INT64_C(1) << 20);
+    qint64 cut = sample;
+    while (cut < size_ && cut > 0 && data_[cut - 1] != '\n') {
+      --cut;
+    }
+    encoding_ = FileLoader::detect(data_, cut ? cut : sample);
+  }
+  QVector<QPair<qint64, qint64>> ranges;
+  for (qint64 begin = 0; begin < size_; begin += SliceSize) {
+    ranges.push_back(qMakePair(begin, qMin(size_, begin + SliceSize)));
+  }
+  sliceCount_ = ranges.size();
+  indexer_.setFuture(QtConcurrent::mapped(ranges, line_indexer_s { data_ }));
+  updateScrollBars();
+  return true;
+}
+
+QString FileViewer::errorString() const {
+  return file_.errorString();
+}
+
+qint64 FileViewer::lineCount() const {
+  return newlines_ + 1;
+}
+
+bool FileViewer::indexed() const {
+  return slices_.size() == sliceCount_;
+}
+
+qint64 FileViewer::lineStart(qint64 line) const {
+  if (line <= 0) {
+    return bom_;
+  }
+  // The slice with the newline before this line in it.  Slices without any can't be picked, as
+  // they start with the same count as the next one.
+  qint64 newline = line - 1;
+  int slice = static_cast<int>(std::upper_bound(before_.constBegin(), before_.constEnd(), newline)
+                               - before_.constBegin()) - 1;
+  qint64 nth = newline - before_[slice];
+  qint64 offset = slices_[slice].Checkpoints[static_cast<int>(nth / Stride)];
+  for (qint64 i = nth % Stride; i; --i) {
+    offset = static_cast<const char*>(memchr(data_ + offset + 1, '\n', size_ - offset - 1)) - data_;
+  }
+  return offset + 1;
+}
+
+qint64 FileViewer::lineEnd(qint64 line, qint64 start) const {
+  // Long lines are cut off anyway, so don't look far for the end of one.
+  qint64 limit = qMin(size_ - start, LongestLine + 1);
+  const char* newline = limit > 0 ? static_cast<const char*>(memchr(data_ + start, '\n', limit)) : nullptr;
+  if (newline) {
+    return newline - data_;
+  }
+  return line + 1 < lineCount() ? lineStart(line + 1) - 1 : size_;
+}
+
+qint64 FileViewer::lineAt(qint64 offset) const {
+  if (slices_.isEmpty() || offset >= slices_.last().End) {
+    // Not indexed yet.
+    return -1;
+  }
+  int slice = static_cast<int>(std::upper_bound(slices_.constBegin(), slices_.constEnd(), offset,
+                                                [](qint64 value, const line_slice_s &s) { return value < s.Begin; })
+                               - slices_.constBegin()) - 1;
+  const QVector<qint64> &checkpoints = slices_[slice].Checkpoints;
+  int known = static_cast<int>(std::lower_bound(checkpoints.constBegin(), checkpoints.constEnd(), offset)
+                               - checkpoints.constBegin());
+  // Count on from the nearest newline before it that the index has.
+  qint64 line = before_[slice];
+  qint64 p = slices_[slice].Begin;
+  if (known) {
+    line += static_cast<qint64>(known - 1) * Stride + 1;
+    p = checkpoints[known - 1] + 1;
+  }
+  while (p < offset) {
+    const char* newline = static_cast<const char*>(memchr(data_ + p, '\n', offset - p));
+    if (!newline) {
+      break;
+    }
+    ++line;
+    p = newline - data_ + 1;
+  }
+  return line;
+}
+
+QString FileViewer::decode(qint64 start, qint64 end) const {
+  return decodeBytes(data_ + start, end - start, encoding_);
+}
+
+qreal FileViewer::lineHeight() const {
+  // What the layout gives every unwrapped line.
+  return QFontMetricsF(font()).height();
+}
+
+int FileViewer::rows() const {
+  return qMax(1, static_cast<int>(viewport()->height() / lineHeight()));
+}
+
+int FileViewer::gutterWidth() const {
+  int digitWidth = fontMetrics().horizontalAdvance(QLatin1Char('0'));
+  return digitWidth * (QString::number(lineCount()).length() + 2);
+}
+
+void FileViewer::jumpToLine(qint64 line) {
+  qint64 target = line - 1;
+  if (target >= lineCount() && !indexed()) {
+    pendingLine_ = target;
+    return;
+  }
+  pendingLine_ = -1;
+  setCurrentLine(qBound<qint64>(0, target, lineCount() - 1));
+}
+
+void FileViewer::setCurrentLine(qint64 line) {
+  current_ = line;
+  qint64 first = verticalScrollBar()->value();
+  if (line < first || line >= first + rows()) {
+    verticalScrollBar()->setValue(static_cast<int>(qMax<qint64>(0, line - rows() / 3)));
+  }
+  viewport()->update();
+  emit lineChanged(line + 1);
+}
+
+void FileViewer::find(const search_options_s &options, bool backwards) {
+  if (options.Text.isEmpty() || !SearchEngine::check(options).isEmpty()) {
+    emit found(false);
+    return;
+  }
+  // On from the last match if they haven't moved since, otherwise from where they are.
+  qint64 from;
+  if (matchOffset_ != -1 && matchLine_ == current_) {
+    from = backwards ? matchOffset_ : matchOffset_ + qMax<qint64>(1, matchLength_);
+  } else {
+    from = lineStart(current_ == -1 ? verticalScrollBar()->value() : current_);
+  }
+  int generation = generation_.fetchAndAddOrdered(1) + 1;
+  searcher_.setFuture(QtConcurrent::run(viewer_search_s {
+    data_, size_, encoding_, options, from, backwards, &generation_, generation
+  }));
+}
+
+void FileViewer::searchFinished() {
+  QPair<qint64, qint64> match = searcher_.result();
+  if (match.first == -1) {
+    emit found(false);
+    return;
+  }
+  matchOffset_ = match.first;
+  matchLength_ = match.second;
+  matchLine_ = -1;
+  showMatch();
+  emit found(true);
+}
+
+void FileViewer::showMatch() {
+  matchLine_ = lineAt(matchOffset_);
+  if (matchLine_ != -1) {
+    setCurrentLine(matchLine_);
+  }
+}
+
+void FileViewer::toggleDarkMode(bool toggle) {
+  usingDarkMode_ = toggle;
+  highlighter_.setColorScheme(toggle ? SyntaxHighlighter::darkModeColorScheme
+                                     : SyntaxHighlighter::defaultColorScheme);
+  highlighter_.rehighlight();
+  viewport()->update();
+}
+
+void FileViewer::sliceIndexed(int index) {
+  // Results come in whenever each slice is done, but the index is only any use in order.
+  pending_.insert(index, indexer_.resultAt(index));
+  while (pending_.contains(slices_.size())) {
+    line_slice_s slice = pending_.take(slices_.size());
+    before_.push_back(newlines_);
+    newlines_ += slice.Newlines;
+    slices_.push_back(slice);
+  }
+  updateScrollBars();
+  if (pendingLine_ != -1 && (pendingLine_ < lineCount() || indexed())) {
+    jumpToLine(pendingLine_ + 1);
+  }
+  if (matchOffset_ != -1 && matchLine_ == -1) {
+    showMatch();
+  }
+  // The last line on screen may have only just been found to end.
+  linesFirst_ = -1;
+  viewport()->update();
+}
+
+void FileViewer::updateScrollBars() {
+  qint64 last = qMax<qint64>(0, lineCount() - rows());
+  verticalScrollBar()->setRange(0, static_cast<int>(qMin<qint64>(last, std::numeric_limits<int>::max())));
+  verticalScrollBar()->setPageStep(rows());
+  horizontalScrollBar()->setPageStep(viewport()->width());
+}
+
+void FileViewer::layoutLines() {
+  qint64 first = verticalScrollBar()->value();
+  qint64 from = qMax<qint64>(0, first - Context);
+  qint64 to = qMin(lineCount(), first + rows() + 1);
+  if (from == linesFirst_ && to - from == linesCount_) {
+    return;
+  }
+  QString text;
+  qint64 start = lineStart(from);
+  for (qint64 line = from; line != to; ++line) {
+    qint64 end = lineEnd(line, start);
+    qint64 shown = end;
+    if (shown > start && data_[shown - 1] == '\r') {
+      --shown;
+    }
+    if (line != from) {
+      text += '\n';
+    }
+    if (shown - start > LongestLine) {
+      text += decode(start, start + LongestLine);
+      text += QChar(0x2026);
+    } else {
+      text += decode(start, shown);
+    }
+    start = end + 1;
+  }
+  lines_.setPlainText(text);
+  linesFirst_ = from;
+  linesCount_ = to - from;
+  // Scroll as far right as the longest line on screen.
+  qreal widest = 0;
+  for (QTextBlock block = lines_.begin(); block.isValid(); block = block.next()) {
+    lines_.documentLayout()->blockBoundingRect(block);
+    widest = qMax(widest, block.layout()->maximumWidth());
+  }
+  horizontalScrollBar()->setRange(0, qMax(0, qCeil(widest) + gutterWidth() + 8 - viewport()->width()));
+}
+
+void FileViewer::paintEvent(QPaintEvent *event) {
+  layoutLines();
+  QPainter painter(viewport());
+  painter.fillRect(event->rect(), palette().base());
+
+  int gutter = gutterWidth();
+  int width = viewport()->width();
+  int height = viewport()->height();
+  qreal rowHeight = lineHeight();
+  qint64 first = verticalScrollBar()->value();
+  QColor current = usingDarkMode_ ? QColor(0x2D333D) : QColor(Qt::lightGray).lighter(120);
+  QTextCharFormat match;
+  match.setBackground(usingDarkMode_ ? QColor(0x61, 0x51, 0x1E) : QColor(0xFF, 0xE8, 0x7C));
+
+  painter.save();
+  painter.setClipRect(gutter, 0, width - gutter, height);
+  QTextBlock block = lines_.findBlockByNumber(static_cast<int>(first - linesFirst_));
+  qreal y = 0;
+  for (qint64 line = first; block.isValid() && y < height; ++line, block = block.next(), y += rowHeight) {
+    if (line == current_) {
+      painter.fillRect(QRectF(gutter, y, width - gutter, rowHeight), current);
+    }
+    QVector<QTextLayout::FormatRange> selections;
+    if (line == matchLine_) {
+      qint64 start = lineStart(line);
+      QTextLayout::FormatRange range;
+      range.start = decode(start, matchOffset_).length();
+      range.length = decode(matchOffset_, matchOffset_ + matchLength_).length();
+      range.format = match;
+      selections.push_back(range);
+    }
+    lines_.documentLayout()->blockBoundingRect(block);
+    block.layout()->draw(&painter, QPointF(gutter + 4 - horizontalScrollBar()->value(), y), selections);
+  }
+  painter.restore();
+
+  // Line numbers, the same as the editor's.
+  bool dark = usingDarkMode_;
+  painter.fillRect(0, 0, gutter, height, dark ? QColor(0x2D333D) : QColor(Qt::lightGray));
+  painter.setPen(dark ? QColor(0x636D83) : QColor(Qt::black));
+  int digitWidth = fontMetrics().horizontalAdvance(QLatin1Char('0'));
+  y = 0;
+  for (qint64 line = first; line < lineCount() && y < height; ++line, y += rowHeight) {
+    painter.drawText(QRectF(0, y, gutter - digitWidth, rowHeight), Qt::AlignRight, QString::number(line + 1));
+  }
+}
+
+void FileViewer::resizeEvent(QResizeEvent *event) {
+  QAbstractScrollArea::resizeEvent(event);
+  updateScrollBars();
+}
+
+void FileViewer::scrollContentsBy(int dx, int dy) {
+  Q_UNUSED(dx);
+  Q_UNUSED(dy);
+  viewport()->update();
+}
+
+void FileViewer::keyPressEvent(QKeyEvent *event) {
+  if (event->modifiers() & Qt::ControlModifier) {
+    if (event->key() == Qt::Key_Home) {
+      jumpToLine(1);
+      return;
+    } else if (event->key() == Qt::Key_End) {
+      jumpToLine(lineCount());
+      return;
+    }
+  }
+  QAbstractScrollArea::keyPressEvent(event);
+}
+
+void FileViewer::mousePressEvent(QMouseEvent *event) {
+  if (event->button() == Qt::LeftButton) {
+    qint64 line = verticalScrollBar()->value() + static_cast<qint64>(event->pos().y() / lineHeight());
+    if (line < lineCount()) {
+      setCurrentLine(line);
+    }
+  }
+  QAbstractScrollArea::mousePressEvent(event);
+}
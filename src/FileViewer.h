@@ -0,0 +1,130 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FILEVIEWER_H
+#define FILEVIEWER_H
+
+#include <QAbstractScrollArea>
+#include <QAtomicInt>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QMap>
+#include <QPair>
+#include <QTextDocument>
+#include <QVector>
+
+#include "FileLoader.h"
+#include "SearchEngine.h"
+#include "SyntaxHighlighter.h"
+
+// Where the lines in one piece of a file are.  Only every `Stride`th newline is kept, so the
+// index of a file is a tiny fraction of its size.
+struct line_slice_s {
+  qint64 Begin;
+  qint64 End;
+  qint64 Newlines;
+  QVector<qint64> Checkpoints; // Offsets of newlines 0, Stride, 2 * Stride, etc. in this piece.
+};
+
+// A read-only view of a file too big to be worth loading in to an editor, such as a server log.
+// The file is mapped rather than read, its lines are indexed in parallel in the background, and
+// only the lines on screen are ever decoded (and coloured, by a small document of their own).
+class FileViewer: public QAbstractScrollArea {
+ Q_OBJECT
+
+ public:
+  explicit FileViewer(QWidget *parent = 0);
+  ~FileViewer() override;
+
+  // Maps `path` and starts indexing it.  Returns false, with the reason in `errorString`, if it
+  // can't be mapped.
+  bool open(const QString &path);
+  QString errorString() const;
+
+  // Lines indexed so far.  Only grows, and is all of them once indexing has finished.
+  qint64 lineCount() const;
+
+  // Lines are from 1, as with the editor.  Waits for the index to reach that far if need be.
+  void jumpToLine(qint64 line);
+
+  // Looks for the next (or previous) match after the current one through the mapped bytes, in the
+  // background, wrapping around the ends.  Emits `found` when it is done.
+  void find(const search_options_s &options, bool backwards);
+
+  void toggleDarkMode(bool toggle);
+
+ signals:
+  // From 1.
+  void lineChanged(qint64 line);
+  void found(bool found);
+
+ protected:
+  void paintEvent(QPaintEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+  void keyPressEvent(QKeyEvent *event) override;
+  void mousePressEvent(QMouseEvent *event) override;
+  void scrollContentsBy(int dx, int dy) override;
+
+ private slots:
+  void sliceIndexed(int index);
+  void searchFinished();
+
+ private:
+  bool indexed() const;
+  qint64 lineStart(qint64 line) const;
+  qint64 lineEnd(qint64 line, qint64 start) const;
+  qint64 lineAt(qint64 offset) const;
+  QString decode(qint64 start, qint64 end) const;
+  qreal lineHeight() const;
+  int rows() const;
+  int gutterWidth() const;
+  void setCurrentLine(qint64 line);
+  void showMatch();
+  void layoutLines();
+  void updateScrollBars();
+
+  QFile file_;
+  const char* data_ = nullptr;
+  qint64 size_ = 0;
+  file_encoding_e encoding_ = file_encoding_ascii;
+  qint64 bom_ = 0;
+
+  // The line index, in file order, and what is still to come.
+  QFutureWatcher<line_slice_s> indexer_;
+  QVector<line_slice_s> slices_;
+  QVector<qint64> before_; // Newlines before each slice.
+  QMap<int, line_slice_s> pending_; // Finished out of order.
+  int sliceCount_ = 0;
+  qint64 newlines_ = 0;
+
+  // The lines on screen (and a few above, for comments started there).
+  QTextDocument lines_;
+  SyntaxHighlighter highlighter_;
+  qint64 linesFirst_ = -1;
+  qint64 linesCount_ = 0;
+  bool usingDarkMode_ = false;
+
+  qint64 current_ = -1;
+  qint64 pendingLine_ = -1;
+
+  // The last match, in bytes, and where it is on screen once the index reaches it.
+  QFutureWatcher<QPair<qint64, qint64>> searcher_;
+  QAtomicInt generation_;
+  qint64 matchOffset_ = -1;
+  qint64 matchLength_ = 0;
+  qint64 matchLine_ = -1;
+};
+
+#endif // FILEVIEWER_H
@@ -0,0 +1,404 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QScrollBar>
+#include <QSettings>
+#include <QTextBlock>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+#include "FindBar.h"
+
+static bool endsBefore(const QPair<int, int> &match, int position) {
+  return match.first + match.second <= position;
+}
+
+static bool startsBefore(const QPair<int, int> &match, int position) {
+  return match.first < position;
+}
+
+FindBar::FindBar(QWidget *parent)
+  : QWidget(parent),
+    edit_(new QLineEdit(this)),
+    matchCase_(new QToolButton(this)),
+    wholeWords_(new QToolButton(this)),
+    regExp_(new QToolButton(this)),
+    count_(new QLabel(this))
+{
+  setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+  QHBoxLayout* layout = new QHBoxLayout(this);
+  layout->setContentsMargins(4, 2, 4, 2);
+  layout->addWidget(new QLabel(tr("Find:"), this));
+  layout->addWidget(edit_, 1);
+  matchCase_->setText("Aa");
+  matchCase_->setToolTip(tr("Match case"));
+  wholeWords_->setText("W");
+  wholeWords_->setToolTip(tr("Match whole words only"));
+  regExp_->setText(".*");
+  regExp_->setToolTip(tr("Use regular expressions"));
+  for (QToolButton* button : { matchCase_, wholeWords_, regExp_ }) {
+    button->setCheckable(true);
+    button->setAutoRaise(true);
+    layout->addWidget(button);
+    connect(button, SIGNAL(toggled(bool)), SLOT(restart()));
+  }
+  layout->addWidget(count_);
+  QToolButton* previous = new QToolButton(this);
+  previous->setArrowType(Qt::UpArrow);
+  previous->setAutoRaise(true);
+  previous->setToolTip(tr("Find Previous (Shift+Enter)"));
+  layout->addWidget(previous);
+  QToolButton* next = new QToolButton(this);
+  next->setArrowType(Qt::DownArrow);
+  next->setAutoRaise(true);
+  next->setToolTip(tr("Find Next (Enter)"));
+  layout->addWidget(next);
+  QToolButton* close = new QToolButton(this);
+  close->setText(QString(QChar(0x00D7)));
+  close->setAutoRaise(true);
+  close->setToolTip(tr("Close (Esc)"));
+  layout->addWidget(close);
+
+  count_->setMinimumWidth(count_->fontMetrics().horizontalAdvance(tr("0000 of 0000")));
+  edit_->installEventFilter(this);
+  loadSettings();
+
+  // Edits to the document are searched again once typing pauses.
+  timer_.setSingleShot(true);
+  timer_.setInterval(200);
+  connect(&timer_, SIGNAL(timeout()), SLOT(restart()));
+  connect(edit_, SIGNAL(textChanged(QString)), SLOT(restart()));
+  connect(&future_, SIGNAL(finished()), SLOT(finished()));
+  connect(previous, SIGNAL(clicked()), SLOT(findPrevious()));
+  connect(next, SIGNAL(clicked()), SLOT(findNext()));
+  connect(close, SIGNAL(clicked()), SLOT(hide()));
+}
+
+FindBar::~FindBar() {
+  generation_.fetchAndAddOrdered(1);
+  future_.waitForFinished();
+}
+
+void FindBar::setEditor(EditorWidget *editor) {
+  if (editor == editor_) {
+    return;
+  }
+  if (editor_) {
+    editor_->setHighlights(QList<QTextEdit::ExtraSelection>());
+    disconnect(editor_, 0, this, 0);
+    disconnect(editor_->document(), 0, this, 0);
+  }
+  editor_ = editor;
+  if (editor_) {
+    connect(editor_->document(), SIGNAL(contentsChanged()), SLOT(documentChanged()));
+    connect(editor_, SIGNAL(updateRequest(QRect, int)), SLOT(updateRequest(QRect, int)));
+    connect(editor_, SIGNAL(cursorPositionChanged()), SLOT(updateCount()));
+    if (isVisible()) {
+      restart();
+    }
+  }
+}
+
+search_options_s FindBar::options() const {
+  return { edit_->text(), matchCase_->isChecked(), wholeWords_->isChecked(), regExp_->isChecked() };
+}
+
+void FindBar::activate(const QString &text) {
+  show();
+  if (editor_) {
+    start_ = editor_->textCursor().selectionStart();
+  }
+  if (!text.isEmpty() && text != edit_->text()) {
+    edit_->setText(text);
+  } else if (!current()) {
+    restart();
+  } else {
+    updateHighlights();
+  }
+  edit_->selectAll();
+  edit_->setFocus(Qt::ShortcutFocusReason);
+}
+
+void FindBar::findNext(bool backwards, std::function<void(bool found)> done) {
+  if (!editor_) {
+    if (done) {
+      done(false);
+    }
+    return;
+  }
+  if (edit_->text().isEmpty()) {
+    activate(QString());
+    if (done) {
+      done(true);
+    }
+    return;
+  }
+  if (!current() || running_ != -1) {
+    // F3 straight after typing, or after an edit, picks up from `finished`.
+    pending_ = true;
+    pendingBackwards_ = backwards;
+    pendingDone_ = done;
+    restart();
+    return;
+  }
+  bool found = step(backwards);
+  if (done) {
+    done(found);
+  }
+}
+
+bool FindBar::step(bool backwards) {
+  if (matches_.isEmpty()) {
+    return false;
+  }
+  QTextCursor cursor = editor_->textCursor();
+  find_matches_t::const_iterator it;
+  if (backwards) {
+    it = std::lower_bound(matches_.constBegin(), matches_.constEnd(), cursor.selectionStart(), startsBefore);
+    if (it == matches_.constBegin()) {
+      it = matches_.constEnd();
+    }
+    --it;
+  } else {
+    it = std::lower_bound(matches_.constBegin(), matches_.constEnd(), cursor.selectionEnd(), startsBefore);
+    if (it == matches_.constEnd()) {
+      it = matches_.constBegin();
+    }
+  }
+  select(*it);
+  return true;
+}
+
+void FindBar::loadSettings() {
+  QSettings settings;
+  QSignalBlocker blocker(edit_);
+  edit_->setText(settings.value("FindText").toString());
+  matchCase_->setChecked(settings.value("FindMatchCase").toBool());
+  wholeWords_->setChecked(settings.value("FindMatchWholeWords").toBool());
+  regExp_->setChecked(settings.value("FindUseRegexp").toBool());
+  if (isVisible()) {
+    restart();
+  }
+}
+
+bool FindBar::eventFilter(QObject *watched, QEvent *event) {
+  if (watched == edit_ && event->type() == QEvent::KeyPress) {
+    QKeyEvent* key = static_cast<QKeyEvent*>(event);
+    switch (key->key()) {
+    case Qt::Key_Escape:
+      hide();
+      if (editor_) {
+        editor_->setFocus(Qt::OtherFocusReason);
+      }
+      return true;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+      findNext(key->modifiers().testFlag(Qt::ShiftModifier));
+      return true;
+    }
+  }
+  return QWidget::eventFilter(watched, event);
+}
+
+void FindBar::hideEvent(QHideEvent *event) {
+  // Stop anything still running, and take the highlighting away with the bar.
+  generation_.fetchAndAddOrdered(1);
+  timer_.stop();
+  pending_ = false;
+  pendingDone_ = nullptr;
+  if (editor_) {
+    editor_->setHighlights(QList<QTextEdit::ExtraSelection>());
+  }
+  saveSettings();
+  QWidget::hideEvent(event);
+}
+
+void FindBar::restart() {
+  // Anything still running is for old text, and gives up as soon as it notices this.
+  int generation = generation_.fetchAndAddOrdered(1) + 1;
+  timer_.stop();
+  error_.clear();
+  search_options_s options = this->options();
+  if (!editor_ || options.Text.isEmpty()) {
+    matches_.clear();
+    matchesDocument_ = nullptr;
+    updateHighlights();
+    updateCount();
+    finishPending();
+    return;
+  }
+  error_ = SearchEngine::check(options);
+  if (!error_.isEmpty()) {
+    matches_.clear();
+    matchesDocument_ = nullptr;
+    updateHighlights();
+    updateCount();
+    finishPending();
+    return;
+  }
+  // Different text searches the same snapshot, so only an edit means copying the document again.
+  QTextDocument* document = editor_->document();
+  if (document != snapshotDocument_ || document->revision() != snapshotRevision_) {
+    snapshot_ = document->toPlainText();
+    snapshotDocument_ = document;
+    snapshotRevision_ = document->revision();
+  }
+  running_ = generation;
+  future_.setFuture(QtConcurrent::run(&SearchEngine::findAll, snapshot_, options, &generation_, generation));
+  updateCount();
+}
+
+void FindBar::documentChanged() {
+  if (isVisible()) {
+    timer_.start();
+  }
+}
+
+void FindBar::finished() {
+  if (running_ != generation_.load() || future_.isCanceled()) {
+    return;
+  }
+  running_ = -1;
+  matches_ = future_.result();
+  matchesDocument_ = snapshotDocument_;
+  matchesRevision_ = snapshotRevision_;
+  updateHighlights();
+  // Search as you type: keep selecting the first match after where the search started.
+  if (edit_->hasFocus() && current() && !matches_.isEmpty()) {
+    auto it = std::lower_bound(matches_.constBegin(), matches_.constEnd(), start_, startsBefore);
+    select(it == matches_.constEnd() ? matches_.first() : *it);
+  }
+  updateCount();
+  finishPending();
+}
+
+void FindBar::finishPending() {
+  if (!pending_) {
+    return;
+  }
+  pending_ = false;
+  std::function<void(bool found)> done = pendingDone_;
+  pendingDone_ = nullptr;
+  bool found = editor_ && current() && step(pendingBackwards_);
+  if (done) {
+    done(found);
+  }
+}
+
+void FindBar::updateHighlights() {
+  if (!editor_) {
+    return;
+  }
+  QList<QTextEdit::ExtraSelection> highlights;
+  if (isVisible() && !edit_->text().isEmpty()) {
+    if (!current()) {
+      // The old highlights move with the text until the new search is done.
+      return;
+    }
+    // Only what is on screen.
+    QRect viewport = editor_->viewport()->rect();
+    QTextBlock last = editor_->cursorForPosition(viewport.bottomRight()).block();
+    visibleStart_ = editor_->firstVisibleBlock().position();
+    visibleEnd_ = last.position() + last.length();
+    QTextCharFormat format;
+    bool dark = editor_->palette().base().color().lightness() < 128;
+    format.setBackground(dark ? QColor(0x61, 0x51, 0x1E) : QColor(0xFF, 0xE8, 0x7C));
+    auto it = std::lower_bound(matches_.constBegin(), matches_.constEnd(), visibleStart_, endsBefore);
+    for ( ; it != matches_.constEnd() && it->first < visibleEnd_; ++it) {
+      QTextEdit::ExtraSelection selection;
+      selection.format = format;
+      selection.cursor = QTextCursor(editor_->document());
+      selection.cursor.setPosition(it->first);
+      selection.cursor.setPosition(it->first + it->second, QTextCursor::KeepAnchor);
+      highlights << selection;
+    }
+  }
+  editor_->setHighlights(highlights);
+}
+
+void FindBar::updateRequest(const QRect &rect, int dy) {
+  Q_UNUSED(rect);
+  if (!editor_ || !isVisible()) {
+    return;
+  }
+  // Changing the highlights asks for a repaint too, so only go again if what is visible moved.
+  QRect viewport = editor_->viewport()->rect();
+  QTextBlock last = editor_->cursorForPosition(viewport.bottomRight()).block();
+  int start = editor_->firstVisibleBlock().position();
+  int end = last.position() + last.length();
+  if (dy != 0 || start != visibleStart_ || end != visibleEnd_) {
+    updateHighlights();
+  }
+}
+
+void FindBar::updateCount() {
+  count_->setToolTip(error_);
+  if (!error_.isEmpty()) {
+    count_->setText(tr("Invalid pattern"));
+  } else if (edit_->text().isEmpty()) {
+    count_->clear();
+  } else if (future_.isRunning()) {
+    count_->setText(tr("Searching..."));
+  } else if (matches_.isEmpty()) {
+    count_->setText(tr("No results"));
+  } else {
+    int index = -1;
+    if (editor_ && current()) {
+      QTextCursor cursor = editor_->textCursor();
+      auto it = std::lower_bound(matches_.constBegin(), matches_.constEnd(), cursor.selectionStart(), startsBefore);
+      if (it != matches_.constEnd() && it->first == cursor.selectionStart()
+          && it->first + it->second == cursor.selectionEnd()) {
+        index = static_cast<int>(it - matches_.constBegin());
+      }
+    }
+    if (index == -1) {
+      count_->setText(tr("%1 matches").arg(matches_.size()));
+    } else {
+      count_->setText(tr("%1 of %2").arg(index + 1).arg(matches_.size()));
+    }
+  }
+}
+
+void FindBar::findNext() {
+  findNext(false);
+}
+
+void FindBar::findPrevious() {
+  findNext(true);
+}
+
+void FindBar::select(const QPair<int, int> &match) {
+  QTextCursor cursor = editor_->textCursor();
+  cursor.setPosition(match.first);
+  cursor.setPosition(match.first + match.second, QTextCursor::KeepAnchor);
+  editor_->setTextCursor(cursor);
+  updateCount();
+}
+
+void FindBar::saveSettings() const {
+  QSettings settings;
+  settings.setValue("FindText", edit_->text());
+  settings.setValue("FindMatchCase", matchCase_->isChecked());
+  settings.setValue("FindMatchWholeWords", wholeWords_->isChecked());
+  settings.setValue("FindUseRegexp", regExp_->isChecked());
+}
+
+bool FindBar::current() const {
+  return editor_ && matchesDocument_ == editor_->document()
+      && matchesRevision_ == editor_->document()->revision();
+}
@@ -0,0 +1,109 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FINDBAR_H
+#define FINDBAR_H
+
+#include <functional>
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPair>
+#include <QPointer>
+#include <QTimer>
+#include <QToolButton>
+#include <QVector>
+#include <QWidget>
+
+#include "EditorWidget.h"
+#include "SearchEngine.h"
+
+// Find as you type, in a bar under the editor.  Each query is run on the thread pool against a
+// snapshot of the document, and replaces (and stops) any query still running.  Only the matches
+// on screen are highlighted, so a common word in a huge file costs no more than a rare one.
+class FindBar: public QWidget {
+ Q_OBJECT
+
+ public:
+  explicit FindBar(QWidget *parent = 0);
+  ~FindBar() override;
+
+  void setEditor(EditorWidget *editor);
+  search_options_s options() const;
+
+  // Show the bar and put the keyboard in it, starting with `text` if there is any.
+  void activate(const QString &text);
+  // Select the next (or previous) match after the cursor, wrapping around the ends.  Straight after
+  // typing or an edit the matches aren't ready yet, so this carries on once the search is done
+  // rather than waiting for it.  Either way `done` is then told whether there were any.
+  void findNext(bool backwards, std::function<void(bool found)> done = nullptr);
+  // Pick up options changed from the find and replace dialog.
+  void loadSettings();
+
+ protected:
+  bool eventFilter(QObject *watched, QEvent *event) override;
+  void hideEvent(QHideEvent *event) override;
+
+ private slots:
+  void restart();
+  void documentChanged();
+  void finished();
+  void updateHighlights();
+  void updateRequest(const QRect &rect, int dy);
+  void updateCount();
+  void findNext();
+  void findPrevious();
+
+ private:
+  bool step(bool backwards);
+  // Complete a find that was waiting for the matches.
+  void finishPending();
+  void select(const QPair<int, int> &match);
+  void saveSettings() const;
+  // Whether `matches_` are for the editor's document as it is now.
+  bool current() const;
+
+  QLineEdit *edit_;
+  QToolButton *matchCase_;
+  QToolButton *wholeWords_;
+  QToolButton *regExp_;
+  QLabel *count_;
+
+  QPointer<EditorWidget> editor_;
+  QTimer timer_;
+  QFutureWatcher<find_matches_t> future_;
+  QAtomicInt generation_;
+  int running_ = -1; // The generation being searched for, if any.
+  int start_ = 0; // Where the cursor was when the bar was opened.
+  // A find asked for before the matches were ready.
+  bool pending_ = false;
+  bool pendingBackwards_ = false;
+  std::function<void(bool found)> pendingDone_;
+  QString snapshot_;
+  QTextDocument *snapshotDocument_ = nullptr;
+  int snapshotRevision_ = -1;
+
+  // What the matches are for.
+  find_matches_t matches_;
+  QTextDocument *matchesDocument_ = nullptr;
+  int matchesRevision_ = -1;
+  QString error_;
+  int visibleStart_ = -1;
+  int visibleEnd_ = -1;
+};
+
+#endif // FINDBAR_H
@@ -0,0 +1,67 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QSettings>
+
+#include "FindInFilesDialog.h"
+#include "ui_FindInFilesDialog.h"
+
+FindInFilesDialog::FindInFilesDialog(QWidget *parent)
+  : QDialog(parent),
+    ui_(new Ui::FindInFilesDialog)
+{
+  ui_->setupUi(this);
+  ui_->findWhatEdit->setFocus();
+
+  // The text and options are shared with the normal find dialog.
+  QSettings settings;
+  ui_->findWhatEdit->setText(settings.value("FindText").toString());
+  ui_->findWhatEdit->selectAll();
+  ui_->matchCase->setChecked(settings.value("FindMatchCase").toBool());
+  ui_->matchWholeWords->setChecked(settings.value("FindMatchWholeWords").toBool());
+  ui_->useRegExp->setChecked(settings.value("FindUseRegexp").toBool());
+  ui_->searchProject->setChecked(settings.value("FindInProject", true).toBool());
+  ui_->searchIncludes->setChecked(settings.value("FindInIncludes", true).toBool());
+}
+
+FindInFilesDialog::~FindInFilesDialog() {
+  if (result() == QDialog::Accepted) {
+    QSettings settings;
+    settings.setValue("FindText", ui_->findWhatEdit->text());
+    settings.setValue("FindMatchCase", ui_->matchCase->isChecked());
+    settings.setValue("FindMatchWholeWords", ui_->matchWholeWords->isChecked());
+    settings.setValue("FindUseRegexp", ui_->useRegExp->isChecked());
+    settings.setValue("FindInProject", ui_->searchProject->isChecked());
+    settings.setValue("FindInIncludes", ui_->searchIncludes->isChecked());
+  }
+  delete ui_;
+}
+
+search_options_s FindInFilesDialog::options() const {
+  return {
+    ui_->findWhatEdit->text(),
+    ui_->matchCase->isChecked(),
+    ui_->matchWholeWords->isChecked(),
+    ui_->useRegExp->isChecked(),
+  };
+}
+
+bool FindInFilesDialog::searchProject() const {
+  return ui_->searchProject->isChecked();
+}
+
+bool FindInFilesDialog::searchIncludes() const {
+  return ui_->searchIncludes->isChecked();
+}
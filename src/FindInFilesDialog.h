@@ -0,0 +1,43 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FINDINFILESDIALOG_H
+#define FINDINFILESDIALOG_H
+
+#include <QDialog>
+
+#include "FileSearch.h"
+
+namespace Ui {
+  class FindInFilesDialog;
+}
+
+class FindInFilesDialog: public QDialog {
+ Q_OBJECT
+
+ public:
+  explicit FindInFilesDialog(QWidget *parent = 0);
+  ~FindInFilesDialog() override;
+
+  search_options_s options() const;
+
+  bool searchProject() const;
+  bool searchIncludes() const;
+
+ private:
+  Ui::FindInFilesDialog *ui_;
+};
+
+#endif // FINDINFILESDIALOG_H
@@ -0,0 +1,115 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QLocale>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+#include "EditorWidget.h"
+#include "FileLoader.h"
+#include "HistoryDialog.h"
+#include "LineDiff.h"
+#include "ui_HistoryDialog.h"
+
+HistoryDialog::HistoryDialog(const QString &path, const QString &current, QWidget *parent)
+  : QDialog(parent),
+    ui_(new Ui::HistoryDialog),
+    current_(current)
+{
+  ui_->setupUi(this);
+  setWindowTitle(tr("Local History - %1").arg(path));
+  ui_->diff->setFont(EditorWidget::editorFont());
+  ui_->splitter->setStretchFactor(1, 3);
+  restore_ = ui_->buttonBox->addButton(tr("Restore"), QDialogButtonBox::AcceptRole);
+  restore_->setEnabled(false);
+  connect(ui_->revisions, SIGNAL(currentRowChanged(int)), SLOT(revisionChanged(int)));
+  connect(&watcher_, SIGNAL(finished()), SLOT(compared()));
+  // Only the list of chunks is read now.  Each version is put together when it is picked.
+  revisions_ = LocalHistory::revisions(path);
+  std::reverse(revisions_.begin(), revisions_.end());
+  QLocale locale;
+  for (auto const & revision : revisions_) {
+    ui_->revisions->addItem(tr("%1 (%2 bytes)")
+      .arg(locale.toString(QDateTime::fromMSecsSinceEpoch(revision.Time), QLocale::ShortFormat))
+      .arg(locale.toString(revision.Size)));
+  }
+  if (revisions_.isEmpty()) {
+    ui_->diff->setPlainText(tr("Nothing has been saved from Qawno for this file yet."));
+  } else {
+    ui_->revisions->setCurrentRow(0);
+  }
+}
+
+HistoryDialog::~HistoryDialog() {
+  delete ui_;
+}
+
+const QString &HistoryDialog::selectedText() const {
+  return selected_;
+}
+
+history_diff_s HistoryDialog::compare(int row, history_revision_s revision, QString current) {
+  history_diff_s diff { row, false, QString(), QString() };
+  QByteArray data = LocalHistory::read(revision);
+  if (data.isEmpty() && revision.Size != 0) {
+    diff.Diff = QCoreApplication::translate("HistoryDialog", "This version is missing from the history.");
+    return diff;
+  }
+  diff.Found = true;
+  loaded_file_s file { QString(), QString(), file_encoding_ascii, false, QString() };
+  FileLoader::decode(data.constData(), data.size(), file);
+  diff.Text = file.Text;
+  // Line endings aren't worth showing as a difference.
+  QStringList from = file.Text.split('\n');
+  QStringList to = current.split('\n');
+  for (auto & line : from) {
+    if (line.endsWith('\r')) {
+      line.chop(1);
+    }
+  }
+  for (auto & line : to) {
+    if (line.endsWith('\r')) {
+      line.chop(1);
+    }
+  }
+  QVector<diff_hunk_s> hunks = LineDiff::compare(from, to);
+  diff.Diff = hunks.isEmpty()
+    ? QCoreApplication::translate("HistoryDialog", "This version is the same as the editor.")
+    : LineDiff::unified(from, to, hunks);
+  return diff;
+}
+
+void HistoryDialog::revisionChanged(int row) {
+  restore_->setEnabled(false);
+  selected_.clear();
+  if (row < 0) {
+    return;
+  }
+  ui_->diff->setPlainText(tr("Comparing..."));
+  watcher_.setFuture(QtConcurrent::run(&HistoryDialog::compare, row, revisions_[row], current_));
+}
+
+void HistoryDialog::compared() {
+  history_diff_s diff = watcher_.result();
+  if (diff.Row != ui_->revisions->currentRow()) {
+    return;
+  }
+  ui_->diff->setPlainText(diff.Diff);
+  selected_ = diff.Text;
+  restore_->setEnabled(diff.Found);
+}
@@ -0,0 +1,65 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HISTORYDIALOG_H
+#define HISTORYDIALOG_H
+
+#include <QDialog>
+#include <QFutureWatcher>
+#include <QPushButton>
+
+#include "LocalHistory.h"
+
+namespace Ui {
+  class HistoryDialog;
+}
+
+// One version of the file, and how it differs from the editor.
+struct history_diff_s {
+  int Row;
+  bool Found;
+  QString Text;
+  QString Diff;
+};
+
+// Every saved version of a file, newest first.  Picking one shows how it differs from what is in the
+// editor now (worked out in the background), and it can be put back in to the editor.
+class HistoryDialog: public QDialog {
+ Q_OBJECT
+
+ public:
+  HistoryDialog(const QString &path, const QString &current, QWidget *parent = 0);
+  ~HistoryDialog() override;
+
+  // The text of the version picked, for the editor once the dialog is accepted.
+  const QString &selectedText() const;
+
+  // Reads version `revision` and compares it to `current`.  Blocking, for workers.
+  static history_diff_s compare(int row, history_revision_s revision, QString current);
+
+ private slots:
+  void revisionChanged(int row);
+  void compared();
+
+ private:
+  Ui::HistoryDialog *ui_;
+  QPushButton* restore_;
+  QVector<history_revision_s> revisions_;
+  QString current_;
+  QString selected_;
+  QFutureWatcher<history_diff_s> watcher_;
+};
+
+#endif // HISTORYDIALOG_H
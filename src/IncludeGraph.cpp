@@ -0,0 +1,351 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+#include "Compiler.h"
+#include "IncludeGraph.h"
+
+// Parses one file on a worker.  A function object so that the search paths can come along.
+struct include_parser_s {
+  typedef include_node_s result_type;
+
+  QStringList SearchPaths;
+
+  include_node_s operator()(const QString &path) const {
+    QFileInfo info(path);
+    include_node_s node { info.lastModified().toMSecsSinceEpoch(), info.size(), QStringList() };
+    QFile f{path};
+    if (!f.open(QFile::ReadOnly) || node.Size == 0) {
+      return node;
+    }
+    QString text;
+    if (uchar* data = f.map(0, node.Size)) {
+      // Directives are always ASCII, so there's no need to care about the real encoding.
+      text = QString::fromLatin1(reinterpret_cast<const char*>(data), static_cast<int>(node.Size));
+      f.unmap(data);
+    } else {
+      text = QString::fromLatin1(f.readAll());
+    }
+    QString dir = info.absolutePath();
+    for (auto const & directive : IncludeGraph::directives(text)) {
+      QString include = IncludeGraph::resolve(directive.first, directive.second, dir, SearchPaths);
+      if (!include.isEmpty()) {
+        node.Includes.push_back(include);
+      }
+    }
+    return node;
+  }
+};
+
+IncludeGraph::IncludeGraph(QObject *parent)
+  : QObject(parent)
+{
+  connect(&future_, SIGNAL(finished()), SLOT(finished()));
+  connect(&watcher_, SIGNAL(fileChanged(QString)), SLOT(fileChanged(QString)));
+}
+
+IncludeGraph::~IncludeGraph() {
+  // nothing
+}
+
+QString IncludeGraph::normalise(const QString &path) {
+  QString clean = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+#ifdef Q_OS_WIN
+  // `A_SAMP.INC` and `a_samp.inc` are the same file here.
+  clean = clean.toLower();
+#endif
+  return clean;
+}
+
+static QStringList splitArguments(const QString &command) {
+  // Just enough to undo the quoting in the compiler options.
+  QStringList arguments;
+  QString current;
+  bool quoted = false, any = false;
+  for (QChar ch : command) {
+    if (ch == '"') {
+      quoted = !quoted;
+      any = true;
+    } else if (ch.isSpace() && !quoted) {
+      if (any) {
+        arguments.push_back(current);
+      }
+      current.clear();
+      any = false;
+    } else {
+      current += ch;
+      any = true;
+    }
+  }
+  if (any) {
+    arguments.push_back(current);
+  }
+  return arguments;
+}
+
+QStringList IncludeGraph::searchPaths(const QString &inputFile) {
+  Compiler compiler = Compiler::fromSettings();
+  QString input = inputFile.isEmpty() ? QDir::current().absoluteFilePath("new.pwn") : inputFile;
+  QStringList paths;
+  for (auto const & argument : splitArguments(compiler.commandFor(input))) {
+    if (argument.startsWith("-i") && argument.length() > 2) {
+      QString path = normalise(argument.mid(2));
+      if (!paths.contains(path)) {
+        paths.push_back(path);
+      }
+    }
+  }
+  QString builtin = normalise(Compiler::includeDirectory());
+  if (!paths.contains(builtin)) {
+    paths.push_back(builtin);
+  }
+  return paths;
+}
+
+QString IncludeGraph::resolve(const QString &name, bool quoted, const QString &currentDir,
+                              const QStringList &searchPaths) {
+  QString file = name.trimmed();
+  file.replace('\\', '/');
+  if (file.isEmpty()) {
+    return QString();
+  }
+  // `"file"` looks next to the including file first, `<file>` only in the include paths.
+  QStringList dirs;
+  if (QFileInfo(file).isAbsolute()) {
+    dirs.push_back(QString());
+  } else {
+    if (quoted) {
+      dirs.push_back(currentDir);
+    }
+    dirs.append(searchPaths);
+  }
+  // The name as written, then the extensions the compiler tries when there isn't one.
+  QStringList suffixes { QString() };
+  if (QFileInfo(file).suffix().isEmpty()) {
+    suffixes << ".inc" << ".p" << ".pawn";
+  }
+  for (auto const & dir : dirs) {
+    QString base = dir.isEmpty() ? file : dir + "/" + file;
+    for (auto const & suffix : suffixes) {
+      QFileInfo info(base + suffix);
+      if (info.isFile()) {
+        return normalise(info.absoluteFilePath());
+      }
+    }
+  }
+  return QString();
+}
+
+QVector<QPair<QString, bool>> IncludeGraph::directives(const QString &text) {
+  QVector<QPair<QString, bool>> result;
+  QChar const* data = text.constData();
+  int len = text.length();
+  bool comment = false;
+  int line = 0;
+  while (line < len) {
+    int end = text.indexOf('\n', line);
+    if (end == -1) {
+      end = len;
+    }
+    // Skip leading whitespace and comments, so that `/**/ #include` still counts.
+    int i = line;
+    for ( ; ; ) {
+      if (comment) {
+        int close = text.indexOf("*/", i);
+        if (close == -1 || close >= end) {
+          i = end;
+          break;
+        }
+        comment = false;
+        i = close + 2;
+      }
+      while (i < end && data[i].isSpace()) {
+        ++i;
+      }
+      if (i + 1 < end && data[i] == '/' && data[i + 1] == '*') {
+        comment = true;
+        i += 2;
+        continue;
+      }
+      break;
+    }
+    if (!comment && i < end && data[i] == '#') {
+      ++i;
+      while (i < end && (data[i] == ' ' || data[i] == '\t')) {
+        ++i;
+      }
+      int word = i;
+      while (i < end && data[i].isLetter()) {
+        ++i;
+      }
+      QStringRef directive = text.midRef(word, i - word);
+      if (directive == QLatin1String("include") || directive == QLatin1String("tryinclude")) {
+        while (i < end && (data[i] == ' ' || data[i] == '\t')) {
+          ++i;
+        }
+        if (i < end && (data[i] == '"' || data[i] == '<')) {
+          QChar close = data[i] == '"' ? '"' : '>';
+          int start = ++i;
+          while (i < end && data[i] != close) {
+            ++i;
+          }
+          if (i < end) {
+            result.push_back({ text.mid(start, i - start), close == '"' });
+          }
+        } else {
+          // Old style `#include file`.
+          int start = i;
+          while (i < end && !data[i].isSpace()) {
+            ++i;
+          }
+          if (i > start) {
+            result.push_back({ text.mid(start, i - start), false });
+          }
+        }
+      }
+    }
+    // Follow block comments through the rest of the line.
+    while (i < end) {
+      if (comment) {
+        if (data[i] == '*' && i + 1 < end && data[i + 1] == '/') {
+          comment = false;
+          ++i;
+        }
+      } else if (data[i] == '"') {
+        do {
+          ++i;
+        } while (i < end && data[i] != '"');
+      } else if (data[i] == '/' && i + 1 < end) {
+        if (data[i + 1] == '/') {
+          break;
+        } else if (data[i + 1] == '*') {
+          comment = true;
+          ++i;
+        }
+      }
+      ++i;
+    }
+    line = end + 1;
+  }
+  return result;
+}
+
+include_result_s IncludeGraph::build(const QString &root, const QString &text,
+                                     const QStringList &searchPaths,
+                                     const QHash<QString, include_node_s> &known) {
+  include_result_s result;
+  result.Root = root.isEmpty() ? QString() : normalise(root);
+  result.SearchPaths = searchPaths;
+  // The root comes from the editor, not the disk, so unsaved includes count.
+  QString dir = root.isEmpty() ? QDir::currentPath() : QFileInfo(root).absolutePath();
+  QStringList frontier;
+  for (auto const & directive : directives(text)) {
+    QString include = resolve(directive.first, directive.second, dir, searchPaths);
+    if (!include.isEmpty()) {
+      frontier.push_back(include);
+    }
+  }
+  if (!result.Root.isEmpty()) {
+    result.Files.insert(result.Root);
+  }
+  include_parser_s parser { searchPaths };
+  // Breadth first, so that every level can be parsed in parallel.
+  while (!frontier.isEmpty()) {
+    QStringList level;
+    for (auto const & path : frontier) {
+      if (!result.Files.contains(path)) {
+        result.Files.insert(path);
+        level.push_back(path);
+      }
+    }
+    frontier.clear();
+    QStringList stale;
+    for (auto const & path : level) {
+      auto it = known.constFind(path);
+      QFileInfo info(path);
+      if (it == known.constEnd() || it->Size != info.size()
+          || it->Modified != info.lastModified().toMSecsSinceEpoch()) {
+        stale.push_back(path);
+      }
+    }
+    if (!stale.isEmpty()) {
+      QVector<include_node_s> parsed = QtConcurrent::blockingMapped<QVector<include_node_s>>(stale, parser);
+      for (int i = 0; i != stale.size(); ++i) {
+        result.Nodes.insert(stale[i], parsed[i]);
+      }
+    }
+    for (auto const & path : level) {
+      auto it = result.Nodes.constFind(path);
+      frontier.append(it == result.Nodes.constEnd() ? known.value(path).Includes : it->Includes);
+    }
+  }
+  return result;
+}
+
+void IncludeGraph::update(const QString &root, const QString &text, const QStringList &searchPaths) {
+  request_ = { root, text, searchPaths };
+  if (future_.isRunning()) {
+    pending_ = true;
+    return;
+  }
+  if (searchPaths != searchPaths_) {
+    // The same name could now point somewhere else entirely.
+    nodes_.clear();
+    searchPaths_ = searchPaths;
+  }
+  future_.setFuture(QtConcurrent::run(&IncludeGraph::build, request_.Root, request_.Text,
+                                      request_.SearchPaths, nodes_));
+  request_.Text.clear();
+}
+
+QSet<QString> IncludeGraph::files(const QString &root) const {
+  return roots_.value(root.isEmpty() ? QString() : normalise(root));
+}
+
+void IncludeGraph::finished() {
+  include_result_s result = future_.result();
+  if (result.SearchPaths == searchPaths_) {
+    QSet<QString> watched = QSet<QString>::fromList(watcher_.files());
+    QStringList watch;
+    for (auto it = result.Nodes.constBegin(); it != result.Nodes.constEnd(); ++it) {
+      nodes_.insert(it.key(), it.value());
+      if (!watched.contains(it.key())) {
+        watch.push_back(it.key());
+      }
+    }
+    if (!watch.isEmpty()) {
+      watcher_.addPaths(watch);
+    }
+    roots_.insert(result.Root, result.Files);
+    emit resolved(result.Root, result.Files);
+  }
+  if (pending_) {
+    pending_ = false;
+    update(request_.Root, request_.Text, request_.SearchPaths);
+  }
+}
+
+void IncludeGraph::fileChanged(const QString &path) {
+  // Parsed again the next time anything reaches it.  Replacing a file also drops the watch, so
+  // stop tracking it here and let the next build add it back.
+  nodes_.remove(path);
+  watcher_.removePath(path);
+  emit changed();
+}
@@ -0,0 +1,101 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INCLUDEGRAPH_H
+#define INCLUDEGRAPH_H
+
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+// One parsed file: where its `#include`s and `#tryinclude`s point.
+struct include_node_s {
+  qint64 Modified;
+  qint64 Size;
+  QStringList Includes; // Normalised paths, only those that exist.
+};
+
+struct include_result_s {
+  QString Root;
+  QStringList SearchPaths;
+  QSet<QString> Files; // Everything reachable from `Root`, including itself.
+  QHash<QString, include_node_s> Nodes;
+};
+
+// Works out which files a script really pulls in, the same way the compiler looks for them.  Parsed
+// files are remembered and watched, so only changed ones are read again.
+class IncludeGraph: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit IncludeGraph(QObject *parent = 0);
+  ~IncludeGraph() override;
+
+  // Paths in a form that can be compared, since includes are written in many different ways.
+  static QString normalise(const QString &path);
+
+  // The include directories for compiling `inputFile`: every `-i` in the compiler options, after
+  // expanding `%p` etc., followed by `%q/include`.  Reads the settings, so GUI thread only.
+  static QStringList searchPaths(const QString &inputFile);
+
+  // Finds `name` as the compiler would from a file in `currentDir`.  Empty if it doesn't exist.
+  static QString resolve(const QString &name, bool quoted, const QString &currentDir,
+                         const QStringList &searchPaths);
+
+  // The raw directive arguments in some source, with whether each used quotes (`"a"`, not `<a>`).
+  static QVector<QPair<QString, bool>> directives(const QString &text);
+
+  // Blocking, for workers.  `text` is the (possibly unsaved) content of `root`.
+  static include_result_s build(const QString &root, const QString &text,
+                                const QStringList &searchPaths,
+                                const QHash<QString, include_node_s> &known);
+
+  // Start resolving `root` in the background.  `resolved` is emitted when it is done.  Requests made
+  // while one is running replace any earlier pending request.
+  void update(const QString &root, const QString &text, const QStringList &searchPaths);
+
+  QSet<QString> files(const QString &root) const;
+
+ signals:
+  void resolved(const QString &root, const QSet<QString> &files);
+  // Something already in the graph changed on disk.
+  void changed();
+
+ private slots:
+  void finished();
+  void fileChanged(const QString &path);
+
+ private:
+  struct request_s {
+    QString Root;
+    QString Text;
+    QStringList SearchPaths;
+  };
+
+  QHash<QString, include_node_s> nodes_;
+  QHash<QString, QSet<QString>> roots_;
+  QStringList searchPaths_;
+  QFileSystemWatcher watcher_;
+  QFutureWatcher<include_result_s> future_;
+  bool pending_ = false;
+  request_s request_;
+};
+
+#endif // INCLUDEGRAPH_H
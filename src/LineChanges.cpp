@@ -0,0 +1,193 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QtConcurrent>
+
+#include "FileLoader.h"
+#include "LineChanges.h"
+#include "LineDiff.h"
+
+// This is diffed again after every pause in typing, so it gives up long before the history dialog
+// would, keeping the trace under 256 KB.  Past that, everything between the unchanged lines at
+// either end is simply marked as changed, which for that many differences is close enough.
+static const int MaxDifferences = 256;
+
+LineChanges::LineChanges(QTextDocument *document)
+  : QObject(document),
+    document_(document)
+{
+  // A new document is one empty line, and that is where it starts from.
+  hashes_.push_back(qHash(QString()));
+  marks_.push_back(line_change_none);
+  saved_ = hashes_;
+  diffTimer_.setSingleShot(true);
+  diffTimer_.setInterval(250);
+  connect(&diffTimer_, SIGNAL(timeout()), SLOT(diff()));
+  connect(&differ_, SIGNAL(finished()), SLOT(diffed()));
+  connect(&reader_, SIGNAL(finished()), SLOT(fileHashed()));
+  connect(document_, SIGNAL(contentsChange(int, int, int)), SLOT(contentsChange(int, int, int)));
+  connect(document_, SIGNAL(modificationChanged(bool)), SLOT(modificationChanged(bool)));
+}
+
+LineChanges::~LineChanges() {
+  // Nothing can be cancelled once it has started, but the results can be left behind.
+  differ_.waitForFinished();
+  reader_.waitForFinished();
+}
+
+int LineChanges::at(int line) const {
+  return line >= 0 && line < marks_.size() ? marks_[line] : line_change_none;
+}
+
+void LineChanges::reset() {
+  setSaved(hashes_);
+}
+
+void LineChanges::compareWithFile(const QString &path) {
+  if (path.isEmpty()) {
+    return;
+  }
+  reader_.waitForFinished();
+  fileBaseline_ = ++baseline_;
+  reader_.setFuture(QtConcurrent::run(&LineChanges::hashFile, path));
+}
+
+QVector<uint> LineChanges::hashFile(const QString &path) {
+  loaded_file_s file = FileLoader::read(path);
+  QVector<uint> hashes;
+  if (!file.Error.isEmpty()) {
+    return hashes;
+  }
+  // The document splits lines the same way.
+  file.Text.replace("\r\n", "\n").replace('\r', '\n');
+  for (auto const & line : file.Text.splitRef('\n')) {
+    hashes.push_back(qHash(line));
+  }
+  return hashes;
+}
+
+QVector<quint8> LineChanges::compare(const QVector<uint> &saved, const QVector<uint> &current) {
+  QVector<quint8> marks(current.size(), line_change_none);
+  for (auto const & hunk : LineDiff::compare(saved, current, MaxDifferences)) {
+    if (hunk.NewCount == 0) {
+      if (hunk.NewStart < current.size()) {
+        marks[hunk.NewStart] |= line_change_removed_above;
+      } else if (!current.isEmpty()) {
+        marks[current.size() - 1] |= line_change_removed_below;
+      }
+      continue;
+    }
+    // As many lines as there were are changed ones, and any more than that are new.
+    int modified = qMin(hunk.OldCount, hunk.NewCount);
+    for (int i = 0; i != hunk.NewCount; ++i) {
+      marks[hunk.NewStart + i] |= i < modified ? line_change_modified : line_change_added;
+    }
+  }
+  return marks;
+}
+
+void LineChanges::setSaved(const QVector<uint> &saved) {
+  saved_ = saved;
+  ++baseline_;
+  if (saved_ == hashes_) {
+    // Nothing to diff, which is almost always the case here.
+    marks_.fill(line_change_none);
+    diffTimer_.stop();
+    emit changed();
+  } else {
+    diffTimer_.start();
+  }
+}
+
+void LineChanges::contentsChange(int position, int removed, int added) {
+  Q_UNUSED(removed);
+  // Keep the arrays lined up with the lines; whatever was added or removed was just after the first
+  // line touched.
+  QTextBlock block = document_->findBlock(position);
+  int first = block.blockNumber();
+  int delta = document_->blockCount() - hashes_.size();
+  if (delta > 0) {
+    hashes_.insert(first + 1, delta, 0);
+    marks_.insert(first + 1, delta, line_change_added);
+  } else if (delta < 0) {
+    hashes_.remove(first + 1, -delta);
+    marks_.remove(first + 1, -delta);
+    marks_[first] |= line_change_modified;
+  }
+  QTextBlock end = document_->findBlock(position + added);
+  int last = end.isValid() ? end.blockNumber() : document_->blockCount() - 1;
+  bool touched = delta != 0;
+  for (int line = first; line <= last && block.isValid(); ++line, block = block.next()) {
+    uint hash = qHash(block.text());
+    if (hash != hashes_[line]) {
+      hashes_[line] = hash;
+      // A guess, until the diff says otherwise.
+      if (marks_[line] == line_change_none) {
+        marks_[line] = line_change_modified;
+      }
+      touched = true;
+    }
+  }
+  // Re-highlighting reports the same lines again without changing them.
+  if (!touched) {
+    return;
+  }
+  ++edits_;
+  if (!document_->isUndoRedoEnabled()) {
+    // Only ever off while a file is loaded in, which nobody did to it.
+    marks_.fill(line_change_none);
+    return;
+  }
+  emit changed();
+  diffTimer_.start();
+}
+
+void LineChanges::modificationChanged(bool modified) {
+  // Saved, loaded, or undone back to how it was, so exactly what is on disk.
+  if (!modified && document_->isUndoRedoEnabled()) {
+    reset();
+  }
+}
+
+void LineChanges::diff() {
+  if (differ_.isRunning()) {
+    pending_ = true;
+    return;
+  }
+  diffEdits_ = edits_;
+  diffBaseline_ = baseline_;
+  differ_.setFuture(QtConcurrent::run(&LineChanges::compare, saved_, hashes_));
+}
+
+void LineChanges::diffed() {
+  // Anything that has happened since will have asked for another.
+  if (diffEdits_ == edits_ && diffBaseline_ == baseline_) {
+    marks_ = differ_.result();
+    emit changed();
+  }
+  if (pending_) {
+    pending_ = false;
+    diff();
+  }
+}
+
+void LineChanges::fileHashed() {
+  // Don't replace a newer baseline, such as from the text having been saved in the meantime.
+  if (fileBaseline_ == baseline_) {
+    setSaved(reader_.result());
+  }
+}
@@ -0,0 +1,91 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LINECHANGES_H
+#define LINECHANGES_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+class QTextDocument;
+
+// Flags, so a line can be both changed and have had lines removed next to it.
+enum line_change_e {
+  line_change_none = 0,
+  line_change_added = 1,
+  line_change_modified = 2,
+  line_change_removed_above = 4, // Lines that were before this one have gone.
+  line_change_removed_below = 8, // Only ever on the last line.
+};
+
+// The lines of a document as they were when last saved, and which lines differ from that now.
+// Every line's hash is kept up to date one edited line at a time, so comparing is a diff of two
+// arrays of numbers on a worker, with the unchanged lines at either end skipped before starting.
+// The marks are kept in an array alongside, so the gutter can look up each line it paints, and are
+// moved along with lines added and removed until the next diff puts them right.
+class LineChanges: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit LineChanges(QTextDocument *document);
+  ~LineChanges() override;
+
+  // The `line_change_e` flags for one line.
+  int at(int line) const;
+
+  // Start again from the document as it is now, as if it had just been saved.
+  void reset();
+
+  // Compare with `path` instead of what was there when the document was last unmodified.  For text
+  // that was never saved, such as from a crash journal.
+  void compareWithFile(const QString &path);
+
+  // Blocking, for workers.
+  static QVector<uint> hashFile(const QString &path);
+  static QVector<quint8> compare(const QVector<uint> &saved, const QVector<uint> &current);
+
+ signals:
+  void changed();
+
+ private slots:
+  void contentsChange(int position, int removed, int added);
+  void modificationChanged(bool changed);
+  void diff();
+  void diffed();
+  void fileHashed();
+
+ private:
+  void setSaved(const QVector<uint> &saved);
+
+  QTextDocument *document_;
+  QVector<uint> hashes_;
+  QVector<uint> saved_;
+  QVector<quint8> marks_;
+
+  // Bumped by every edit and every new baseline, so that stale answers can be told apart.
+  int edits_ = 0;
+  int baseline_ = 0;
+  int diffEdits_ = 0;
+  int diffBaseline_ = 0;
+  int fileBaseline_ = 0;
+  bool pending_ = false;
+  QTimer diffTimer_;
+  QFutureWatcher<QVector<quint8>> differ_;
+  QFutureWatcher<QVector<uint>> reader_;
+};
+
+#endif // LINECHANGES_H
@@ -0,0 +1,163 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QHash>
+
+#include "LineDiff.h"
+
+// A run of lines that are the same in both.
+struct diff_match_s {
+  int Old;
+  int New;
+  int Length;
+};
+
+// Anything that can be indexed by line, with lines that can be compared and hashed.
+template <typename Lines>
+static QVector<diff_hunk_s> compareLines(const Lines &from, const Lines &to, int maxDifferences) {
+  int n = from.size(), m = to.size();
+  int prefix = 0;
+  while (prefix != n && prefix != m && from[prefix] == to[prefix]) {
+    ++prefix;
+  }
+  int suffix = 0;
+  while (suffix != n - prefix && suffix != m - prefix && from[n - suffix - 1] == to[m - suffix - 1]) {
+    ++suffix;
+  }
+  n -= prefix + suffix;
+  m -= prefix + suffix;
+  QVector<diff_hunk_s> hunks;
+  if (n == 0 && m == 0) {
+    return hunks;
+  }
+  // Lines become numbers, so comparing them while searching is cheap.
+  QHash<typename Lines::value_type, int> ids;
+  QVector<int> a(n), b(m);
+  for (int i = 0; i != n; ++i) {
+    auto it = ids.find(from[prefix + i]);
+    if (it == ids.end()) {
+      it = ids.insert(from[prefix + i], ids.size());
+    }
+    a[i] = *it;
+  }
+  for (int i = 0; i != m; ++i) {
+    auto it = ids.constFind(to[prefix + i]);
+    b[i] = it == ids.constEnd() ? -1 - i : *it;
+  }
+  // The furthest along each diagonal `k` gets with `d` differences, kept for every `d` to walk back
+  // through once the end is reached.
+  int limit = qMin(n + m, maxDifferences);
+  int offset = limit + 1;
+  QVector<int> v(2 * limit + 3, 0);
+  QVector<QVector<int>> trace;
+  int found = -1;
+  for (int d = 0; d <= limit && found == -1; ++d) {
+    for (int k = -d; k <= d; k += 2) {
+      int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+        ? v[offset + k + 1]
+        : v[offset + k - 1] + 1;
+      int y = x - k;
+      while (x < n && y < m && a[x] == b[y]) {
+        ++x;
+        ++y;
+      }
+      v[offset + k] = x;
+      if (x >= n && y >= m) {
+        found = d;
+        break;
+      }
+    }
+    trace.push_back(v.mid(offset - d, 2 * d + 1));
+  }
+  if (found == -1) {
+    hunks.push_back({ prefix, n, prefix, m });
+    return hunks;
+  }
+  QVector<diff_match_s> matches;
+  int x = n, y = m;
+  for (int d = found; d > 0; --d) {
+    const QVector<int> &previous = trace[d - 1];
+    int k = x - y;
+    bool down = k == -d || (k != d && previous[k - 1 + d - 1] < previous[k + 1 + d - 1]);
+    int px = previous[(down ? k + 1 : k - 1) + d - 1];
+    int py = px - (down ? k + 1 : k - 1);
+    // The one difference, then the same lines after it.
+    int sx = down ? px : px + 1;
+    int sy = down ? py + 1 : py;
+    if (x != sx) {
+      matches.push_back({ sx, sy, x - sx });
+    }
+    x = px;
+    y = py;
+  }
+  if (x != 0) {
+    matches.push_back({ 0, 0, x });
+  }
+  // Everything between two runs of matching lines is one hunk.
+  int oldLine = 0, newLine = 0;
+  for (int i = matches.size(); i-- != -1; ) {
+    diff_match_s match = i == -1 ? diff_match_s { n, m, 0 } : matches[i];
+    if (match.Old != oldLine || match.New != newLine) {
+      hunks.push_back({ prefix + oldLine, match.Old - oldLine, prefix + newLine, match.New - newLine });
+    }
+    oldLine = match.Old + match.Length;
+    newLine = match.New + match.Length;
+  }
+  return hunks;
+}
+
+QVector<diff_hunk_s> LineDiff::compare(const QStringList &from, const QStringList &to, int maxDifferences) {
+  return compareLines(from, to, maxDifferences);
+}
+
+QVector<diff_hunk_s> LineDiff::compare(const QVector<uint> &from, const QVector<uint> &to, int maxDifferences) {
+  return compareLines(from, to, maxDifferences);
+}
+
+QString LineDiff::unified(const QStringList &from, const QStringList &to,
+                          const QVector<diff_hunk_s> &hunks, int context) {
+  QString out;
+  for (int i = 0; i != hunks.size(); ) {
+    // Hunks close enough together to share their context are shown as one.
+    int last = i;
+    while (last + 1 != hunks.size()
+           && hunks[last + 1].OldStart - (hunks[last].OldStart + hunks[last].OldCount) <= 2 * context) {
+      ++last;
+    }
+    int oldStart = qMax(hunks[i].OldStart - context, 0);
+    int newStart = hunks[i].NewStart - (hunks[i].OldStart - oldStart);
+    int oldEnd = qMin(hunks[last].OldStart + hunks[last].OldCount + context, from.size());
+    int newEnd = hunks[last].NewStart + hunks[last].NewCount + (oldEnd - hunks[last].OldStart - hunks[last].OldCount);
+    out += QString("@@ -%1,%2 +%3,%4 @@\n").arg(oldStart + 1).arg(oldEnd - oldStart)
+                                          .arg(newStart + 1).arg(newEnd - newStart);
+    int line = oldStart;
+    for (int j = i; j <= last; ++j) {
+      for (; line != hunks[j].OldStart; ++line) {
+        out += ' ' + from[line] + '\n';
+      }
+      for (int k = 0; k != hunks[j].OldCount; ++k) {
+        out += '-' + from[line++] + '\n';
+      }
+      for (int k = 0; k != hunks[j].NewCount; ++k) {
+        out += '+' + to[hunks[j].NewStart + k] + '\n';
+      }
+    }
+    for (; line != oldEnd; ++line) {
+      out += ' ' + from[line] + '\n';
+    }
+    i = last + 1;
+  }
+  return out;
+}
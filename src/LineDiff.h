@@ -0,0 +1,55 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// `OldCount` lines from `OldStart` became `NewCount` lines from `NewStart` (both 0-based).
+struct diff_hunk_s {
+  int OldStart;
+  int OldCount;
+  int NewStart;
+  int NewCount;
+};
+
+// Line by line differences between two texts.  Everything here blocks, and is meant to be run on a
+// worker for anything bigger than a screenful.
+class LineDiff {
+ public:
+  // How many differences to look for before giving up and calling it all one change.  The trace
+  // kept to walk back through takes `4 * maxDifferences * maxDifferences` bytes at worst, so this
+  // is 64 MB, and only for a diff that is looked at once.
+  static const int MaxDifferences = 4096;
+
+  // The smallest set of changed lines that turns `from` in to `to` (Myers' algorithm, after taking
+  // off what is the same at both ends).  Texts with more than `maxDifferences` differences come
+  // back as one hunk covering everything between the common ends.
+  static QVector<diff_hunk_s> compare(const QStringList &from, const QStringList &to,
+                                      int maxDifferences = MaxDifferences);
+  // The same, for lines already hashed.  Much less to copy and compare, at the cost of the odd
+  // changed line that hashes the same going unnoticed.
+  static QVector<diff_hunk_s> compare(const QVector<uint> &from, const QVector<uint> &to,
+                                      int maxDifferences = MaxDifferences);
+
+  // `hunks` as a unified diff with `context` lines around each change.
+  static QString unified(const QStringList &from, const QStringList &to,
+                         const QVector<diff_hunk_s> &hunks, int context = 3);
+};
+
+#endif // LINEDIFF_H
@@ -0,0 +1,223 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+#include "LocalHistory.h"
+
+static const quint32 Magic = 0x51484953; // `QHIS`.
+static const quint32 Version = 2;
+
+static const int MinChunk = 2 << 10;
+static const int MaxChunk = 64 << 10;
+// The top bits of the hash that have to be clear to end a chunk, 13 for an average of 8 KB.
+static const int ChunkBits = 13;
+
+// A random number for every byte value, for the rolling hash.  Fixed, so that the same content is
+// always cut in the same places.
+struct gear_table_s {
+  quint64 Values[256];
+
+  gear_table_s() {
+    quint64 state = Q_UINT64_C(0x9E3779B97F4A7C15);
+    for (auto & value : Values) {
+      // splitmix64.
+      quint64 z = (state += Q_UINT64_C(0x9E3779B97F4A7C15));
+      z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+      z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+      value = z ^ (z >> 31);
+    }
+  }
+};
+
+static const gear_table_s Gear;
+
+static QString directory() {
+  return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/history";
+}
+
+// Saves finishing together take turns, so a version always goes in its index whole.
+static QMutex Recording;
+
+static QString fileKey(const QString &path) {
+  return QString::fromLatin1(QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(),
+                                                      QCryptographicHash::Md5).toHex());
+}
+
+static QString indexPath(const QString &path) {
+  return QString("%1/%2.idx").arg(directory(), fileKey(path));
+}
+
+static QString packPath(const QString &pack) {
+  return QString("%1/packs/%2").arg(directory(), pack);
+}
+
+static QDataStream &operator<<(QDataStream &out, const history_chunk_s &chunk) {
+  return out << chunk.Hash << chunk.Pack << chunk.Offset << chunk.Length;
+}
+
+static QDataStream &operator>>(QDataStream &in, history_chunk_s &chunk) {
+  return in >> chunk.Hash >> chunk.Pack >> chunk.Offset >> chunk.Length;
+}
+
+QVector<int> LocalHistory::boundaries(const char *data, int size) {
+  QVector<int> ends;
+  const uchar* bytes = reinterpret_cast<const uchar*>(data);
+  int start = 0;
+  quint64 hash = 0;
+  for (int i = 0; i != size; ++i) {
+    // Each byte is shifted out of the top after 64 more, so this only ever depends on the last 64.
+    hash = (hash << 1) + Gear.Values[bytes[i]];
+    int length = i + 1 - start;
+    if ((length >= MinChunk && (hash >> (64 - ChunkBits)) == 0) || length == MaxChunk) {
+      ends.push_back(i + 1);
+      start = i + 1;
+      hash = 0;
+    }
+  }
+  if (start != size) {
+    ends.push_back(size);
+  }
+  return ends;
+}
+
+void LocalHistory::record(const QString &path, const QByteArray &data, qint64 time) {
+  QMutexLocker locker(&Recording);
+  // Nearly every repeated chunk is from an earlier version of the same file, so only those are
+  // looked through, and nothing ever has to read the whole store.
+  QHash<QByteArray, history_chunk_s> stored;
+  for (auto const & revision : revisions(path)) {
+    for (auto const & chunk : revision.Chunks) {
+      stored.insert(chunk.Hash, chunk);
+    }
+  }
+  QString key = fileKey(path);
+  QString pack = QString("%1-%2.pack").arg(key).arg(time);
+  for (int n = 1; QFile::exists(packPath(pack)); ++n) {
+    pack = QString("%1-%2-%3.pack").arg(key).arg(time).arg(n);
+  }
+  history_revision_s revision { time, data.size(), QVector<history_chunk_s>() };
+  QByteArray packed;
+  int start = 0;
+  for (int end : boundaries(data.constData(), data.size())) {
+    QByteArray chunk = QByteArray::fromRawData(data.constData() + start, end - start);
+    QByteArray hash = QCryptographicHash::hash(chunk, QCryptographicHash::Sha1);
+    auto found = stored.constFind(hash);
+    if (found != stored.constEnd()) {
+      revision.Chunks.push_back(*found);
+    } else {
+      QByteArray compressed = qCompress(chunk);
+      history_chunk_s added { hash, pack, packed.size(), compressed.size() };
+      packed += compressed;
+      // The same chunk twice in one file is still only kept once.
+      stored.insert(hash, added);
+      revision.Chunks.push_back(added);
+    }
+    start = end;
+  }
+  if (!packed.isEmpty()) {
+    // Every new chunk goes in the one file, so a save is only ever synced once.
+    QDir().mkpath(directory() + "/packs");
+    QSaveFile out{packPath(pack)};
+    if (!out.open(QFile::WriteOnly) || out.write(packed) != packed.size() || !out.commit()) {
+      // No point listing a version that can't be read back.
+      return;
+    }
+  }
+  // Only the new version is appended, so this costs the same however many there are already.
+  QDir().mkpath(directory());
+  QFile f{indexPath(path)};
+  if (!f.open(QFile::ReadWrite)) {
+    return;
+  }
+  QDataStream out(&f);
+  out.setVersion(QDataStream::Qt_5_0);
+  quint32 magic = 0, version = 0;
+  out >> magic >> version;
+  if (magic != Magic || version != Version) {
+    // New, or from an older Qawno whose chunks are kept differently.  Start it again.
+    out.resetStatus();
+    f.resize(0);
+    f.seek(0);
+    out << Magic << Version << QFileInfo(path).absoluteFilePath();
+  }
+  f.seek(f.size());
+  out << revision.Time << revision.Size << revision.Chunks;
+}
+
+QVector<history_revision_s> LocalHistory::revisions(const QString &path) {
+  QVector<history_revision_s> revisions;
+  QFile f{indexPath(path)};
+  if (!f.open(QFile::ReadOnly)) {
+    return revisions;
+  }
+  QDataStream in(&f);
+  in.setVersion(QDataStream::Qt_5_0);
+  quint32 magic = 0, version = 0;
+  QString name;
+  in >> magic >> version >> name;
+  if (in.status() != QDataStream::Ok || magic != Magic || version != Version) {
+    return revisions;
+  }
+  while (!in.atEnd()) {
+    history_revision_s revision;
+    in >> revision.Time >> revision.Size >> revision.Chunks;
+    if (in.status() != QDataStream::Ok) {
+      // Cut off part way through writing it.
+      break;
+    }
+    revisions.push_back(revision);
+  }
+  // Saves are recorded in the background, so two close together can go in either way round.
+  std::stable_sort(revisions.begin(), revisions.end(),
+                   [](const history_revision_s &a, const history_revision_s &b) { return a.Time < b.Time; });
+  return revisions;
+}
+
+QByteArray LocalHistory::read(const history_revision_s &revision) {
+  QByteArray data;
+  data.reserve(static_cast<int>(revision.Size));
+  // Chunks from the same save are next to each other in the same pack, so it is rarely reopened.
+  QFile f;
+  for (auto const & chunk : revision.Chunks) {
+    QString pack = packPath(chunk.Pack);
+    if (f.fileName() != pack) {
+      f.close();
+      f.setFileName(pack);
+      if (!f.open(QFile::ReadOnly)) {
+        return QByteArray();
+      }
+    }
+    if (!f.seek(chunk.Offset)) {
+      return QByteArray();
+    }
+    QByteArray compressed = f.read(chunk.Length);
+    if (compressed.size() != chunk.Length) {
+      return QByteArray();
+    }
+    data += qUncompress(compressed);
+  }
+  return data;
+}
@@ -0,0 +1,60 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LOCALHISTORY_H
+#define LOCALHISTORY_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// Where one chunk of a version is kept: which pack, and where in it.
+struct history_chunk_s {
+  QByteArray Hash;
+  QString Pack;
+  qint64 Offset;
+  qint32 Length;
+};
+
+// One saved version of a file: when, how big, and the chunks it is made of, in order.
+struct history_revision_s {
+  qint64 Time;
+  qint64 Size;
+  QVector<history_chunk_s> Chunks;
+};
+
+// Every version of every file ever saved, kept in a content-addressed store.  Files are cut in to
+// chunks where the content says to (not at fixed offsets, so an insertion only changes the chunks
+// around it), and each chunk is stored once per file, compressed, and found by its SHA-1.  Saving a
+// big script over and over only ever adds the few chunks that changed, all in one pack written in
+// one go, plus a short list of which chunks make up the new version.  Everything here blocks, and
+// is meant to be run on a worker.
+class LocalHistory {
+ public:
+  // Keep `data` as the newest version of `path`, as it was at `time`.  Safe to call from several
+  // workers at once.
+  static void record(const QString &path, const QByteArray &data, qint64 time);
+
+  // Every version of `path` kept, oldest first.
+  static QVector<history_revision_s> revisions(const QString &path);
+
+  // The contents of one version, or nothing if any of it has gone missing.
+  static QByteArray read(const history_revision_s &revision);
+
+  // Where each chunk of `data` ends.  Between 2 and 64 KB, and around 8 KB on average.
+  static QVector<int> boundaries(const char *data, int size);
+};
+
+#endif // LOCALHISTORY_H
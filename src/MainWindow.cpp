@@ -19,33 +19,53 @@
 #include <QFile>
 #include <QFileDialog>
 #include <QTextCodec>
-#include <QTextStream>
 #include <QFont>
 #include <QFontDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QMimeData>
 #include <QRegExp>
 #include <QSettings>
 #include <QUndoStack>
 #include <QLabel>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QScrollBar>
 #include <QColorDialog>
+#include <QSet>
+#include <QTextBlock>
+#include <QtConcurrent>
 
 #include "AboutDialog.h"
 #include "Compiler.h"
 #include "CompilerSettingsDialog.h"
+#include "EditJournal.h"
 #include "ServerSettingsDialog.h"
 #include "EditorWidget.h"
+#include "FileLoader.h"
+#include "FileSaver.h"
+#include "FileSearch.h"
+#include "FileViewer.h"
 #include "FindDialog.h"
+#include "FindInFilesDialog.h"
 #include "GoToDialog.h"
+#include "HistoryDialog.h"
 #include "MainWindow.h"
+#include "NativeCache.h"
+#include "NativeScanner.h"
+#include "NativesModel.h"
 #include "OutputWidget.h"
+#include "PawnLexer.h"
+#include "RenameDialog.h"
 #include "ReplaceDialog.h"
+#include "SingleInstance.h"
 #include "StatusBar.h"
 
 #include "ui_MainWindow.h"
 
+// Files this big are opened in a viewer rather than an editor.
+static const qint64 ViewerSize = Q_INT64_C(64) << 20;
+
 MainWindow::MainWindow(QWidget *parent)
   : QMainWindow(parent),
     ui_(new Ui::MainWindow),
@@ -58,6 +78,12 @@ MainWindow::MainWindow(QWidget *parent)
   ui_->tabWidget->setTabsClosable(true);
 
   setStatusBar(new StatusBar(this));
+  loadProgress_ = new QProgressBar(this);
+  loadProgress_->setRange(0, 100);
+  loadProgress_->setMaximumWidth(160);
+  loadProgress_->setTextVisible(false);
+  loadProgress_->hide();
+  statusBar()->addPermanentWidget(loadProgress_);
 
   QSettings settings;
 
@@ -98,31 +124,66 @@ MainWindow::MainWindow(QWidget *parent)
   }
 
   int loaded = 0;
-  if (QApplication::instance()->arguments().size() > 1) {
-    if (loadFile(QApplication::instance()->arguments()[1])) {
+  int viewed = -1;
+  QStringList arguments = QApplication::instance()->arguments().mid(1);
+  if (!arguments.isEmpty()) {
+    loaded += openFiles(arguments);
+  } else if (settings.contains("Session") || settings.contains("LastFiles")) {
+    QVariantList session = settings.value("Session").toList();
+    if (session.isEmpty()) {
+      // From before the session kept which way round selections were, or the scroll position.
+      QStringList lastOpenedFileNames = settings.value("LastFiles").toStringList();
+      QVariantList lastStarts = settings.value("LastStarts", QVariantList()).toList();
+      QVariantList lastEnds = settings.value("LastEnds", QVariantList()).toList();
+      for (int i = 0; i != lastOpenedFileNames.size(); ++i) {
+        QVariantMap tab;
+        tab.insert("Path", lastOpenedFileNames[i]);
+        if (i < lastStarts.size() && i < lastEnds.size()) {
+          tab.insert("Anchor", lastStarts[i]);
+          tab.insert("Position", lastEnds[i]);
+        }
+        session.push_back(tab);
+      }
+    }
+    // Every tab comes back straight away, but only the one that was being looked at is read now.
+    // The rest are read when they are first looked at, or in the background once nothing else is.
+    int lastViewed = settings.value("LastViewed", 0).toInt();
+    for (int i = 0; i != session.size(); ++i) {
+      QVariantMap tab = session[i].toMap();
+      QString path = tab.value("Path").toString();
+      // Viewers stay viewers, even for files small enough that they would open in an editor.
+      bool viewer = tab.value("Viewer", false).toBool();
+      if (path.isEmpty() || !(viewer ? loadViewer(path) : loadFile(path, i != lastViewed))) {
+        continue;
+      }
       ++loaded;
+      if (i == lastViewed) {
+        viewed = editors_.size() - 1;
+      }
+      if (EditorWidget* editor = editors_.last()) {
+        // Still loading, so this happens once it is all in.
+        editor->setView({ tab.value("Anchor", 0).toInt(),
+                          tab.value("Position", 0).toInt(),
+                          tab.value("Scroll", -1).toInt() });
+      }
     }
-  } else if (settings.contains("LastFiles")) {
-    QStringList lastOpenedFileNames = settings.value("LastFiles").toStringList();
-    int idx = settings.contains("LastStarts") && settings.contains("LastEnds") ? 0 : -1000000;
-    QVariantList lastStarts = settings.value("LastStarts", QVariantList()).toList();
-    QVariantList lastEnds = settings.value("LastEnds", QVariantList()).toList();
-    for (auto const & i : lastOpenedFileNames) {
-      if (!i.isEmpty() && loadFile(i)) {
+  }
+  // Changes that were never saved, because Qawno (or the computer) didn't get to close properly.
+  QStringList journals = EditJournal::orphans();
+  if (!journals.isEmpty()) {
+    QString message = tr("Qawno didn't close properly, and there were unsaved changes to %n file(s).  "
+                         "Recover them?", "", journals.size());
+    int result = QMessageBox::question(this,
+                                       QCoreApplication::applicationName(),
+                                       message,
+                                       QMessageBox::Yes | QMessageBox::No);
+    for (auto const & journal : journals) {
+      if (result == QMessageBox::Yes) {
+        recoverFile(journal);
         ++loaded;
-        if (idx >= 0) {
-          EditorWidget* editor = editors_.last();
-          QTextCursor cursor = editor->textCursor();
-          int p0 = lastStarts[idx].toInt();
-          int p1 = lastStarts[idx].toInt();
-          cursor.setPosition(p0, QTextCursor::MoveAnchor);
-          cursor.setPosition(p1, QTextCursor::KeepAnchor);
-          editor->setFocus(Qt::OtherFocusReason);
-          editor->setTextCursor(cursor);
-          editor->ensureCursorVisible();
-        }
+      } else {
+        EditJournal::remove(journal);
       }
-      ++idx;
     }
   }
   if (loaded == 0) {
@@ -131,17 +192,51 @@ MainWindow::MainWindow(QWidget *parent)
 
   connect(ui_->tabWidget, SIGNAL(currentChanged(int)), SLOT(currentChanged(int)));
   connect(ui_->tabWidget, SIGNAL(tabCloseRequested(int)), SLOT(tabCloseRequested(int)));
-  connect(ui_->functions, SIGNAL(currentRowChanged(int)), SLOT(currentRowChanged(int)));
-  connect(ui_->functions, SIGNAL(itemClicked(QListWidgetItem*)), SLOT(itemClicked(QListWidgetItem*)));
-  connect(ui_->functions, SIGNAL(itemDoubleClicked(QListWidgetItem*)), SLOT(itemDoubleClicked(QListWidgetItem*)));
+  nativesModel_ = new NativesModel(this);
+  ui_->functions->setModel(nativesModel_);
+  connect(ui_->functions->selectionModel(), SIGNAL(currentRowChanged(QModelIndex, QModelIndex)), SLOT(nativeCurrentChanged(QModelIndex)));
+  connect(ui_->functions, SIGNAL(clicked(QModelIndex)), SLOT(nativeClicked(QModelIndex)));
+  connect(ui_->functions, SIGNAL(doubleClicked(QModelIndex)), SLOT(nativeDoubleClicked(QModelIndex)));
+  connect(ui_->nativeFilter, SIGNAL(textChanged(QString)), nativesModel_, SLOT(setFilter(QString)));
+  ui_->reachableNatives->setChecked(settings.value("ReachableNatives", false).toBool());
+  graphTimer_.setSingleShot(true);
+  graphTimer_.setInterval(500);
+  connect(ui_->reachableNatives, SIGNAL(toggled(bool)), SLOT(reachableNativesToggled(bool)));
+  connect(&graphTimer_, SIGNAL(timeout()), SLOT(updateIncludeGraph()));
+  connect(&includeGraph_, SIGNAL(changed()), &graphTimer_, SLOT(start()));
+  connect(&includeGraph_, SIGNAL(resolved(QString, QSet<QString>)), SLOT(includesResolved(QString, QSet<QString>)));
+  graphTimer_.start();
   connect(ui_->output, SIGNAL(cursorPositionChanged()), SLOT(errorClicked()));
+  connect(ui_->results, SIGNAL(activated(QString, int, int)), SLOT(resultActivated(QString, int, int)));
+  ui_->results->hide();
+  ui_->findBar->hide();
+  connect(&nativesWatcher_, SIGNAL(finished()), SLOT(nativesLoaded()));
+  connect(&replaceWatcher_, SIGNAL(finished()), SLOT(replaceAllFound()));
+  connect(&saveWatcher_, SIGNAL(finished()), SLOT(filesSaved()));
+  // Tools often write a file several times in a row (or delete and recreate it), so wait for them
+  // to settle.
+  fileTimer_.setSingleShot(true);
+  fileTimer_.setInterval(300);
+  connect(&fileWatcher_, SIGNAL(fileChanged(QString)), SLOT(fileChanged(QString)));
+  connect(&fileTimer_, SIGNAL(timeout()), SLOT(checkChangedFiles()));
+  restoreTimer_.setSingleShot(true);
+  restoreTimer_.setInterval(250);
+  connect(&restoreTimer_, SIGNAL(timeout()), SLOT(loadNextTab()));
+  hibernateTimer_.setInterval(30000);
+  connect(&hibernateTimer_, SIGNAL(timeout()), SLOT(hibernateTabs()));
+  hibernateTimer_.start();
   QApplication::instance()->installEventFilter(this);
 
   loadNativeList();
 
   updateTitle();
 
-  ui_->tabWidget->setCurrentIndex(settings.value("LastViewed", 0).toInt());
+  if (viewed != -1) {
+    ui_->tabWidget->setCurrentIndex(viewed);
+  }
+  // The tab that was being looked at might not have come back, so read whichever one is instead.
+  loadDeferred(getCurrentEditor());
+  restoreTimer_.start();
 }
 
 MainWindow::~MainWindow() {
@@ -152,23 +247,28 @@ MainWindow::~MainWindow() {
     settings.setValue("WindowSize", size());
   }
 
-  QStringList files {};
-  for (auto const& i : fileNames_) {
-    files.push_back(i);
-  }
-  settings.setValue("LastFiles", files);
-
-  QVariantList starts {};
-  QVariantList ends {};
-  for (auto editor : editors_) {
-    QTextCursor cursor = editor->textCursor();
-    starts.push_back(cursor.selectionStart());
-    ends.push_back(cursor.selectionEnd());
+  // Tabs that were never looked at still have the view they were restored with.
+  QVariantList session {};
+  for (int i = 0; i != fileNames_.size(); ++i) {
+    QVariantMap tab;
+    tab.insert("Path", fileNames_[i]);
+    if (editors_[i]) {
+      editor_view_s view = editors_[i]->view();
+      tab.insert("Anchor", view.Anchor);
+      tab.insert("Position", view.Position);
+      tab.insert("Scroll", view.Scroll);
+    } else {
+      tab.insert("Viewer", true);
+    }
+    session.push_back(tab);
   }
-  settings.setValue("LastStarts", starts);
-  settings.setValue("LastEnds", ends);
+  settings.setValue("Session", session);
+  settings.remove("LastFiles");
+  settings.remove("LastStarts");
+  settings.remove("LastEnds");
 
   settings.setValue("LastViewed", getCurrentIndex());
+  settings.setValue("ReachableNatives", ui_->reachableNatives->isChecked());
 
   delete ui_;
 }
@@ -183,127 +283,239 @@ QString MainWindow::deprototype(QString func) {
 }
 
 void MainWindow::loadNativeList() {
-  // Declare an invalid symbol for list items that aren't real symbols.
-  QListWidgetItem* child;
-  QFont* fileFont = new QFont("Sans Serif", 20, 2);
-  QFont* funcFont = new QFont("Sans Serif", 12, 2);
-  QFont* headFont = new QFont("Sans Serif", 12, 2);
-  // Loop through all `includes/*.inc` files (ensure they aren't directories).
-  QDir includes("./include", "*.inc", QDir::IgnoreCase, QDir::Files | QDir::Readable);
-  for (auto const & fileName : includes.entryInfoList()) {
-    QFile f{fileName.absoluteFilePath()};
-    if (f.open(QFile::ReadOnly | QFile::Text)) {
-      child = nullptr;
-      // Find every line that starts with `native`.
-      while (!f.atEnd()) {
-        QByteArray line = f.readLine();
-        // Skip leading whitespace.
-        int idx = 0, len = line.size();
-        char const* data = line.constData();
-        while (idx < len) {
-          if (data[idx] > ' ') {
-            break;
-          }
-          ++idx;
-        }
-        if (idx < len) {
-          if (strncmp(data + idx, "native ", 7) == 0) {
-            idx += 7;
-
-            // Work forwards to the start of text.
-            while (data[idx] <= ' ') {
-              if (data[idx] == '\n' || data[idx] == '\r') {
-                goto not_a_native;
-              }
-              ++idx;
-            }
-
-            // Work back to the end of the parameters (skips `= other;` too).
-            do {
-              --len;
-              if (len == idx) {
-                goto not_a_native;
-              }
-            } while (data[len] != ')');
-
-            // Extract the full name, return, and parameters.
-            QString withArgs = QString::fromStdString(std::string(data + idx, (size_t)len - idx + 1));
-
-            // Extract just the name.
-            len = idx;
-            for ( ; ; ) {
-              if (data[len] == '\n' || data[len] == '\r') {
-                // Remove this from the list again.  We can't add the name after here because we've
-                // clobbered the indexes.
-                goto not_a_native;
-              }
-              if (data[len] == ':') {
-                // Skip the return tag.
-                idx = len + 1;
-              }
-              if (data[len] == '(') {
-                // Found the parameters start.
-                break;
-              }
-              ++len;
-            }
-            // Found some function name.
-            while (data[idx] <= ' ') {
-              ++idx;
-            }
-            do {
-              --len;
-            }
-            while (data[len] <= ' ');
-            ++len;
-            if (idx < len) {
-              if (!child)
-              {
-                // first valid entry from this file.  Add the filename too.
-                // Extra scope for `name`.
-                child = new QListWidgetItem("\n" + fileName.fileName() + "\n", ui_->functions);
-                child->setFont(*fileFont);
-                child->setTextAlignment(4);
-                child->setFlags(child->flags() & ~Qt::ItemIsSelectable & ~Qt::ItemIsEnabled);
-                // Pad the natives list so indexing works, though we never see this in the status bar.
-              }
-              if (data[idx] == '#') {
-                // Special syntax:
-                //
-                //   native #Heading();
-                //
-                // Purely for Qawno titles.
-                QString name = QString::fromStdString(std::string(data + idx + 1, (size_t)len - idx - 1));
-                child = new QListWidgetItem("\n" + name + "\n", ui_->functions);
-                child->setFont(*headFont);
-                child->setTextAlignment(4);
-                child->setFlags(child->flags() & ~Qt::ItemIsSelectable & ~Qt::ItemIsEnabled);
-              } else {
-                QString name = QString::fromStdString(std::string(data + idx, (size_t)len - idx));
-                child = new QListWidgetItem(name, ui_->functions);
-                child->setFont(*funcFont);
-                child->setData(Qt::ToolTipRole, "native " + withArgs + ";");
-                child->setData(Qt::StatusTipRole, withArgs);
-                // Add the native to the list of auto-complete predictions with default likelihood.
-                predictions_.insert(name, { 1, 1 });
-              }
-            }
-          }
-        }
-not_a_native:
-        (void)0;
+  // Watch the includes so that new or updated files show up without a restart.  Editors often
+  // The same directories the include graph looks in, or the reachable natives filter hides them all.
+  // The same directory the include graph looks in, or the reachable natives filter hides them all.
+  includeDirectory_ = Compiler::includeDirectory();
+  includeTimer_.setSingleShot(true);
+  includeTimer_.setInterval(500);
+  connect(&includeWatcher_, SIGNAL(directoryChanged(QString)), &includeTimer_, SLOT(start()));
+  connect(&includeWatcher_, SIGNAL(fileChanged(QString)), &includeTimer_, SLOT(start()));
+  connect(&includeTimer_, SIGNAL(timeout()), SLOT(rescanNatives()));
+  rescanNatives();
+  updateSearchIndex();
+}
+
+void MainWindow::rescanNatives() {
+  if (nativesWatcher_.isRunning()) {
+    // Try again once the current scan is published.
+    includeTimer_.start();
+    return;
+  }
+  // Every include directory the compiler is told about (with `-i`), as well as its own.  They are
+  // read again every time, since the compiler options might have changed since.
+  includeDirectories_ = IncludeGraph::searchPaths(QString());
+  watchIncludeDirectories();
+  // Parse every include on the thread pool so the window doesn't wait for large include folders.
+  // The results are published all at once in `nativesLoaded`.  Unchanged includes come straight
+  // from the cache of the last run, so a rescan only parses the files that were touched.
+  QStringList directories = includeDirectories_;
+  nativesWatcher_.setFuture(QtConcurrent::run([directories]() {
+    QVector<native_file_s> files;
+    for (auto const & directory : directories) {
+      files += NativeScanner::scanDirectory(directory, NativeCache::pathFor(directory));
+    }
+    return files;
+  }));
+}
+
+void MainWindow::watchIncludeDirectories() {
+  // A directory that isn't there (yet) is waited for by watching the closest one above it that is,
+  // which changes when it is made.
+  QSet<QString> wanted;
+  for (auto const & directory : includeDirectories_) {
+    QFileInfo info(directory);
+    while (!info.isDir() && !info.isRoot() && info.absolutePath() != info.absoluteFilePath()) {
+      info.setFile(info.absolutePath());
+    }
+    if (info.isDir()) {
+      wanted.insert(info.absoluteFilePath());
+    }
+  }
+  QSet<QString> watched = includeWatcher_.directories().toSet();
+  QStringList gone = (watched - wanted).toList();
+  if (!gone.isEmpty()) {
+    includeWatcher_.removePaths(gone);
+  }
+  QStringList added = (wanted - watched).toList();
+  if (!added.isEmpty()) {
+    includeWatcher_.addPaths(added);
+  }
+}
+
+void MainWindow::nativesLoaded() {
+  QVector<native_file_s> fresh = nativesWatcher_.result();
+  // Work out which files are exactly as they were.  Only the others touch the list.
+  QHash<QString, QByteArray> hashes;
+  for (auto const & file : natives_) {
+    hashes.insert(file.Path, file.Hash);
+  }
+  QSet<QString> unchanged;
+  for (auto const & file : fresh) {
+    auto it = hashes.constFind(file.Path);
+    if (it != hashes.constEnd() && *it == file.Hash) {
+      unchanged.insert(file.Path);
+    }
+  }
+  // Remove deleted and modified files.
+  for (auto const & file : natives_) {
+    if (!unchanged.contains(file.Path)) {
+      nativesModel_->removeFile(file.Path);
+      updateNativePredictions(file, false);
+    }
+  }
+  // Both lists are in directory order, so new and modified files go back in the same place.
+  for (int i = 0; i != fresh.size(); ++i) {
+    if (!unchanged.contains(fresh[i].Path)) {
+      nativesModel_->insertFile(i, fresh[i]);
+      updateNativePredictions(fresh[i], true);
+    }
+  }
+  natives_ = fresh;
+
+  // Files are watched individually as well, since not every platform reports in-place writes as
+  // directory changes.  Saving by replacing the file also drops the old watch.
+  QStringList watched = includeWatcher_.files();
+  if (!watched.isEmpty()) {
+    includeWatcher_.removePaths(watched);
+  }
+  QStringList paths;
+  for (auto const & file : natives_) {
+    paths.push_back(file.Path);
+  }
+  if (!paths.isEmpty()) {
+    includeWatcher_.addPaths(paths);
+  }
+}
+
+void MainWindow::updateNativePredictions(native_file_s const& file, bool add) {
+  // Add the natives to the list of auto-complete predictions with default likelihood, or take
+  // them away again when the include changes.  These are counted like any other symbol, so a
+  // native that is also used in an open file stays predicted.  Unlike symbols typed, every native
+  // is there however short its name.
+  QHash<QString, int> names;
+  for (auto const & native : file.Natives) {
+    if (!native.Heading) {
+      ++names[native.Name];
+    }
+  }
+  addSymbols(names, add);
+}
+
+void MainWindow::reachableNativesToggled(bool checked) {
+  if (checked) {
+    updateIncludeGraph();
+  } else {
+    nativesModel_->clearRestriction();
+  }
+}
+
+void MainWindow::updateIncludeGraph() {
+  EditorWidget* editor = getCurrentEditor();
+  if (!editor) {
+    return;
+  }
+  // Use the text in the editor, so that a newly typed `#include` counts before it is saved.
+  QString const& root = getCurrentName();
+  includeGraph_.update(root, editor->toPlainText(), IncludeGraph::searchPaths(root));
+}
+
+void MainWindow::includesResolved(const QString& root, const QSet<QString>& files) {
+  // Ignore results for a tab we've already left.
+  QString const& current = getCurrentName();
+  if (root != (current.isEmpty() ? QString() : IncludeGraph::normalise(current))) {
+    return;
+  }
+  if (ui_->reachableNatives->isChecked()) {
+    nativesModel_->restrictFiles(files);
+  }
+  updateIndexes(files);
+  updateSearchIndex();
+}
+
+void MainWindow::updateIndexes(const QSet<QString>& files) {
+  // Everything the current file can see, plus every other open file.  The current file and any
+  // with unsaved changes are indexed from the editor rather than the disk.
+  QSet<QString> paths = files;
+  QSet<QString> closed = files;
+  QHash<QString, QString> buffers;
+  for (int i = 0; i != editors_.size(); ++i) {
+    if (!editors_[i]) {
+      // Viewers are read from disk like any other closed file.
+      continue;
+    }
+    QString path = fileNames_[i].isEmpty() ? QString() : IncludeGraph::normalise(fileNames_[i]);
+    if (editors_[i]->isLoading()) {
+      // So are files that aren't in their editor yet.
+      if (!path.isEmpty()) {
+        paths.insert(path);
+        closed.insert(path);
       }
+      continue;
+    }
+    closed.remove(path);
+    if (i == getCurrentIndex() || (!path.isEmpty() && editors_[i]->document()->isModified())) {
+      buffers.insert(path, editors_[i]->toPlainText());
+    } else if (!path.isEmpty()) {
+      paths.insert(path);
+    }
+  }
+  // What the other tabs can see stays indexed too, so that going back to one is instant.
+  QSet<QString> keep;
+  for (auto const & name : fileNames_) {
+    if (!name.isEmpty()) {
+      keep.insert(IncludeGraph::normalise(name));
+      keep.unite(includeGraph_.files(name));
+    }
+  }
+  symbolIndex_.update(paths.toList(), keep.toList(), buffers);
+  // Open files keep their own references up to date as they are edited.
+  referenceIndex_.update(closed.toList(), keep.toList());
+}
+
+QString MainWindow::symbolUnderCursor() const {
+  EditorWidget* editor = getCurrentEditor();
+  if (!editor) {
+    return QString();
+  }
+  QTextCursor cursor = editor->textCursor();
+  QString line = cursor.block().text();
+  int start = cursor.positionInBlock();
+  int end = start;
+  while (start > 0 && PawnLexer::isSymbolChar(line[start - 1])) {
+    --start;
+  }
+  while (end < line.length() && PawnLexer::isSymbolChar(line[end])) {
+    ++end;
+  }
+  if (start == end || !PawnLexer::isSymbolStart(line[start])) {
+    return QString();
+  }
+  return line.mid(start, end - start);
+}
+
+void MainWindow::resultActivated(const QString& path, int line, int column) {
+  if (path.isEmpty()) {
+    // The unsaved file the search was started from.
+    if (EditorWidget* editor = getCurrentEditor()) {
+      editor->jumpToLine(line + 1, column);
+      editor->setFocus(Qt::OtherFocusReason);
+    }
+  } else {
+    jumpToLine(path, line + 1, column);
+    if (EditorWidget* editor = getCurrentEditor()) {
+      editor->setFocus(Qt::OtherFocusReason);
     }
   }
 }
 
-void MainWindow::itemDoubleClicked(QListWidgetItem* item) {
+void MainWindow::nativeDoubleClicked(const QModelIndex& index) {
   // Insert this text in to the current position.
   if (EditorWidget* editor = getCurrentEditor()) {
     // Insert the current function name.
     QTextCursor cursor = editor->textCursor();
     int pos = cursor.selectionStart();
-    QString insert = deprototype(item->data(Qt::StatusTipRole).toString());
+    QString insert = deprototype(index.data(Qt::StatusTipRole).toString());
     cursor.insertText(insert);
     // Jump to the start of the parameters.
     cursor.setPosition(pos + insert.indexOf('(') + 1);
@@ -312,13 +524,14 @@ void MainWindow::itemDoubleClicked(QListWidgetItem* item) {
   }
 }
 
-void MainWindow::itemClicked(QListWidgetItem* item) {
-  statusBar()->showMessage(item->data(Qt::ToolTipRole).toString());
+void MainWindow::nativeClicked(const QModelIndex& index) {
+  statusBar()->showMessage(index.data(Qt::ToolTipRole).toString());
 }
 
 void MainWindow::currentChanged(int index) {
   hidePopup();
   startWord();
+  graphTimer_.start();
   if (index != -1) {
     // Remove this index from the MRU list.
     mru_.removeAll(index);
@@ -326,6 +539,58 @@ void MainWindow::currentChanged(int index) {
     mru_.push(index);
   }
   updateTitle();
+  updateSearchIndex();
+  ui_->findBar->setEditor(getCurrentEditor());
+  if (getCurrentViewer()) {
+    ui_->findBar->hide();
+  }
+  loadDeferred(getCurrentEditor());
+}
+
+void MainWindow::loadDeferred(EditorWidget* editor) {
+  if (editor && editor->isDeferred()) {
+    editor->loadNow();
+    loadProgress_->setValue(0);
+    loadProgress_->show();
+  }
+}
+
+void MainWindow::loadNextTab() {
+  // One at a time, and only while nothing else is loading, so the restored tabs don't compete with
+  // the one being looked at.  `fileLoaded` comes back here for the next one.
+  EditorWidget* next = nullptr;
+  for (auto const & editor : editors_) {
+    if (editor && editor->isLoading()) {
+      if (!editor->isDeferred()) {
+        return;
+      } else if (!next && !editor->isHibernating()) {
+        next = editor;
+      }
+    }
+  }
+  loadDeferred(next);
+}
+
+void MainWindow::updateSearchIndex() {
+  // The include folder and the folders of every open file, the same as Find in Files searches (up
+  // to a limit, for a script saved somewhere like the home folder).  Plus everything the open files
+  // include, wherever that is.  Switching tabs doesn't change it.
+  QStringList directories;
+  QSet<QString> files;
+  if (QFileInfo(includeDirectory_).isDir()) {
+    directories.push_back(IncludeGraph::normalise(includeDirectory_));
+  }
+  for (auto const & name : fileNames_) {
+    if (name.isEmpty()) {
+      continue;
+    }
+    QString directory = IncludeGraph::normalise(QFileInfo(name).absolutePath());
+    if (!directories.contains(directory)) {
+      directories.push_back(directory);
+    }
+    files.unite(includeGraph_.files(name));
+  }
+  trigramIndex_.setSources(directories, files.toList());
 }
 
 void MainWindow::tabCloseRequested(int index) {
@@ -339,8 +604,8 @@ void MainWindow::tabCloseRequested(int index) {
   on_actionClose_triggered();
 }
 
-void MainWindow::currentRowChanged(int index) {
-  if (index == -1) {
+void MainWindow::nativeCurrentChanged(const QModelIndex& index) {
+  if (!index.isValid()) {
     if (!getCurrentEditor()) {
       return;
     }
@@ -351,7 +616,7 @@ void MainWindow::currentRowChanged(int index) {
     dynamic_cast<StatusBar*>(statusBar())->setCursorPosition(line, column, selected);
     statusBar()->showMessage("");
   } else {
-    statusBar()->showMessage(ui_->functions->currentItem()->data(Qt::ToolTipRole).toString());
+    statusBar()->showMessage(index.data(Qt::ToolTipRole).toString());
   }
 }
 
@@ -416,7 +681,17 @@ void MainWindow::startWord() {
 }
 
 void MainWindow::on_editor_textChanged() {
+  EditorWidget* sender = qobject_cast<EditorWidget*>(QObject::sender());
+  if (sender && sender->isLoading()) {
+    // Every piece of a file going in.  Everything is looked at once it is all there.
+    return;
+  }
   updateTitle();
+  graphTimer_.start();
+  if (rewriting_ || !sender || sender != getCurrentEditor()) {
+    // The word being typed is only ever in the tab being looked at, and not changed by this.
+    return;
+  }
 
   // Called when the current text changes, every time.  We may need to debounce this a little bit
   // because we are going to be scanning through a long list of strings every keypress otherwise.
@@ -446,36 +721,8 @@ void MainWindow::on_editor_textChanged() {
   // with a non-number, search for auto-complete matches.
   int searchLen = pos - wordStart_;
   if (searchLen >= 3) {
-    // Loop through all the known symbols.
-    suggestions_.clear();
-    for (auto it = predictions_.constBegin(), end = predictions_.constEnd(); it != end; ++it) {
-      auto const& name = it.key();
-      int matchLen = name.length();
-      if (matchLen >= searchLen) {
-        for (int i = wordStart_, j = 0; j != matchLen; ++j) {
-          // Case-insensitive comparison.
-          if (name[j].toUpper() == data[i].toUpper()) {
-            ++i;
-            if (i == pos) {
-              // We've found a candidate, all the characters from `data` (the word currently
-              // being typed).  We sort the matches by `j`, so that the ones that take the fewest
-              // characters to match come first (so `Get` first lists the actual `Get` functions,
-              // before things like `TogglePlayerScoresPingsUpdate` which just happen to have `g`,
-              // `e`, and `t` somewhere in that order.  We also store "likelihood" metrics with
-              // the names, so that those symbols that are used more move up the list quickly.
-              // Probably double the likelihood every time a symbol is selected and subtract this
-              // value from the length.
-              // Get the final sort position.
-              suggestions_.push_back({ &name, j - it.value().Count - it.value().Rank });
-              break;
-            }
-          }
-        }
-      }
-    }
+    findSuggestions(predictions_, data + wordStart_, searchLen, suggestions_);
     if (suggestions_.size()) {
-      // There are some suggestions.  Sort them.
-      std::sort(suggestions_.begin(), suggestions_.end());
       // Determine where to draw the suggestions box.
       QRect rect = editor->cursorRect();
       popup_ = new QListWidget(editor);
@@ -501,6 +748,39 @@ void MainWindow::on_editor_textChanged() {
   }
 }
 
+void MainWindow::findSuggestions(QHash<QString, predictions_s> const& predictions,
+                                 QChar const* word, int length, QVector<suggestions_s>& suggestions) {
+  // Loop through all the known symbols.
+  suggestions.clear();
+  for (auto it = predictions.constBegin(), end = predictions.constEnd(); it != end; ++it) {
+    auto const& name = it.key();
+    int matchLen = name.length();
+    if (matchLen >= length) {
+      for (int i = 0, j = 0; j != matchLen; ++j) {
+        // Case-insensitive comparison.
+        if (name[j].toUpper() == word[i].toUpper()) {
+          ++i;
+          if (i == length) {
+            // We've found a candidate, all the characters from `word` (the word currently being
+            // typed).  We sort the matches by `j`, so that the ones that take the fewest
+            // characters to match come first (so `Get` first lists the actual `Get` functions,
+            // before things like `TogglePlayerScoresPingsUpdate` which just happen to have `g`,
+            // `e`, and `t` somewhere in that order.  We also store "likelihood" metrics with the
+            // names, so that those symbols that are used more move up the list quickly.
+            // Probably double the likelihood every time a symbol is selected and subtract this
+            // value from the length.
+            // Get the final sort position.
+            suggestions.push_back({ &name, j - it.value().Count - it.value().Rank });
+            break;
+          }
+        }
+      }
+    }
+  }
+  // Sort them.
+  std::sort(suggestions.begin(), suggestions.end());
+}
+
 void MainWindow::finishSymbol(QString const& symbol, bool add) {
   // Add or remove the symbol to the predictions list.
   if (symbol.length() < 3) {
@@ -534,10 +814,17 @@ enum file_parse_state_e {
   file_parse_state_preproc,
 };
 
-void MainWindow::parseFile(QString const text, bool add) {
-  // When adding we start in parse state `number` because any symbols at position 0 are already
-  // added to the predictions list by the text edit callback.
-  file_parse_state_e state = add ? file_parse_state_number : file_parse_state_unknown;
+static void countSymbol(QHash<QString, int>& symbols, QString const& symbol) {
+  if (symbol.length() >= 3) {
+    ++symbols[symbol];
+  }
+}
+
+QHash<QString, int> MainWindow::countSymbols(QString const text, bool skipFirst) {
+  QHash<QString, int> symbols;
+  // When adding typed text we start in parse state `number` because any symbols at position 0 are
+  // already added to the predictions list by the text edit callback.
+  file_parse_state_e state = skipFirst ? file_parse_state_number : file_parse_state_unknown;
   QChar const* data = text.data();
   int len = text.length();
   QString symbol = "";
@@ -571,7 +858,7 @@ void MainWindow::parseFile(QString const text, bool add) {
       if (len && *data == '/') {
         switch (state) {
         case file_parse_state_symbol:
-          finishSymbol(symbol, add);
+          countSymbol(symbols, symbol);
           // Fallthrough.
         case file_parse_state_number:
         case file_parse_state_unknown:
@@ -583,7 +870,7 @@ void MainWindow::parseFile(QString const text, bool add) {
       } else if (len && *data == '*') {
         switch (state) {
         case file_parse_state_symbol:
-          finishSymbol(symbol, add);
+          countSymbol(symbols, symbol);
           // Fallthrough.
         case file_parse_state_number:
         case file_parse_state_unknown:
@@ -595,7 +882,7 @@ void MainWindow::parseFile(QString const text, bool add) {
       } else {
         switch (state) {
         case file_parse_state_symbol:
-          finishSymbol(symbol, add);
+          countSymbol(symbols, symbol);
           // Fallthrough.
         case file_parse_state_number:
           state = file_parse_state_unknown;
@@ -611,7 +898,7 @@ void MainWindow::parseFile(QString const text, bool add) {
           --len;
           break;
         case file_parse_state_symbol:
-          finishSymbol(symbol, add);
+          countSymbol(symbols, symbol);
           // Fallthrough.
         case file_parse_state_number:
           state = file_parse_state_unknown;
@@ -620,7 +907,7 @@ void MainWindow::parseFile(QString const text, bool add) {
       } else {
         switch (state) {
         case file_parse_state_symbol:
-          finishSymbol(symbol, add);
+          countSymbol(symbols, symbol);
           // Fallthrough.
         case file_parse_state_number:
           state = file_parse_state_unknown;
@@ -630,7 +917,7 @@ void MainWindow::parseFile(QString const text, bool add) {
     } else if (ch == '#') {
       switch (state) {
       case file_parse_state_symbol:
-        finishSymbol(symbol, add);
+        countSymbol(symbols, symbol);
         // Fallthrough.
       case file_parse_state_number:
         state = file_parse_state_preproc;
@@ -644,7 +931,7 @@ void MainWindow::parseFile(QString const text, bool add) {
         }
         break;
       case file_parse_state_symbol:
-        finishSymbol(symbol, add);
+        countSymbol(symbols, symbol);
         // Fallthrough.
       case file_parse_state_number:
       case file_parse_state_unknown:
@@ -659,7 +946,7 @@ void MainWindow::parseFile(QString const text, bool add) {
         }
         break;
       case file_parse_state_symbol:
-        finishSymbol(symbol, add);
+        countSymbol(symbols, symbol);
         // Fallthrough.
       case file_parse_state_number:
       case file_parse_state_unknown:
@@ -674,7 +961,7 @@ void MainWindow::parseFile(QString const text, bool add) {
         // Don't reset `escape` at the end of the loop.
         continue;
       case file_parse_state_symbol:
-        finishSymbol(symbol, add);
+        countSymbol(symbols, symbol);
         // Fallthrough.
       case file_parse_state_number:
       case file_parse_state_unknown:
@@ -684,7 +971,7 @@ void MainWindow::parseFile(QString const text, bool add) {
     } else if (ch == '\r' || ch == '\n') {
       switch (state) {
       case file_parse_state_symbol:
-        finishSymbol(symbol, add);
+        countSymbol(symbols, symbol);
         // Fallthrough.
       case file_parse_state_number:
       case file_parse_state_line_comment:
@@ -696,7 +983,7 @@ void MainWindow::parseFile(QString const text, bool add) {
     } else {
       switch (state) {
       case file_parse_state_symbol:
-        finishSymbol(symbol, add);
+        countSymbol(symbols, symbol);
         // Fallthrough.
       case file_parse_state_number:
         state = file_parse_state_unknown;
@@ -705,6 +992,41 @@ void MainWindow::parseFile(QString const text, bool add) {
     }
     escape = false;
   }
+  return symbols;
+}
+
+void MainWindow::addSymbols(QHash<QString, int> const& symbols, bool add) {
+  // The same as `finishSymbol` once per use, but without looking each one up every time.
+  for (auto it = symbols.constBegin(), end = symbols.constEnd(); it != end; ++it) {
+    auto prediction = predictions_.find(it.key());
+    if (add) {
+      if (prediction == predictions_.end()) {
+        predictions_.insert(it.key(), { 1, it.value() });
+      } else {
+        prediction->Count += it.value();
+      }
+    } else if (prediction != predictions_.end()) {
+      if (prediction->Count <= it.value()) {
+        predictions_.erase(prediction);
+      } else {
+        prediction->Count -= it.value();
+      }
+    }
+  }
+}
+
+void MainWindow::parseFile(QString const text, bool add) {
+  addSymbols(countSymbols(text, add), add);
+}
+
+void MainWindow::symbolsCounted() {
+  auto watcher = static_cast<QFutureWatcher<QHash<QString, int>>*>(sender());
+  // Not if the tab was closed in the meantime, or they would never be taken out again.
+  QPointer<EditorWidget> editor = counting_.take(watcher);
+  if (editor) {
+    addSymbols(watcher->result(), true);
+  }
+  watcher->deleteLater();
 }
 
 void MainWindow::replaceSuggestion() {
@@ -788,6 +1110,22 @@ void MainWindow::on_actionOpen_triggered() {
   settings.setValue("LastOpenDir", dir);
 }
 
+void MainWindow::on_actionOpenReadOnly_triggered() {
+  QSettings settings;
+  QString dir = settings.value("LastOpenDir").toString();
+
+  QString caption = tr("Open Read-Only");
+  QString filter = tr("All files (*)");
+  QStringList fileNames = QFileDialog::getOpenFileNames(this, caption, dir, filter);
+
+  for (auto const& fileName : fileNames) {
+    tryLoadFile(fileName, true);
+  }
+  if (!fileNames.isEmpty()) {
+    settings.setValue("LastOpenDir", QFileInfo(fileNames.first()).dir().path());
+  }
+}
+
 void MainWindow::on_actionPaste_triggered() {
   EditorWidget* cur = getCurrentEditor();
   if (cur) {
@@ -1253,10 +1591,20 @@ void MainWindow::on_actionClose_triggered() {
   }
 
   if (canClose) {
-    parseFile(getCurrentEditor()->toPlainText(), false);
+    if (getCurrentEditor()) {
+      removeSymbols(getCurrentEditor());
+      // Whatever wasn't saved was thrown away on purpose.
+      getCurrentEditor()->journal().discard();
+    }
+    // Let go of the mapping straight away.
+    FileViewer* viewer = getCurrentViewer();
     editors_.remove(cur);
     fileNames_.removeAt(cur);
     ui_->tabWidget->removeTab(cur);
+    if (viewer) {
+      viewer->deleteLater();
+    }
+    watchOpenFiles();
 
     if (fileNames_.count() == 0) {
       on_actionNewGM_triggered();
@@ -1305,7 +1653,8 @@ void MainWindow::on_actionQuit_triggered() {
 }
 
 void MainWindow::on_actionSave_triggered() {
-  if (!getCurrentEditor()) {
+  if (!getCurrentEditor() || getCurrentEditor()->isLoading()) {
+    // Saving half a file would lose the rest of it.
     return;
   }
   if (isNewFile()) {
@@ -1313,26 +1662,32 @@ void MainWindow::on_actionSave_triggered() {
     return;
   }
 
-  QFile file(fileNames_[getCurrentIndex()]);
-  if (!file.open(QIODevice::WriteOnly)) {
-    QString message =
-      tr("Could not save to %1: %2.").arg(fileNames_[getCurrentIndex()], file.errorString());
+  // A Save All still writing this file mustn't finish after it.
+  saveWatcher_.waitForFinished();
+  // Back out the way it came in.
+  EditorWidget* editor = getCurrentEditor();
+  saved_file_s saved = FileSaver::save({ fileNames_[getCurrentIndex()], editor->toPlainText(),
+                                         editor->encoding(), editor->hasByteOrderMark() });
+  if (!saved.Error.isEmpty()) {
+    QString message = tr("Could not save to %1: %2.").arg(saved.Path, saved.Error);
     QMessageBox::critical(this,
                           QCoreApplication::applicationName(),
                           message,
                           QMessageBox::Ok);
     return;
   }
-
-  QTextStream output(&file);
-  output.setCodec(QTextCodec::codecForName("Windows-1251"));
-  output << getCurrentEditor()->toPlainText();
-  getCurrentEditor()->textChanged();
+  editor->textChanged();
   setFileModified(false);
-  file.close();
+  // So that this write isn't taken for someone else's.
+  QFileInfo info(saved.Path);
+  editor->setDiskState(info.lastModified().toMSecsSinceEpoch(), info.size());
+  watchOpenFiles();
 }
 
 void MainWindow::on_actionSaveAs_triggered() {
+  if (!getCurrentEditor() || getCurrentEditor()->isLoading()) {
+    return;
+  }
   QSettings settings;
   QString dir = settings.value("LastSaveDir", "../gamemodes").toString();
 
@@ -1350,10 +1705,50 @@ void MainWindow::on_actionSaveAs_triggered() {
 
   ui_->tabWidget->setTabText(getCurrentIndex(), QFileInfo(fileInfo).fileName());
   fileNames_[getCurrentIndex()] = fileName;
+  getCurrentEditor()->journal().setFile(fileName, getCurrentEditor()->encoding(),
+                                        getCurrentEditor()->hasByteOrderMark());
   return on_actionSave_triggered();
 }
 
 void MainWindow::on_actionFind_triggered() {
+  if (FileViewer* viewer = getCurrentViewer()) {
+    // No find bar for a viewer, it only looks when asked.
+    FindDialog dialog;
+    if (dialog.exec() == 1) {
+      ui_->findBar->loadSettings();
+      viewer->find(ui_->findBar->options(), dialog.searchBackwards());
+    }
+    return;
+  }
+  EditorWidget* editor = getCurrentEditor();
+  if (!editor) {
+    return;
+  }
+  ui_->findBar->setEditor(editor);
+  // Start from the selection, unless it is more than one line.
+  QString selected = editor->textCursor().selectedText();
+  ui_->findBar->activate(selected.contains(QChar::ParagraphSeparator) ? QString() : selected);
+}
+
+void MainWindow::on_actionFindNext_triggered() {
+  if (FileViewer* viewer = getCurrentViewer()) {
+    viewer->find(ui_->findBar->options(), false);
+    return;
+  }
+  ui_->findBar->setEditor(getCurrentEditor());
+  ui_->findBar->findNext(false);
+}
+
+void MainWindow::on_actionFindPrevious_triggered() {
+  if (FileViewer* viewer = getCurrentViewer()) {
+    viewer->find(ui_->findBar->options(), true);
+    return;
+  }
+  ui_->findBar->setEditor(getCurrentEditor());
+  ui_->findBar->findNext(true);
+}
+
+void MainWindow::on_actionReplace_triggered() {
   if (!getCurrentEditor()) {
     return;
   }
@@ -1363,235 +1758,349 @@ void MainWindow::on_actionFind_triggered() {
     dialog.exec();
     found = dialog.result();
   }
+  // The dialog and the find bar share their text and options.
+  ui_->findBar->loadSettings();
   switch (found) {
   case 1:
     // "Find".
-    findStart_ = getCurrentEditor()->textCursor().position();
-    findRound_ = 0;
-    on_actionFindNext_triggered();
+    findNextFromDialog();
     break;
   case 2:
     // "Replace".
-    findStart_ = getCurrentEditor()->textCursor().position();
-    findRound_ = 0;
     on_actionReplaceNext_triggered();
     break;
   case 3:
     // "All".
-    findStart_ = getCurrentEditor()->textCursor().position();
-    findRound_ = 0;
     on_actionReplaceAll_triggered();
     break;
   }
 }
 
-void MainWindow::on_actionFindNext_triggered() {
+void MainWindow::findNextFromDialog(std::function<void()> found) {
   if (!getCurrentEditor()) {
     return;
   }
+  // The find bar has the same text and options, and may well have the matches already.
   FindDialog dialog;
-  QTextDocument::FindFlags flags;
+  QString text = dialog.findWhatText();
+  ui_->findBar->setEditor(getCurrentEditor());
+  ui_->findBar->findNext(dialog.searchBackwards(), [this, text, found](bool any) {
+    if (!any) {
+      QString message = tr("No matching text found for \"%1\".").arg(text);
+      QMessageBox::information(this,
+                                QCoreApplication::applicationName(),
+                                message,
+                                QMessageBox::Ok);
+      return;
+    }
+    if (found) {
+      found();
+    }
+  });
+}
 
-  if (dialog.matchCase()) {
-    flags |= QTextDocument::FindCaseSensitively;
+void MainWindow::on_actionFindInFiles_triggered() {
+  search_options_s options;
+  bool project, includes;
+  {
+    FindInFilesDialog dialog(this);
+    if (dialog.exec() != QDialog::Accepted) {
+      return;
+    }
+    options = dialog.options();
+    project = dialog.searchProject();
+    includes = dialog.searchIncludes();
   }
-  if (dialog.matchWholeWords()) {
-    flags |= QTextDocument::FindWholeWords;
+  if (options.Text.isEmpty()) {
+    return;
   }
-  if (dialog.searchBackwards()) {
-    flags |= QTextDocument::FindBackward;
+  QString error = SearchEngine::check(options);
+  if (!error.isEmpty()) {
+    QMessageBox::warning(this, QCoreApplication::applicationName(),
+                         tr("Invalid regular expression: %1").arg(error), QMessageBox::Ok);
+    return;
   }
-
-  QTextCursor current = getCurrentEditor()->textCursor();
-  QTextCursor next;
-
-  if (dialog.useRegExp()) {
-    Qt::CaseSensitivity sens = dialog.matchCase()? Qt::CaseSensitive:
-                                                   Qt::CaseInsensitive;
-    QRegExp regexp(dialog.findWhatText(), sens);
-    next = getCurrentEditor()->document()->find(regexp, current, flags);
-  } else {
-    next = getCurrentEditor()->document()->find(dialog.findWhatText(), current, flags);
+  QStringList directories;
+  if (project && getCurrentEditor() && !isNewFile()) {
+    directories.push_back(QFileInfo(getCurrentName()).absolutePath());
   }
-
-  bool found = !next.isNull() &&
-    (findRound_ == 0 || next.position() < findStart_);
-
-  if (!found && findRound_ > 0) {
-    QString string = dialog.findWhatText();
-    QString message = tr("No matching text found for \"%1\".").arg(string);
-    QMessageBox::information(this,
-                              QCoreApplication::applicationName(),
-                              message,
-                              QMessageBox::Ok);
-    findStart_ = next.position();
-    findRound_ = 0;
-    return;
+  if (includes && QFileInfo(includeDirectory_).isDir()) {
+    directories.push_back(includeDirectory_);
   }
-
-  if (!found && findRound_ == 0) {
-    next = current;
-    if (dialog.searchBackwards()) {
-      next.movePosition(QTextCursor::End);
+  // Open files are searched as they are in the editor, not as they were last saved.
+  QHash<QString, int> opened;
+  for (int i = 0; i != editors_.size(); ++i) {
+    if (editors_[i] && !editors_[i]->isLoading() && !fileNames_[i].isEmpty()) {
+      opened.insert(IncludeGraph::normalise(fileNames_[i]), i);
+    }
+  }
+  QVector<search_job_s> jobs;
+  if (getCurrentEditor() && !getCurrentEditor()->isLoading()) {
+    QString path = isNewFile() ? QString() : IncludeGraph::normalise(getCurrentName());
+    jobs.push_back({ path, true, getCurrentEditor()->toPlainText() });
+  }
+  for (auto const & path : FileSearch::files(directories)) {
+    if (!jobs.isEmpty() && path == jobs.first().Path) {
+      continue;
+    }
+    auto it = opened.constFind(path);
+    if (it == opened.constEnd()) {
+      jobs.push_back({ path, false, QString() });
     } else {
-      next.movePosition(QTextCursor::Start);
+      jobs.push_back({ path, true, editors_[*it]->toPlainText() });
     }
   }
+  // Only read the files that the index says could match.  Checking that a file hasn't changed
+  // since it was indexed means asking the disk, so that is left to the workers.
+  QHash<QString, trigram_file_s> index = trigramIndex_.files();
+  QVector<quint32> trigrams = TrigramIndex::required(options);
+  auto filter = [index, trigrams](const QString& path) {
+    return TrigramIndex::mayContain(index, path, trigrams);
+  };
+  ui_->results->start(tr("Find \"%1\"").arg(options.Text));
+  ui_->results->watch(FileSearch::start(jobs, options, filter));
+  trigramIndex_.refresh();
+  ui_->results->setFocus(Qt::OtherFocusReason);
+}
 
-  getCurrentEditor()->setTextCursor(next);
+void MainWindow::on_actionReplaceNext_triggered() {
+  // Into the editor the match was found in, even if the tab has changed since.
+  QPointer<EditorWidget> editor = getCurrentEditor();
+  findNextFromDialog([editor]() {
+    if (editor) {
+      FindDialog dialog;
+      editor->textCursor().insertText(dialog.replaceText());
+    }
+  });
+}
 
-  if (!found && findRound_ == 0) {
-    findRound_++;
-    on_actionFindNext_triggered();
+void MainWindow::on_actionReplaceAll_triggered() {
+  EditorWidget* editor = getCurrentEditor();
+  if (!editor || replaceWatcher_.isRunning()) {
+    return;
+  }
+  FindDialog dialog;
+  search_options_s options { dialog.findWhatText(), dialog.matchCase(), dialog.matchWholeWords(), dialog.useRegExp() };
+  if (options.Text.isEmpty()) {
+    return;
+  }
+  QString error = SearchEngine::check(options);
+  if (!error.isEmpty()) {
+    QMessageBox::warning(this, QCoreApplication::applicationName(),
+                         tr("Invalid regular expression: %1").arg(error), QMessageBox::Ok);
+    return;
+  }
+  // Find every match on the thread pool, then replace them all at once in `replaceAllFound`.
+  replaceEditor_ = editor;
+  replaceRevision_ = editor->document()->revision();
+  replaceText_ = dialog.replaceText();
+  replaceWatcher_.setFuture(QtConcurrent::run(&SearchEngine::findAll, editor->toPlainText(), options,
+                                              &replaceGeneration_, 0));
+  statusBar()->showMessage(tr("Replacing..."));
+}
+
+void MainWindow::replaceAllFound() {
+  find_matches_t matches = replaceWatcher_.result();
+  EditorWidget* editor = replaceEditor_;
+  statusBar()->clearMessage();
+  if (!editor || editor->document()->revision() != replaceRevision_) {
+    // The matches are for text that isn't there any more.
+    statusBar()->showMessage(tr("The file changed while searching, so nothing was replaced."));
+    return;
+  }
+  if (matches.isEmpty()) {
+    QMessageBox::information(this, QCoreApplication::applicationName(),
+                             tr("No matching text found."), QMessageBox::Ok);
+    return;
   }
+  // One edit, and so one undo step, however many there are.
+  editor->replaceRanges(matches, replaceText_);
+  QMessageBox::information(this, QCoreApplication::applicationName(),
+                           tr("All %1 instances replaced.").arg(matches.size()), QMessageBox::Ok);
 }
 
-void MainWindow::on_actionReplaceNext_triggered() {
+void MainWindow::on_actionGoToLine_triggered() {
+  if (FileViewer* viewer = getCurrentViewer()) {
+    GoToDialog dialog;
+    if (dialog.exec() == QDialog::Accepted) {
+      viewer->jumpToLine(dialog.targetLineNumber());
+    }
+    return;
+  }
   if (!getCurrentEditor()) {
     return;
   }
-  FindDialog dialog;
-  QTextDocument::FindFlags flags;
+  GoToDialog dialog;
+  dialog.exec();
+  getCurrentEditor()->jumpToLine(dialog.targetLineNumber());
+}
 
-  if (dialog.matchCase()) {
-    flags |= QTextDocument::FindCaseSensitively;
+void MainWindow::on_actionGoToDefinition_triggered() {
+  EditorWidget* editor = getCurrentEditor();
+  QString symbol = symbolUnderCursor();
+  if (symbol.isEmpty()) {
+    return;
   }
-  if (dialog.matchWholeWords()) {
-    flags |= QTextDocument::FindWholeWords;
+  QVector<symbol_location_s> found = symbolIndex_.find(symbol);
+  if (found.isEmpty()) {
+    statusBar()->showMessage(tr("No definition found for \"%1\".").arg(symbol));
+    return;
   }
-  if (dialog.searchBackwards()) {
-    flags |= QTextDocument::FindBackward;
+  // Prefer a definition in this file, then functions over defines over enums etc.
+  QString current = getCurrentName().isEmpty() ? QString() : IncludeGraph::normalise(getCurrentName());
+  symbol_location_s const* best = nullptr;
+  for (auto const & location : found) {
+    bool here = location.Path == current;
+    if (!best || (here && best->Path != current)
+        || (here == (best->Path == current) && location.Kind < best->Kind)) {
+      best = &location;
+    }
   }
-
-  QTextCursor current = getCurrentEditor()->textCursor();
-  QTextCursor next;
-
-  if (dialog.useRegExp()) {
-    Qt::CaseSensitivity sens = dialog.matchCase()? Qt::CaseSensitive:
-                                                   Qt::CaseInsensitive;
-    QRegExp regexp(dialog.findWhatText(), sens);
-    next = getCurrentEditor()->document()->find(regexp, current, flags);
+  if (best->Path == current) {
+    editor->jumpToLine(best->Line + 1, best->Column);
   } else {
-    next = getCurrentEditor()->document()->find(dialog.findWhatText(), current, flags);
+    jumpToLine(best->Path, best->Line + 1, best->Column);
   }
+}
 
-  bool found = !next.isNull() &&
-    (findRound_ == 0 || next.position() < findStart_);
-
-  if (!found && findRound_ > 0) {
-    QString string = dialog.findWhatText();
-    QString message = tr("No matching text found for \"%1\".").arg(string);
-    QMessageBox::information(this,
-                              QCoreApplication::applicationName(),
-                              message,
-                              QMessageBox::Ok);
-    findStart_ = next.position();
-    findRound_ = 0;
+void MainWindow::on_actionFindReferences_triggered() {
+  QString symbol = symbolUnderCursor();
+  if (symbol.isEmpty()) {
     return;
   }
-
-  if (!found && findRound_ == 0) {
-    next = current;
-    if (dialog.searchBackwards()) {
-      next.movePosition(QTextCursor::End);
-    } else {
-      next.movePosition(QTextCursor::Start);
+  ui_->results->start(tr("References to \"%1\"").arg(symbol));
+  // Open files first, straight from the editors, then the includes as they are read from disk.
+  QSet<QString> opened;
+  for (int i = 0; i != editors_.size(); ++i) {
+    if (!editors_[i] || editors_[i]->isLoading() || (fileNames_[i].isEmpty() && i != getCurrentIndex())) {
+      // Can't jump back to other unsaved files, and ones still loading are in the index.
+      continue;
+    }
+    QString path = fileNames_[i].isEmpty() ? QString() : IncludeGraph::normalise(fileNames_[i]);
+    opened.insert(path);
+    ui_->results->addFile({ path, editors_[i]->references().find(symbol) });
+  }
+  QVector<reference_job_s> jobs;
+  for (auto const & job : referenceIndex_.find(symbol)) {
+    // The index may not have caught up with a file opened since.
+    if (!opened.contains(job.Path)) {
+      jobs.push_back(job);
     }
   }
-
-  getCurrentEditor()->setTextCursor(next);
-  
-  if (next.hasSelection()) {
-    next.insertText(dialog.replaceText());
-  }
-
-  if (!found && findRound_ == 0) {
-    findRound_++;
-    on_actionReplaceNext_triggered();
+  if (!jobs.isEmpty()) {
+    ui_->results->watch(QtConcurrent::mapped(jobs, &ReferenceIndex::collect));
   }
 }
 
-void MainWindow::on_actionReplaceAll_triggered() {
-  if (!getCurrentEditor()) {
+void MainWindow::on_actionRenameSymbol_triggered() {
+  QString symbol = symbolUnderCursor();
+  if (symbol.isEmpty()) {
     return;
   }
-  FindDialog dialog;
-  QTextDocument::FindFlags flags;
-  bool first = true;
-
-  if (dialog.matchCase()) {
-    flags |= QTextDocument::FindCaseSensitively;
+  bool ok = false;
+  QString name = QInputDialog::getText(this, tr("Rename Symbol"), tr("Rename \"%1\" to:").arg(symbol),
+                                       QLineEdit::Normal, symbol, &ok).trimmed();
+  if (!ok || name.isEmpty() || name == symbol) {
+    return;
   }
-  if (dialog.matchWholeWords()) {
-    flags |= QTextDocument::FindWholeWords;
+  bool valid = PawnLexer::isSymbolStart(name[0]);
+  for (QChar ch : name) {
+    valid = valid && PawnLexer::isSymbolChar(ch);
   }
-  if (dialog.searchBackwards()) {
-    flags |= QTextDocument::FindBackward;
+  if (!valid) {
+    QMessageBox::warning(this, QCoreApplication::applicationName(),
+                         tr("\"%1\" is not a valid name.").arg(name), QMessageBox::Ok);
+    return;
   }
-
-  for ( ; ; ) {
-    QTextCursor current = getCurrentEditor()->textCursor();
-    QTextCursor next;
-
-    if (dialog.useRegExp()) {
-      Qt::CaseSensitivity sens = dialog.matchCase()? Qt::CaseSensitive:
-                                                     Qt::CaseInsensitive;
-      QRegExp regexp(dialog.findWhatText(), sens);
-      next = getCurrentEditor()->document()->find(regexp, current, flags);
-    } else {
-      next = getCurrentEditor()->document()->find(dialog.findWhatText(), current, flags);
+  // Find everything before changing anything.
+  QVector<QVector<result_s>> uses(editors_.size());
+  QSet<QString> opened;
+  QVector<rename_file_s> files;
+  QVector<int> fileEditors;
+  for (int i = 0; i != editors_.size(); ++i) {
+    if (!editors_[i] || editors_[i]->isLoading()) {
+      // Files not in their editor yet are renamed on disk, and read once that is done.
+      continue;
+    } else if (!fileNames_[i].isEmpty()) {
+      opened.insert(IncludeGraph::normalise(fileNames_[i]));
+    } else if (i != getCurrentIndex()) {
+      continue;
     }
-
-    bool found = !next.isNull() &&
-      (findRound_ == 0 || next.position() < findStart_);
-
-    if (!found && findRound_ > 0) {
-      QString string = dialog.findWhatText();
-      QString message = tr("All instances replaced.");
-      QMessageBox::information(this,
-                                QCoreApplication::applicationName(),
-                                message,
-                                QMessageBox::Ok);
-      findStart_ = next.position();
-      findRound_ = 0;
-      return;
+    uses[i] = editors_[i]->references().find(symbol);
+    if (!uses[i].isEmpty()) {
+      QString path = fileNames_[i].isEmpty() ? QString() : IncludeGraph::normalise(fileNames_[i]);
+      files.push_back({ path, uses[i].size(), true, false });
+      fileEditors.push_back(i);
     }
-
-    if (!found && findRound_ == 0) {
-      next = current;
-      if (dialog.searchBackwards()) {
-        next.movePosition(QTextCursor::End);
-      } else {
-        next.movePosition(QTextCursor::Start);
-      }
+  }
+  // Anything found through the compiler's include paths, rather than next to the script, is shared
+  // with every other script and most likely part of the SDK.
+  QString root = fileNames_[getCurrentIndex()].isEmpty()
+    ? QString() : IncludeGraph::normalise(fileNames_[getCurrentIndex()]);
+  QString own = root.isEmpty() ? QString() : QFileInfo(root).absolutePath() + '/';
+  QStringList libraries = IncludeGraph::searchPaths(root);
+  auto isLibrary = [&](const QString& path) {
+    if (!own.isEmpty() && path.startsWith(own)) {
+      return false;
     }
-
-    getCurrentEditor()->setTextCursor(next);
-    
-    if (next.hasSelection()) {
-      if (first) {
-        next.beginEditBlock();
-        first = false;
-      } else {
-        next.joinPreviousEditBlock();
+    for (auto const & library : libraries) {
+      if (path.startsWith(library + '/')) {
+        return true;
       }
-      next.insertText(dialog.replaceText());
-      next.endEditBlock();
     }
-
-    if (!found && findRound_ == 0) {
-      findRound_++;
+    return false;
+  };
+  for (auto const & job : referenceIndex_.find(symbol)) {
+    if (!opened.contains(job.Path)) {
+      files.push_back({ job.Path, job.References.size(), false, isLibrary(job.Path) });
     }
   }
-}
-
-void MainWindow::on_actionGoToLine_triggered() {
-  if (!getCurrentEditor()) {
+  if (files.isEmpty()) {
+    statusBar()->showMessage(tr("No uses of \"%1\" found.").arg(symbol));
     return;
   }
-  GoToDialog dialog;
-  dialog.exec();
-  getCurrentEditor()->jumpToLine(dialog.targetLineNumber());
+  RenameDialog dialog(symbol, name, files, this);
+  if (dialog.exec() != QDialog::Accepted) {
+    return;
+  }
+  QVector<bool> checked = dialog.checked();
+  QStringList closed;
+  for (int i = 0; i != files.size(); ++i) {
+    if (!checked[i]) {
+      if (files[i].Open) {
+        uses[fileEditors[i]].clear();
+      }
+    } else if (!files[i].Open) {
+      closed.push_back(files[i].Path);
+    }
+  }
+  ui_->results->start(tr("Renamed \"%1\" to \"%2\"").arg(symbol, name));
+  // One edit, and so one undo step, per open file.  Every use of the old name becomes a use of the
+  // new one, as far as autocomplete is concerned.
+  QHash<QString, int> before, after;
+  rewriting_ = true;
+  for (int i = 0; i != editors_.size(); ++i) {
+    if (uses[i].isEmpty()) {
+      continue;
+    }
+    editors_[i]->replaceMatches(uses[i], name);
+    before[symbol] += uses[i].size();
+    after[name] += uses[i].size();
+    QString path = fileNames_[i].isEmpty() ? QString() : IncludeGraph::normalise(fileNames_[i]);
+    ui_->results->addFile({ path, editors_[i]->references().find(name), QString() });
+  }
+  rewriting_ = false;
+  // Short names were never added.
+  if (symbol.length() >= 3) {
+    addSymbols(before, false);
+  }
+  if (name.length() >= 3) {
+    addSymbols(after, true);
+  }
+  startWord();
+  if (!closed.isEmpty()) {
+    ui_->results->watch(ReferenceIndex::rename(closed, symbol, name));
+  }
 }
 
 void MainWindow::on_actionEditorFont_triggered() {
@@ -1625,8 +2134,12 @@ void MainWindow::on_actionDarkMode_triggered() {
   QSettings settings;
   bool useDarkMode = !settings.value("DarkMode", false).toBool();
   settings.setValue("DarkMode", useDarkMode);
-  for (auto i : editors_) {
-    i->toggleDarkMode(useDarkMode);
+  for (int i = 0; i != editors_.size(); ++i) {
+    if (editors_[i]) {
+      editors_[i]->toggleDarkMode(useDarkMode);
+    } else if (FileViewer* viewer = qobject_cast<FileViewer*>(ui_->tabWidget->widget(i))) {
+      viewer->toggleDarkMode(useDarkMode);
+    }
   }
   if (useDarkMode) {
     ui_->outerWidget->setPalette(darkModePalette);
@@ -1641,6 +2154,17 @@ void MainWindow::on_actionMRU_triggered() {
   settings.setValue("MRU", useDarkMode);
 }
 
+void MainWindow::on_actionHibernate_triggered() {
+  QSettings settings;
+  bool ok = false;
+  int minutes = QInputDialog::getInt(this, tr("Tab Hibernation"),
+                                     tr("Put tabs to sleep after this many minutes unseen (0 for never):"),
+                                     settings.value("HibernateAfter", 10).toInt(), 0, 24 * 60, 1, &ok);
+  if (ok) {
+    settings.setValue("HibernateAfter", minutes);
+  }
+}
+
 void MainWindow::on_actionCompiler_triggered() {
   Compiler compiler;
   CompilerSettingsDialog dialog;
@@ -1653,6 +2177,8 @@ void MainWindow::on_actionCompiler_triggered() {
   if (dialog.result() == QDialog::Accepted) {
     compiler.setPath(dialog.compilerPath());
     compiler.setOptions(dialog.compilerOptions());
+    // The include directories may be different now.  By the time this runs, they are saved.
+    includeTimer_.start();
   }
 }
 
@@ -1677,17 +2203,198 @@ void MainWindow::on_actionSaveAll_triggered() {
   if (count == 0) {
     return;
   }
-  // Loop over all the tabs and save them all.  There could be include dependencies.
+  // Changed files that have never been saved need a name, which means looking at them.
   for (int i = 0; i != count; ++i) {
-    ui_->tabWidget->setCurrentIndex(i);
-    if (isNewFile()) {
+    if (editors_[i] && !editors_[i]->isLoading() && editors_[i]->document()->isModified()
+        && fileNames_[i].isEmpty()) {
+      ui_->tabWidget->setCurrentIndex(i);
       on_actionSaveAs_triggered();
-    } else {
-      on_actionSave_triggered();
     }
   }
-  // Return to the originally selected tab.
   ui_->tabWidget->setCurrentIndex(cur);
+  // Everything else is copied out and written in the background, without switching tabs.  Only
+  // changed files are written, and files that are loading or asleep can't have changed.
+  if (!saving_.isEmpty()) {
+    // Finish off the last lot first, so that an older copy can't land on top of a newer one.
+    saveWatcher_.waitForFinished();
+    filesSaved();
+  }
+  QVector<save_job_s> jobs;
+  for (int i = 0; i != count; ++i) {
+    EditorWidget* editor = editors_[i];
+    if (editor && !editor->isLoading() && editor->document()->isModified() && !fileNames_[i].isEmpty()) {
+      jobs.push_back({ fileNames_[i], editor->toPlainText(), editor->encoding(), editor->hasByteOrderMark() });
+      saving_.push_back({ editor, editor->document()->revision() });
+    }
+  }
+  if (!jobs.isEmpty()) {
+    saveWatcher_.setFuture(QtConcurrent::mapped(jobs, &FileSaver::save));
+  }
+}
+
+void MainWindow::on_actionHistory_triggered() {
+  EditorWidget* editor = getCurrentEditor();
+  if (!editor || editor->isLoading() || isNewFile()) {
+    return;
+  }
+  HistoryDialog dialog(getCurrentName(), editor->toPlainText(), this);
+  if (dialog.exec() == QDialog::Accepted) {
+    // As one edit, so it can be undone straight back.
+    QTextCursor cursor(editor->document());
+    cursor.select(QTextCursor::Document);
+    cursor.insertText(dialog.selectedText());
+  }
+}
+
+void MainWindow::watchOpenFiles() {
+  QSet<QString> open;
+  for (int i = 0; i != editors_.size(); ++i) {
+    if (editors_[i] && !fileNames_[i].isEmpty()) {
+      open.insert(QFileInfo(fileNames_[i]).absoluteFilePath());
+    }
+  }
+  // Files replaced by renaming over them (as most tools, and Qawno, do) drop out, so this also
+  // puts those back.
+  QSet<QString> watched = fileWatcher_.files().toSet();
+  QStringList gone = (watched - open).toList();
+  QStringList added = (open - watched).toList();
+  if (!gone.isEmpty()) {
+    fileWatcher_.removePaths(gone);
+  }
+  if (!added.isEmpty()) {
+    fileWatcher_.addPaths(added);
+  }
+}
+
+void MainWindow::fileChanged(const QString& path) {
+  changedFiles_.insert(path);
+  fileTimer_.start();
+}
+
+void MainWindow::checkChangedFiles() {
+  if (!saving_.isEmpty()) {
+    // Some of these are probably the Save All still being written.
+    fileTimer_.start();
+    return;
+  }
+  QSet<QString> changed = changedFiles_;
+  changedFiles_.clear();
+  for (int i = 0; i != editors_.size(); ++i) {
+    EditorWidget* editor = editors_[i];
+    if (!editor || fileNames_[i].isEmpty()) {
+      continue;
+    }
+    QFileInfo info(fileNames_[i]);
+    if (!changed.contains(info.absoluteFilePath()) || !info.exists()) {
+      // Deleted files keep their tab, and saving puts them back.
+      continue;
+    }
+    if (editor->isHibernating()) {
+      // What was packed away is out of date, so read the file again instead when it wakes up.
+      addSymbols(hibernated_.take(editor), false);
+      editor->loadLater(fileNames_[i]);
+      continue;
+    } else if (editor->isLoading()) {
+      continue;
+    }
+    qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    if (editor->matchesDisk(modified, info.size())) {
+      // Our own save.
+      continue;
+    }
+    editor->setDiskState(modified, info.size());
+    if (editor->document()->isModified()) {
+      QString message = tr("%1 has been changed by another program.  Reload it and lose your changes?")
+                          .arg(fileNames_[i]);
+      int result = QMessageBox::question(this,
+                                         QCoreApplication::applicationName(),
+                                         message,
+                                         QMessageBox::Yes | QMessageBox::No);
+      if (result != QMessageBox::Yes) {
+        continue;
+      }
+    }
+    // Only the lines that changed are touched, so it is worked out in the background first.
+    reload_s reload { editor, editor->document()->revision(), fileNames_[i], editor->toPlainText(),
+                      file_encoding_ascii, false, QStringList(), QVector<diff_hunk_s>(), QString(),
+                      QHash<QString, int>(), QHash<QString, int>() };
+    auto watcher = new QFutureWatcher<reload_s>(this);
+    connect(watcher, SIGNAL(finished()), SLOT(fileReloaded()));
+    watcher->setFuture(QtConcurrent::run(&MainWindow::diffFile, reload));
+  }
+  watchOpenFiles();
+}
+
+reload_s MainWindow::diffFile(reload_s reload) {
+  loaded_file_s file = FileLoader::read(reload.Path);
+  reload.Encoding = file.Encoding;
+  reload.Bom = file.Bom;
+  reload.Error = file.Error;
+  if (!file.Error.isEmpty()) {
+    return reload;
+  }
+  // The same line breaks as the editor ends up with.
+  file.Text.replace("\r\n", "\n").replace('\r', '\n');
+  reload.Lines = file.Text.split('\n');
+  reload.Hunks = LineDiff::compare(reload.Buffer.split('\n'), reload.Lines);
+  reload.Before = countSymbols(reload.Buffer, false);
+  reload.After = countSymbols(file.Text, false);
+  reload.Buffer.clear();
+  return reload;
+}
+
+void MainWindow::fileReloaded() {
+  auto watcher = static_cast<QFutureWatcher<reload_s>*>(sender());
+  reload_s reload = watcher->result();
+  watcher->deleteLater();
+  EditorWidget* editor = reload.Editor;
+  if (!editor || editors_.indexOf(editor) == -1 || !reload.Error.isEmpty()) {
+    return;
+  }
+  if (editor->document()->revision() != reload.Revision) {
+    // Typed in while the difference was being worked out, so start again.
+    editor->setDiskState(0, -1);
+    fileChanged(QFileInfo(reload.Path).absoluteFilePath());
+    return;
+  }
+  rewriting_ = true;
+  editor->reload(reload.Hunks, reload.Lines, reload.Encoding, reload.Bom);
+  rewriting_ = false;
+  // The same as the file now, whatever it was before.
+  editor->document()->setModified(false);
+  addSymbols(reload.Before, false);
+  addSymbols(reload.After, true);
+  updateTitle();
+  graphTimer_.start();
+  startWord();
+}
+
+void MainWindow::filesSaved() {
+  QStringList errors;
+  for (int i = 0; i != saving_.size(); ++i) {
+    saved_file_s saved = saveWatcher_.resultAt(i);
+    EditorWidget* editor = saving_[i].Editor;
+    if (!saved.Error.isEmpty()) {
+      errors.push_back(tr("Could not save to %1: %2.").arg(saved.Path, saved.Error));
+      continue;
+    }
+    if (editor) {
+      QFileInfo info(saved.Path);
+      editor->setDiskState(info.lastModified().toMSecsSinceEpoch(), info.size());
+    }
+    if (editor && editor->document()->revision() == saving_[i].Revision) {
+      // Only if nothing was typed while it was being written.
+      editor->document()->setModified(false);
+    }
+  }
+  saving_.clear();
+  updateTitle();
+  if (!errors.isEmpty()) {
+    QMessageBox::critical(this,
+                          QCoreApplication::applicationName(),
+                          errors.join("\n"),
+                          QMessageBox::Ok);
+  }
 }
 
 void MainWindow::on_actionCompile_triggered() {
@@ -1695,6 +2402,8 @@ void MainWindow::on_actionCompile_triggered() {
     return;
   }
   on_actionSaveAll_triggered();
+  // The compiler reads them from disk.
+  saveWatcher_.waitForFinished();
   Compiler compiler;
   const QString& fileName = fileNames_[markedIndex_ == -1 ? getCurrentIndex() : markedIndex_];
   ui_->output->clear();
@@ -1735,7 +2444,7 @@ void MainWindow::on_actionMark_triggered() {
   if (markedIndex_ == -1) {
     markedIndex_ = getCurrentIndex();
     if (markedIndex_ != -1) {
-      ui_->tabWidget->setTabIcon(markedIndex_, getCurrentEditor()->style()->standardIcon(QStyle::SP_DialogApplyButton));
+      ui_->tabWidget->setTabIcon(markedIndex_, style()->standardIcon(QStyle::SP_DialogApplyButton));
     }
   } else {
     ui_->tabWidget->setTabIcon(markedIndex_, QIcon(""));
@@ -1769,7 +2478,8 @@ void MainWindow::on_actionAboutQt_triggered() {
 }
 
 void MainWindow::on_editor_cursorPositionChanged() {
-  if (!getCurrentEditor()) {
+  EditorWidget* sender = qobject_cast<EditorWidget*>(QObject::sender());
+  if (!getCurrentEditor() || (sender && sender->isLoading())) {
     return;
   }
   hidePopup();
@@ -1850,28 +2560,56 @@ void MainWindow::updateTitle() {
   setWindowTitle(title);
 }
 
-int MainWindow::tryLoadFile(const QString &fileName) {
+int MainWindow::tryLoadFile(const QString &fileName, bool readOnly) {
+  // The same file can be named in many ways (`..`, slashes, case on Windows).
+  QString normalised = IncludeGraph::normalise(fileName);
   for (int i = fileNames_.count(); i--; ) {
-    if (fileNames_[i] == fileName) {
+    if (!fileNames_[i].isEmpty() && IncludeGraph::normalise(fileNames_[i]) == normalised) {
       ui_->tabWidget->setCurrentIndex(i);
       // It wasn't loaded (but is open).
       return -1;
     }
   }
 
-  return loadFile(fileName) ? 1 : 0;
+  return (readOnly ? loadViewer(fileName) : loadFile(fileName)) ? 1 : 0;
+}
+
+int MainWindow::openFiles(const QStringList &arguments) {
+  int opened = 0;
+  for (auto const & argument : arguments) {
+    open_file_s file = SingleInstance::parse(argument);
+    if (!tryLoadFile(file.Path)) {
+      continue;
+    }
+    ++opened;
+    if (file.Line == 0) {
+      continue;
+    }
+    if (FileViewer* viewer = getCurrentViewer()) {
+      viewer->jumpToLine(file.Line);
+    } else if (EditorWidget* editor = getCurrentEditor()) {
+      editor->jumpToLine(file.Line, file.Column - 1);
+    }
+  }
+  // From another launch, which they did from something now in front of this.
+  if (isVisible()) {
+    setWindowState(windowState() & ~Qt::WindowMinimized);
+    raise();
+    activateWindow();
+  }
+  return opened;
 }
 
-void MainWindow::jumpToLine(const QString& fileName, int line) {
+void MainWindow::jumpToLine(const QString& fileName, int line, int column) {
   if (tryLoadFile(fileName)) {
     // Was just opened, or was already open.  Either way, we're now on the correct tab.
     if (EditorWidget* editor = getCurrentEditor()) {
-      editor->jumpToLine(line);
+      editor->jumpToLine(line, column);
     }
   }
 }
 
-bool MainWindow::loadFile(const QString &fileName, const char* encoding) {
+bool MainWindow::loadFile(const QString &fileName, bool later) {
   bool nu = fileName.startsWith(".");
   QFile file(fileName);
   if (!file.open(QIODevice::ReadOnly)) {
@@ -1883,41 +2621,195 @@ bool MainWindow::loadFile(const QString &fileName, const char* encoding) {
                           QMessageBox::Ok);
     return false;
   }
+  if (!nu && file.size() >= ViewerSize) {
+    // Far too big to edit comfortably (or at all), so just look at it.
+    file.close();
+    return loadViewer(fileName);
+  }
 
-  QTextStream input(&file);
-  input.setCodec(QTextCodec::codecForName(encoding));
+  file.close();
 
   fileNames_.push_back(nu ? "" : fileName);
   QString path = nu ? QString("New %1").arg(++newCount_) : fileName;
   createTab(nu ? path : file.fileName(), path);
-  editors_.last()->setPlainText(input.readAll());
-  parseFile(editors_.last()->toPlainText(), true);
-  setFileModified(false);
-  file.close();
+  // Reading, decoding, and filling the editor all happen in the background, so that even a huge
+  // file doesn't stop the window responding.  The tab is there straight away, read-only.
+  if (later) {
+    editors_.last()->loadLater(fileName);
+  } else {
+    editors_.last()->load(fileName);
+    loadProgress_->setValue(0);
+    loadProgress_->show();
+  }
+
+  return true;
+}
+
+void MainWindow::recoverFile(const QString &journal) {
+  QString fileName = EditJournal::fileName(journal);
+  if (!fileName.isEmpty()) {
+    // Most likely reopened from the last session as well.  The journal goes in that tab instead,
+    // in place of whatever it had read (or was going to read) from the file.
+    QString normalised = IncludeGraph::normalise(fileName);
+    for (int i = 0; i != fileNames_.count(); ++i) {
+      if (fileNames_[i].isEmpty() || IncludeGraph::normalise(fileNames_[i]) != normalised) {
+        continue;
+      }
+      if (EditorWidget* editor = editors_[i]) {
+        removeSymbols(editor);
+        ui_->tabWidget->setCurrentIndex(i);
+        editor->recover(journal);
+        loadProgress_->setValue(0);
+        loadProgress_->show();
+        return;
+      }
+      // Open in a viewer, which can't show unsaved changes, so the journal gets its own tab.
+      break;
+    }
+  }
+  fileNames_.push_back(fileName);
+  QString path = fileName.isEmpty() ? QString("New %1").arg(++newCount_) : fileName;
+  createTab(fileName.isEmpty() ? path : fileName, path);
+  editors_.last()->recover(journal);
+  loadProgress_->setValue(0);
+  loadProgress_->show();
+}
 
+bool MainWindow::loadViewer(const QString &fileName) {
+  FileViewer* viewer = new FileViewer();
+  if (!viewer->open(fileName)) {
+    QString message = tr("Could not open %1: %2.").arg(fileName)
+                                                  .arg(viewer->errorString());
+    QMessageBox::critical(this,
+                          QCoreApplication::applicationName(),
+                          message,
+                          QMessageBox::Ok);
+    delete viewer;
+    return false;
+  }
+  viewer->toggleDarkMode(ui_->actionDarkMode->isChecked());
+  connect(viewer, SIGNAL(lineChanged(qint64)), SLOT(viewerLineChanged(qint64)));
+  connect(viewer, SIGNAL(found(bool)), SLOT(viewerFound(bool)));
+  // Viewer tabs have a name, but no editor.
+  mru_.push(ui_->tabWidget->count());
+  fileNames_.push_back(fileName);
+  editors_.push_back(nullptr);
+  int idx = ui_->tabWidget->addTab(viewer, QFileInfo(fileName).fileName());
+  ui_->tabWidget->setTabToolTip(idx, fileName);
+  ui_->tabWidget->setCurrentIndex(idx);
+  viewer->setFocus(Qt::OtherFocusReason);
   return true;
 }
 
+void MainWindow::removeSymbols(EditorWidget* editor) {
+  // A file still loading hasn't added anything yet (unless it was asleep), and a viewer never does.
+  // Nor has one that is loaded but still being counted, and now never will.
+  QObject* counting = counting_.key(editor, nullptr);
+  if (counting) {
+    counting_.remove(counting);
+  } else if (!editor->isLoading()) {
+    parseFile(editor->toPlainText(), false);
+  } else {
+    addSymbols(hibernated_.take(editor), false);
+  }
+}
+
+FileViewer* MainWindow::getCurrentViewer() const {
+  return qobject_cast<FileViewer*>(ui_->tabWidget->currentWidget());
+}
+
+void MainWindow::viewerLineChanged(qint64 line) {
+  if (sender() == getCurrentViewer()) {
+    statusBar()->showMessage(tr("Line %1").arg(line));
+  }
+}
+
+void MainWindow::viewerFound(bool found) {
+  if (!found && sender() == getCurrentViewer()) {
+    QString message = tr("No matching text found for \"%1\".").arg(ui_->findBar->options().Text);
+    QMessageBox::information(this,
+                             QCoreApplication::applicationName(),
+                             message,
+                             QMessageBox::Ok);
+  }
+}
+
+void MainWindow::fileLoadProgress(int percent) {
+  // Only the tab being looked at moves the bar.
+  if (sender() == getCurrentEditor()) {
+    loadProgress_->setValue(percent);
+  }
+}
+
+void MainWindow::fileLoaded() {
+  EditorWidget* editor = qobject_cast<EditorWidget*>(sender());
+  bool loading = false;
+  for (auto const & other : editors_) {
+    loading = loading || (other && other->isLoading() && !other->isDeferred());
+  }
+  loadProgress_->setVisible(loading);
+  restoreTimer_.start();
+  int index = editors_.indexOf(editor);
+  if (index == -1) {
+    // Closed before it finished.
+    return;
+  }
+  if (!editor->loadError().isEmpty()) {
+    QString message = tr("Could not open %1: %2.").arg(ui_->tabWidget->tabToolTip(index))
+                                                  .arg(editor->loadError());
+    QMessageBox::critical(this,
+                          QCoreApplication::applicationName(),
+                          message,
+                          QMessageBox::Ok);
+    // An empty tab would write over the file if saved.
+    tabCloseRequested(index);
+    return;
+  }
+  // Edits from now on are kept until they are saved.
+  editor->journal().setFile(fileNames_[index], editor->encoding(), editor->hasByteOrderMark());
+  if (!fileNames_[index].isEmpty()) {
+    QFileInfo info(fileNames_[index]);
+    editor->setDiskState(info.lastModified().toMSecsSinceEpoch(), info.size());
+    watchOpenFiles();
+  }
+  updateTitle();
+  graphTimer_.start();
+  if (editor == getCurrentEditor()) {
+    startWord();
+  }
+  hibernateTabs();
+  if (hibernated_.remove(editor)) {
+    // Woken up, with exactly the text whose symbols were never taken out.
+    return;
+  }
+  // The autocomplete list is shared, so the symbols are counted in the background and added here.
+  // The text edit callback ignored the file going in, so the very first symbol counts too.
+  auto watcher = new QFutureWatcher<QHash<QString, int>>(this);
+  counting_.insert(watcher, editor);
+  connect(watcher, SIGNAL(finished()), SLOT(symbolsCounted()));
+  watcher->setFuture(QtConcurrent::run(&MainWindow::countSymbols, editor->toPlainText(), false));
+}
+
 bool MainWindow::isNewFile() const {
   return fileNames_.isEmpty() || fileNames_[getCurrentIndex()].isEmpty();
 }
 
 bool MainWindow::isFileModified() const {
-  return !editors_.isEmpty() && editors_[getCurrentIndex()]->document()->isModified();
+  return getCurrentEditor() && getCurrentEditor()->document()->isModified();
 }
 
 void MainWindow::setFileModified(bool isModified) {
-  if (!editors_.isEmpty()) {
-    editors_[getCurrentIndex()]->document()->setModified(isModified);
+  if (getCurrentEditor()) {
+    getCurrentEditor()->document()->setModified(isModified);
     updateTitle();
   }
 }
 
 bool MainWindow::isFileEmpty() const {
-  if (editors_.isEmpty()) {
+  if (!getCurrentEditor()) {
     return true;
   }
-  QTextDocument *document = editors_[getCurrentIndex()]->document();
+  QTextDocument *document = getCurrentEditor()->document();
   return document->isEmpty()
     || (isNewFile() && !document->toPlainText().contains(QRegExp("\\S")));
 }
@@ -1928,6 +2820,19 @@ void MainWindow::createTab(const QString& title, const QString& tooltip) {
   QHBoxLayout* horizontalLayout = new QHBoxLayout(tab);
   horizontalLayout->setObjectName(QString::fromUtf8("horizontalLayout"));
   horizontalLayout->setMargin(0);
+  EditorWidget* editor = createEditor(tab);
+  horizontalLayout->addWidget(editor);
+  ui_->tabWidget->addTab(tab, QString());
+  int idx = ui_->tabWidget->indexOf(tab);
+  ui_->tabWidget->setTabText(idx, title);
+  ui_->tabWidget->setTabToolTip(idx, tooltip);
+  editors_.push_back(editor);
+  editor->focusWidget();
+  ui_->tabWidget->setCurrentIndex(ui_->tabWidget->count() - 1);
+  editor->setFocus(Qt::OtherFocusReason);
+}
+
+EditorWidget* MainWindow::createEditor(QWidget* tab) {
   EditorWidget* editor = new EditorWidget(tab);
   editor->setObjectName(QString::fromUtf8("editor"));
   QSizePolicy sizePolicy2(QSizePolicy::Expanding, QSizePolicy::Expanding);
@@ -1936,18 +2841,84 @@ void MainWindow::createTab(const QString& title, const QString& tooltip) {
   sizePolicy2.setHeightForWidth(editor->sizePolicy().hasHeightForWidth());
   editor->setSizePolicy(sizePolicy2);
   editor->setAcceptDrops(false);
-  horizontalLayout->addWidget(editor);
-  ui_->tabWidget->addTab(tab, QString());
-  int idx = ui_->tabWidget->indexOf(tab);
-  ui_->tabWidget->setTabText(idx, title);
-  ui_->tabWidget->setTabToolTip(idx, tooltip);
   bool useDarkMode = ui_->actionDarkMode->isChecked();
   editor->toggleDarkMode(useDarkMode);
-  editors_.push_back(editor);
-  editor->focusWidget();
   connect(editor, SIGNAL(textChanged()), SLOT(on_editor_textChanged()));
   connect(editor, SIGNAL(cursorPositionChanged()), SLOT(on_editor_cursorPositionChanged()));
-  ui_->tabWidget->setCurrentIndex(ui_->tabWidget->count() - 1);
-  editor->setFocus(Qt::OtherFocusReason);
+  connect(editor, SIGNAL(definitionRequested()), SLOT(on_actionGoToDefinition_triggered()));
+  connect(editor, SIGNAL(loadProgress(int)), SLOT(fileLoadProgress(int)));
+  connect(editor, SIGNAL(loaded()), SLOT(fileLoaded()));
+  return editor;
+}
+
+void MainWindow::hibernateTabs() {
+  if (packing_) {
+    // Wait for the last lot, so nothing is counted twice.
+    return;
+  }
+  QSettings settings;
+  qint64 after = settings.value("HibernateAfter", 10).toLongLong() * 60000;
+  qint64 budget = settings.value("HibernateBudget", 64).toLongLong() << 20;
+  // Only tabs with nothing to lose can sleep: saved, not being looked at, and not being replaced in.
+  QVector<QPair<qint64, int>> idle;
+  qint64 total = 0;
+  for (int i = 0; i != editors_.size(); ++i) {
+    EditorWidget* editor = editors_[i];
+    if (!editor || editor->isLoading()) {
+      continue;
+    }
+    total += editor->document()->characterCount() * 2;
+    if (i != getCurrentIndex() && !fileNames_[i].isEmpty() && !editor->document()->isModified()
+        && !(editor == replaceEditor_ && replaceWatcher_.isRunning())) {
+      idle.push_back(qMakePair(editor->idleTime(), i));
+    }
+  }
+  // The longest forgotten go first, until the rest are both recent and fit.
+  std::sort(idle.begin(), idle.end());
+  for (int i = idle.size(); i-- != 0; ) {
+    if ((after <= 0 || idle[i].first < after) && (budget <= 0 || total <= budget)) {
+      break;
+    }
+    EditorWidget* editor = editors_[idle[i].second];
+    total -= editor->document()->characterCount() * 2;
+    ++packing_;
+    hibernation_s tab { editor, editor->document()->revision(), packed_file_s {}, QHash<QString, int>() };
+    loaded_file_s file { fileNames_[idle[i].second], editor->toPlainText(),
+                         editor->encoding(), editor->hasByteOrderMark(), QString() };
+    auto watcher = new QFutureWatcher<hibernation_s>(this);
+    connect(watcher, SIGNAL(finished()), SLOT(tabPacked()));
+    watcher->setFuture(QtConcurrent::run(&MainWindow::packTab, tab, file));
+  }
+}
+
+hibernation_s MainWindow::packTab(hibernation_s tab, loaded_file_s const file) {
+  tab.File = FileLoader::pack(file);
+  tab.Symbols = countSymbols(file.Text, false);
+  return tab;
+}
+
+void MainWindow::tabPacked() {
+  auto watcher = static_cast<QFutureWatcher<hibernation_s>*>(sender());
+  hibernation_s tab = watcher->result();
+  watcher->deleteLater();
+  --packing_;
+  EditorWidget* editor = tab.Editor;
+  int index = editor ? editors_.indexOf(editor) : -1;
+  if (index == -1 || index == getCurrentIndex() || editor->isLoading()
+      || editor->document()->isModified() || editor->document()->revision() != tab.Revision) {
+    // Closed, looked at, or changed while it was being packed.
+    return;
+  }
+  // The document, its layout, undo history, and highlighting all go with the old editor.  What is
+  // left is an empty one that reads the packed text back in when the tab is next looked at, and the
+  // symbols it added to the predictions (for taking them out again if it is closed first).
+  EditorWidget* sleeper = createEditor(editor->parentWidget());
+  sleeper->loadLater(tab.File);
+  sleeper->setView(editor->view());
+  editor->parentWidget()->layout()->replaceWidget(editor, sleeper);
+  editors_[index] = sleeper;
+  hibernated_.insert(sleeper, tab.Symbols);
+  editor->hide();
+  editor->deleteLater();
 }
 
@@ -19,20 +19,93 @@
 #include <QMainWindow>
 #include <QStack>
 #include <QListWidget>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QTimer>
 #include "Server.h"
 #include "EditorWidget.h"
+#include "FileSaver.h"
+#include "FindBar.h"
+#include "IncludeGraph.h"
+#include "NativeScanner.h"
+#include "ReferenceIndex.h"
+#include "SymbolIndex.h"
+#include "TrigramIndex.h"
 
 namespace Ui {
   class MainWindow;
 }
 
+class FileViewer;
+class NativesModel;
+class QProgressBar;
+
+// A tab being put to sleep.
+struct hibernation_s {
+  QPointer<EditorWidget> Editor;
+  int Revision;
+  packed_file_s File;
+  QHash<QString, int> Symbols;
+};
+
+// An open file changed on disk, and how to bring its tab up to date.
+struct reload_s {
+  QPointer<EditorWidget> Editor;
+  int Revision;
+  QString Path;
+  QString Buffer;
+  file_encoding_e Encoding;
+  bool Bom;
+  QStringList Lines;
+  QVector<diff_hunk_s> Hunks;
+  QString Error;
+  // What the file gave the predictions, and what it will.
+  QHash<QString, int> Before;
+  QHash<QString, int> After;
+};
+
 class MainWindow: public QMainWindow {
  Q_OBJECT
 
  public:
+  struct suggestions_s {
+    QString const* Name;
+    int Rank;
+
+    bool operator<(suggestions_s const& right) const {
+      if (Rank == right.Rank) {
+        // Sort alphabetically.
+        return Name->compare(*right.Name) < 0;
+      } else {
+        // Sort by inverse rank (lowest, potentially negative, first).
+        return Rank < right.Rank;
+      }
+    }
+  };
+
+  struct predictions_s {
+    int Rank;
+    int Count;
+  };
+
   explicit MainWindow(QWidget *parent = 0);
   ~MainWindow() override;
 
+  // The workings of autocomplete, which need nothing from a window (`qawno_bench` measures them).
+  // How many times each symbol is used, for the predictions list.  Blocking, for workers.
+  static QHash<QString, int> countSymbols(QString const text, bool skipFirst);
+  // Every prediction containing the `length` characters of `word` in order, best first.
+  static void findSuggestions(QHash<QString, predictions_s> const& predictions,
+                              QChar const* word, int length, QVector<suggestions_s>& suggestions);
+  // A native's prototype turned in to something that can be typed in as a call.
+  static QString deprototype(QString func);
+
+ public slots:
+  // Opens each of `arguments` (`path`, `path:line` or `path:line:column`), and brings the window to
+  // the front.  Returns how many could be opened.
+  int openFiles(const QStringList &arguments);
+
  protected:
   void closeEvent(QCloseEvent *event) override;
   void dragEnterEvent(QDragEnterEvent *event) override;
@@ -44,11 +117,13 @@ class MainWindow: public QMainWindow {
   void on_actionNewInc_triggered();
   void on_actionNewBlank_triggered();
   void on_actionOpen_triggered();
+  void on_actionOpenReadOnly_triggered();
   void on_actionClose_triggered();
   void on_actionQuit_triggered();
   void on_actionSave_triggered();
   void on_actionSaveAs_triggered();
   void on_actionSaveAll_triggered();
+  void on_actionHistory_triggered();
 
   void on_actionPaste_triggered();
   void on_actionCopy_triggered();
@@ -58,9 +133,15 @@ class MainWindow: public QMainWindow {
 
   void on_actionFind_triggered();
   void on_actionFindNext_triggered();
+  void on_actionFindPrevious_triggered();
+  void on_actionReplace_triggered();
+  void on_actionFindInFiles_triggered();
   void on_actionReplaceNext_triggered();
   void on_actionReplaceAll_triggered();
   void on_actionGoToLine_triggered();
+  void on_actionGoToDefinition_triggered();
+  void on_actionFindReferences_triggered();
+  void on_actionRenameSymbol_triggered();
 
   void on_actionCompile_triggered();
   void on_actionCompileRun_triggered();
@@ -78,6 +159,7 @@ class MainWindow: public QMainWindow {
 
   void on_actionDarkMode_triggered();
   void on_actionMRU_triggered();
+  void on_actionHibernate_triggered();
 
   void on_actionCompiler_triggered();
   void on_actionServer_triggered();
@@ -90,22 +172,54 @@ class MainWindow: public QMainWindow {
 
   void currentChanged(int index);
   void tabCloseRequested(int index);
-  void currentRowChanged(int index);
-  void itemDoubleClicked(QListWidgetItem*);
-  void itemClicked(QListWidgetItem*);
+  void nativeCurrentChanged(const QModelIndex& index);
+  void nativeDoubleClicked(const QModelIndex& index);
+  void nativeClicked(const QModelIndex& index);
 
   void errorClicked();
+  void nativesLoaded();
+  void rescanNatives();
+  void reachableNativesToggled(bool checked);
+  void updateIncludeGraph();
+  void includesResolved(const QString& root, const QSet<QString>& files);
+  void resultActivated(const QString& path, int line, int column);
+  void replaceAllFound();
+  void fileLoadProgress(int percent);
+  void fileLoaded();
+  void loadNextTab();
+  void hibernateTabs();
+  void tabPacked();
+  void filesSaved();
+  void fileChanged(const QString& path);
+  void checkChangedFiles();
+  void fileReloaded();
+  void symbolsCounted();
+  void viewerLineChanged(qint64 line);
+  void viewerFound(bool found);
 
  private:
-  QString deprototype(QString func);
   void hidePopup();
   void startWord();
   void updateTitle();
   void replaceSuggestion();
   void loadNativeList();
-  int tryLoadFile(const QString& fileName);
-  void jumpToLine(const QString& fileName, int line);
-  bool loadFile(const QString& fileName, const char* encoding = "Windows-1251");
+  void watchIncludeDirectories();
+  void updateNativePredictions(native_file_s const& file, bool add);
+  int tryLoadFile(const QString& fileName, bool readOnly = false);
+  void jumpToLine(const QString& fileName, int line, int column = 0);
+  void updateIndexes(const QSet<QString>& files);
+  void updateSearchIndex();
+  // `found` is called once the match is selected, which may be after the search finishes.
+  void findNextFromDialog(std::function<void()> found = nullptr);
+  QString symbolUnderCursor() const;
+  // With `later`, the tab is there but the file isn't read until it is looked at (or there is time).
+  bool loadFile(const QString& fileName, bool later = false);
+  void loadDeferred(EditorWidget* editor);
+  bool loadViewer(const QString& fileName);
+  void recoverFile(const QString& journal);
+  void watchOpenFiles();
+  // Works out what changed in a file on disk.  Blocking, for workers.
+  static reload_s diffFile(reload_s reload);
   bool isNewFile() const;
   bool isFileModified() const;
   void setFileModified(bool isModified);
@@ -113,39 +227,27 @@ class MainWindow: public QMainWindow {
   int getCurrentIndex() const;
   const QString& getCurrentName() const;
   EditorWidget* getCurrentEditor() const;
+  FileViewer* getCurrentViewer() const;
   bool eventFilter(QObject* watched, QEvent* event) override;
   void finishSymbol(QString const& symbol, bool add);
   void parseFile(QString const text, bool add);
+  void addSymbols(QHash<QString, int> const& symbols, bool add);
+  // Takes a tab's text back out of the autocomplete list, before it is closed or replaced.
+  void removeSymbols(EditorWidget* editor);
+  // Packs a tab away and counts its symbols.  Blocking, for workers.
+  static hibernation_s packTab(hibernation_s tab, loaded_file_s const file);
   void scrollByLines(int n);
 
  private:
   Ui::MainWindow *ui_;
+  // One per tab, and null for the tabs that are viewers.
   QVector<EditorWidget*> editors_;
   Server server_;
 
   void createTab(const QString& title, const QString& tooltip);
+  EditorWidget* createEditor(QWidget* tab);
 
  private:
-  struct suggestions_s {
-    QString const* Name;
-    int Rank;
-
-    bool operator<(suggestions_s const& right) const {
-      if (Rank == right.Rank) {
-        // Sort alphabetically.
-        return Name->compare(*right.Name) < 0;
-      } else {
-        // Sort by inverse rank (lowest, potentially negative, first).
-        return Rank < right.Rank;
-      }
-    }
-  };
-
-  struct predictions_s {
-    int Rank;
-    int Count;
-  };
-
   QPalette defaultPalette;
   QPalette darkModePalette;
   QStringList fileNames_;
@@ -156,6 +258,33 @@ class MainWindow: public QMainWindow {
   QHash<QString, predictions_s> predictions_;
   QVector<suggestions_s> suggestions_;
   QListWidget* popup_ = nullptr;
+  QFutureWatcher<QVector<native_file_s>> nativesWatcher_;
+
+  // The natives list as currently shown, in directory order, and what keeps it up to date.
+  QVector<native_file_s> natives_;
+  NativesModel* nativesModel_ = nullptr;
+  QString includeDirectory_;
+  // Everything the natives list is read from, which is also what is watched.
+  QStringList includeDirectories_;
+  QFileSystemWatcher includeWatcher_;
+  QTimer includeTimer_;
+
+  // What the current file pulls in, for only showing natives it can actually use, and where
+  // everything in there is defined and used.
+  IncludeGraph includeGraph_;
+  QTimer graphTimer_;
+  SymbolIndex symbolIndex_;
+  ReferenceIndex referenceIndex_;
+
+  // Which files in the include folder and around the open files could match a Find in Files.
+  TrigramIndex trigramIndex_;
+
+  // Replace All, while the matches are found in the background.
+  QFutureWatcher<find_matches_t> replaceWatcher_;
+  QAtomicInt replaceGeneration_; // Never changes, Replace All isn't cancelled.
+  QPointer<EditorWidget> replaceEditor_;
+  int replaceRevision_ = -1;
+  QString replaceText_;
 
   // Store the currently edited word for faster lookups.
   int wordStart_ = -1; // `-1` when the current text isn't a symbol or number.
@@ -166,10 +295,37 @@ class MainWindow: public QMainWindow {
 
   QColor lastColour_ = QColor(0xFF, 0xFF, 0xFF, 0xAA);
 
+  // Shown while any file is still loading.
+  QProgressBar* loadProgress_ = nullptr;
+  // Reads the tabs a restored session hasn't needed yet, while nothing else is happening.
+  QTimer restoreTimer_;
+
+  // Save All, while the changed files are written in the background.
+  struct saving_s {
+    QPointer<EditorWidget> Editor;
+    int Revision;
+  };
+  QFutureWatcher<saved_file_s> saveWatcher_;
+  QVector<saving_s> saving_;
+
+  // Open files changed by something else, waiting for it to finish changing them.
+  QFileSystemWatcher fileWatcher_;
+  QTimer fileTimer_;
+  QSet<QString> changedFiles_;
+
+  // Puts tabs that haven't been looked at for a while (or the oldest, when there is too much open)
+  // to sleep, and what each sleeping tab added to the predictions.
+  QTimer hibernateTimer_;
+  int packing_ = 0;
+  QHash<EditorWidget*, QHash<QString, int>> hibernated_;
+  // Files whose symbols are still being counted after loading, by the watcher counting them.
+  QHash<QObject*, QPointer<EditorWidget>> counting_;
+  // While tabs are being rewritten from outside (a reload, a rename), whose changes to the
+  // predictions are worked out all in one go rather than a word at a time.
+  bool rewriting_ = false;
+
   // Other data.
   QStack<int> mru_;
-  int findStart_ = 0;
-  int findRound_ = 0;
   int mruIndex_ = 0;
   int markedIndex_ = -1;
   int newCount_ = 0;
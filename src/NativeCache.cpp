@@ -0,0 +1,92 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "NativeCache.h"
+
+static const quint32 Magic = 0x514E4154; // `QNAT`.
+static const quint32 Version = 1;
+
+QDataStream &operator<<(QDataStream &out, const native_entry_s &native) {
+  return out << native.Name << native.Prototype << native.Heading;
+}
+
+QDataStream &operator>>(QDataStream &in, native_entry_s &native) {
+  return in >> native.Name >> native.Prototype >> native.Heading;
+}
+
+QDataStream &operator<<(QDataStream &out, const native_file_s &file) {
+  return out << file.Path << file.FileName << file.Modified << file.Size << file.Hash << file.Natives;
+}
+
+QDataStream &operator>>(QDataStream &in, native_file_s &file) {
+  return in >> file.Path >> file.FileName >> file.Modified >> file.Size >> file.Hash >> file.Natives;
+}
+
+QString NativeCache::pathFor(const QString &directory) {
+  QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  QByteArray key = QCryptographicHash::hash(QDir(directory).absolutePath().toUtf8(),
+                                            QCryptographicHash::Md5).toHex();
+  return QString("%1/natives-%2.bin").arg(dir, QString::fromLatin1(key));
+}
+
+QHash<QString, native_file_s> NativeCache::load(const QString &cachePath) {
+  QHash<QString, native_file_s> files;
+  QFile f{cachePath};
+  if (!f.open(QFile::ReadOnly) || f.size() == 0) {
+    return files;
+  }
+  uchar* mapped = f.map(0, f.size());
+  if (!mapped) {
+    return files;
+  }
+  // Everything is deep-copied out of the mapping, so it can go as soon as this returns.
+  QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<int>(f.size()));
+  QDataStream in(raw);
+  in.setVersion(QDataStream::Qt_5_0);
+  quint32 magic = 0, version = 0;
+  in >> magic >> version;
+  if (magic == Magic && version == Version) {
+    QVector<native_file_s> list;
+    in >> list;
+    if (in.status() == QDataStream::Ok) {
+      for (auto const & file : list) {
+        files.insert(file.Path, file);
+      }
+    }
+  }
+  f.unmap(mapped);
+  return files;
+}
+
+bool NativeCache::save(const QString &cachePath, const QVector<native_file_s> &files) {
+  QDir().mkpath(QFileInfo(cachePath).absolutePath());
+  // Write to a temporary and swap it in, so a crash can't leave half a cache behind.
+  QSaveFile f{cachePath};
+  if (!f.open(QFile::WriteOnly)) {
+    return false;
+  }
+  QDataStream out(&f);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << Magic << Version << files;
+  return f.commit();
+}
@@ -0,0 +1,38 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NATIVECACHE_H
+#define NATIVECACHE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "NativeScanner.h"
+
+// The parsed natives of one include directory, saved between runs so that unchanged includes are
+// never read again.  Bump `Version` in the source whenever `native_file_s` changes shape.
+class NativeCache {
+ public:
+  // Where the cache for `directory` lives.  Every include directory gets its own file.
+  static QString pathFor(const QString &directory);
+
+  // Reads the whole cache through a single mapping.  Returns nothing for a missing, old, or
+  // corrupt file, which just means everything gets parsed again.
+  static QHash<QString, native_file_s> load(const QString &cachePath);
+  static bool save(const QString &cachePath, const QVector<native_file_s> &files);
+};
+
+#endif // NATIVECACHE_H
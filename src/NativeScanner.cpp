@@ -0,0 +1,199 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent>
+
+#include <string.h>
+
+#include "NativeCache.h"
+#include "NativeScanner.h"
+
+QStringList NativeScanner::includeFiles(const QString &directory) {
+  QStringList paths;
+  // Loop through all `includes/*.inc` files (ensure they aren't directories).
+  QDir includes(directory, "*.inc", QDir::IgnoreCase, QDir::Files | QDir::Readable);
+  for (auto const & fileName : includes.entryInfoList()) {
+    paths.push_back(fileName.absoluteFilePath());
+  }
+  return paths;
+}
+
+native_file_s NativeScanner::scanFile(const QString &path) {
+  native_file_s previous {};
+  previous.Path = path;
+  return rescanFile(previous);
+}
+
+native_file_s NativeScanner::rescanFile(const native_file_s &previous) {
+  QFileInfo info(previous.Path);
+  native_file_s result {};
+  result.Path = previous.Path;
+  result.FileName = info.fileName();
+  result.Modified = info.lastModified().toMSecsSinceEpoch();
+  result.Size = info.size();
+  QFile f{previous.Path};
+  if (!f.open(QFile::ReadOnly) || result.Size == 0) {
+    return result;
+  }
+  // Map the whole file instead of going through `readLine()`; most includes are only read once.
+  QByteArray copy;
+  const char* data = nullptr;
+  uchar* mapped = f.map(0, result.Size);
+  if (mapped) {
+    data = reinterpret_cast<const char*>(mapped);
+  } else {
+    copy = f.readAll();
+    data = copy.constData();
+    result.Size = copy.size();
+  }
+  QCryptographicHash hash(QCryptographicHash::Md5);
+  hash.addData(data, static_cast<int>(result.Size));
+  result.Hash = hash.result();
+  if (result.Hash == previous.Hash) {
+    // Touched, but not changed.
+    result.Natives = previous.Natives;
+  } else {
+    parse(data, result.Size, result.Natives);
+  }
+  if (mapped) {
+    f.unmap(mapped);
+  }
+  return result;
+}
+
+QVector<native_file_s> NativeScanner::scanFiles(const QStringList &paths) {
+  // Results come back in the same order as `paths`, so the list doesn't shuffle between runs.
+  return QtConcurrent::blockingMapped<QVector<native_file_s>>(paths, &NativeScanner::scanFile);
+}
+
+QVector<native_file_s> NativeScanner::scanDirectory(const QString &directory, const QString &cachePath) {
+  QHash<QString, native_file_s> cached = NativeCache::load(cachePath);
+  QStringList paths = includeFiles(directory);
+  QVector<native_file_s> results(paths.size());
+  // Only files whose size or modification time moved are opened at all.
+  QVector<native_file_s> stale;
+  QVector<int> staleIndexes;
+  for (int i = 0; i != paths.size(); ++i) {
+    QFileInfo info(paths[i]);
+    auto it = cached.constFind(paths[i]);
+    if (it != cached.constEnd() && it->Size == info.size()
+        && it->Modified == info.lastModified().toMSecsSinceEpoch()) {
+      results[i] = *it;
+    } else {
+      native_file_s previous = it == cached.constEnd() ? native_file_s {} : *it;
+      previous.Path = paths[i];
+      stale.push_back(previous);
+      staleIndexes.push_back(i);
+    }
+  }
+  if (!stale.isEmpty()) {
+    QVector<native_file_s> fresh =
+      QtConcurrent::blockingMapped<QVector<native_file_s>>(stale, &NativeScanner::rescanFile);
+    for (int i = 0; i != fresh.size(); ++i) {
+      results[staleIndexes[i]] = fresh[i];
+    }
+  }
+  if (!stale.isEmpty() || cached.size() != paths.size()) {
+    NativeCache::save(cachePath, results);
+  }
+  return results;
+}
+
+static void parseLine(const char *data, int len, QVector<native_entry_s> &natives) {
+  // Skip leading whitespace.
+  int idx = 0;
+  while (idx < len && (unsigned char)data[idx] <= ' ') {
+    ++idx;
+  }
+  if (len - idx < 7 || strncmp(data + idx, "native ", 7) != 0) {
+    return;
+  }
+  idx += 7;
+
+  // Work forwards to the start of text.
+  while (idx < len && (unsigned char)data[idx] <= ' ') {
+    ++idx;
+  }
+  if (idx == len) {
+    return;
+  }
+
+  // Work back to the end of the parameters (skips `= other;` too).
+  do {
+    --len;
+    if (len <= idx) {
+      return;
+    }
+  } while (data[len] != ')');
+
+  // Extract the full name, return, and parameters.
+  QString withArgs = QString::fromUtf8(data + idx, len - idx + 1);
+
+  // Extract just the name.
+  int end = idx;
+  for ( ; ; ) {
+    if (end == len) {
+      // Closing bracket with no opening bracket.
+      return;
+    }
+    if (data[end] == ':') {
+      // Skip the return tag.
+      idx = end + 1;
+    }
+    if (data[end] == '(') {
+      // Found the parameters start.
+      break;
+    }
+    ++end;
+  }
+  // Found some function name.
+  while (idx < end && (unsigned char)data[idx] <= ' ') {
+    ++idx;
+  }
+  while (end > idx && (unsigned char)data[end - 1] <= ' ') {
+    --end;
+  }
+  if (idx == end) {
+    return;
+  }
+  if (data[idx] == '#') {
+    // Special syntax:
+    //
+    //   native #Heading();
+    //
+    // Purely for Qawno titles.
+    natives.push_back({ QString::fromUtf8(data + idx + 1, end - idx - 1), QString(), true });
+  } else {
+    natives.push_back({ QString::fromUtf8(data + idx, end - idx), withArgs, false });
+  }
+}
+
+void NativeScanner::parse(const char *data, qint64 size, QVector<native_entry_s> &natives) {
+  // Find every line that starts with `native`.
+  const char* end = data + size;
+  while (data < end) {
+    const char* eol = static_cast<const char*>(memchr(data, '\n', end - data));
+    if (!eol) {
+      eol = end;
+    }
+    parseLine(data, static_cast<int>(eol - data), natives);
+    data = eol + 1;
+  }
+}
@@ -0,0 +1,61 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NATIVESCANNER_H
+#define NATIVESCANNER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Plain data only, so these can be built on worker threads and handed to the GUI in one go.
+struct native_entry_s {
+  QString Name;
+  QString Prototype; // `Float:floatsqroot(Float:value)`, without `native` or `;`.
+  bool Heading;      // `native #Heading();`, purely for Qawno titles.
+};
+
+struct native_file_s {
+  QString Path;
+  QString FileName;
+  QVector<native_entry_s> Natives;
+  // What the file looked like when it was parsed, for validating the on-disk cache.
+  qint64 Modified;
+  qint64 Size;
+  QByteArray Hash;
+};
+
+class NativeScanner {
+ public:
+  // All the readable `*.inc` files in one directory, in display order.
+  static QStringList includeFiles(const QString &directory);
+
+  // Map one file and extract every line that starts with `native`.
+  static native_file_s scanFile(const QString &path);
+
+  // Like `scanFile`, but reuses the previous natives when only the timestamp changed.
+  static native_file_s rescanFile(const native_file_s &previous);
+
+  // Scan many files in parallel on the global thread pool.  Blocks, so call it from a worker.
+  static QVector<native_file_s> scanFiles(const QStringList &paths);
+
+  // `includeFiles` followed by `scanFiles`, for running the whole thing off the GUI thread.  Files
+  // whose size and modification time match `cachePath` aren't even opened.
+  static QVector<native_file_s> scanDirectory(const QString &directory, const QString &cachePath);
+
+  static void parse(const char *data, qint64 size, QVector<native_entry_s> &natives);
+};
+
+#endif // NATIVESCANNER_H
@@ -0,0 +1,270 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "IncludeGraph.h"
+#include "NativesModel.h"
+
+NativesModel::NativesModel(QObject *parent)
+  : QAbstractListModel(parent),
+    fileFont_("Sans Serif", 12, QFont::Bold),
+    headFont_("Sans Serif", 12, 2),
+    funcFont_("Sans Serif", 12, 2)
+{
+  // The view uses uniform row heights, so titles stand out by weight rather than size.
+  headFont_.setItalic(true);
+}
+
+NativesModel::~NativesModel() {
+  // nothing
+}
+
+int NativesModel::rowCount(const QModelIndex &parent) const {
+  if (parent.isValid()) {
+    return 0;
+  }
+  return filtered_ ? visible_.size() : rows_.size();
+}
+
+int NativesModel::sourceRow(int row) const {
+  return filtered_ ? visible_[row] : row;
+}
+
+QVariant NativesModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || index.row() >= rowCount()) {
+    return QVariant();
+  }
+  native_row_s const& row = rows_[sourceRow(index.row())];
+  native_file_s const& file = files_[row.File];
+  if (row.Native == -1) {
+    switch (role) {
+    case Qt::DisplayRole:
+      return file.FileName;
+    case Qt::FontRole:
+      return fileFont_;
+    case Qt::TextAlignmentRole:
+      return int(Qt::AlignCenter);
+    }
+    return QVariant();
+  }
+  native_entry_s const& native = file.Natives[row.Native];
+  if (native.Heading) {
+    switch (role) {
+    case Qt::DisplayRole:
+      return native.Name;
+    case Qt::FontRole:
+      return headFont_;
+    case Qt::TextAlignmentRole:
+      return int(Qt::AlignCenter);
+    }
+    return QVariant();
+  }
+  switch (role) {
+  case Qt::DisplayRole:
+    return native.Name;
+  case Qt::FontRole:
+    return funcFont_;
+  case Qt::ToolTipRole:
+    return "native " + native.Prototype + ";";
+  case Qt::StatusTipRole:
+    return native.Prototype;
+  }
+  return QVariant();
+}
+
+Qt::ItemFlags NativesModel::flags(const QModelIndex &index) const {
+  if (!index.isValid() || index.row() >= rowCount()) {
+    return Qt::NoItemFlags;
+  }
+  native_row_s const& row = rows_[sourceRow(index.row())];
+  if (row.Native == -1 || files_[row.File].Natives[row.Native].Heading) {
+    // Titles aren't real symbols.
+    return Qt::NoItemFlags;
+  }
+  return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
+
+int NativesModel::firstRow(int file) const {
+  // Rows are always ordered by file.
+  auto it = std::lower_bound(rows_.constBegin(), rows_.constEnd(), file,
+                             [](native_row_s const& row, int file) { return row.File < file; });
+  return static_cast<int>(it - rows_.constBegin());
+}
+
+void NativesModel::insertFile(int position, const native_file_s &file) {
+  position = qBound(0, position, files_.size());
+  int first = firstRow(position);
+  // Files without any natives aren't shown at all.
+  int count = file.Natives.isEmpty() ? 0 : file.Natives.size() + 1;
+  if (count == 0) {
+    files_.insert(position, file);
+    for (int i = first; i != rows_.size(); ++i) {
+      ++rows_[i].File;
+    }
+    return;
+  }
+  if (filtered_) {
+    beginResetModel();
+  } else {
+    beginInsertRows(QModelIndex(), first, first + count - 1);
+  }
+  files_.insert(position, file);
+  for (int i = first; i != rows_.size(); ++i) {
+    ++rows_[i].File;
+  }
+  QVector<native_row_s> rows;
+  rows.reserve(count);
+  rows.push_back({ position, -1, QString() });
+  for (int i = 0; i != file.Natives.size(); ++i) {
+    native_entry_s const& native = file.Natives[i];
+    rows.push_back({ position, i, native.Heading ? QString() : native.Name.toLower() });
+  }
+  rows_.insert(first, count, native_row_s {});
+  std::copy(rows.constBegin(), rows.constEnd(), rows_.begin() + first);
+  if (filtered_) {
+    applyFilter(false);
+    endResetModel();
+  } else {
+    endInsertRows();
+  }
+}
+
+void NativesModel::removeFile(const QString &path) {
+  int position = -1;
+  for (int i = 0; i != files_.size(); ++i) {
+    if (files_[i].Path == path) {
+      position = i;
+      break;
+    }
+  }
+  if (position == -1) {
+    return;
+  }
+  int first = firstRow(position);
+  int count = firstRow(position + 1) - first;
+  if (count == 0) {
+    files_.remove(position);
+    for (int i = first; i != rows_.size(); ++i) {
+      --rows_[i].File;
+    }
+    return;
+  }
+  if (filtered_) {
+    beginResetModel();
+  } else {
+    beginRemoveRows(QModelIndex(), first, first + count - 1);
+  }
+  rows_.remove(first, count);
+  files_.remove(position);
+  for (int i = first; i != rows_.size(); ++i) {
+    --rows_[i].File;
+  }
+  if (filtered_) {
+    applyFilter(false);
+    endResetModel();
+  } else {
+    endRemoveRows();
+  }
+}
+
+void NativesModel::setFilter(const QString &filter) {
+  QString lower = filter.trimmed().toLower();
+  if (lower == filter_) {
+    return;
+  }
+  // Typing more only ever removes rows, so there is no need to look at anything already hidden.
+  bool narrow = filtered_ && lower.startsWith(filter_);
+  filter_ = lower;
+  beginResetModel();
+  filtered_ = !filter_.isEmpty() || restricted_;
+  if (filtered_) {
+    applyFilter(narrow);
+  } else {
+    visible_.clear();
+  }
+  endResetModel();
+}
+
+void NativesModel::restrictFiles(const QSet<QString> &files) {
+  if (restricted_ && files == allowed_) {
+    return;
+  }
+  beginResetModel();
+  restricted_ = true;
+  allowed_ = files;
+  filtered_ = true;
+  applyFilter(false);
+  endResetModel();
+}
+
+void NativesModel::clearRestriction() {
+  if (!restricted_) {
+    return;
+  }
+  beginResetModel();
+  restricted_ = false;
+  allowed_.clear();
+  filtered_ = !filter_.isEmpty();
+  if (filtered_) {
+    applyFilter(false);
+  } else {
+    visible_.clear();
+  }
+  endResetModel();
+}
+
+void NativesModel::applyFilter(bool narrow) {
+  QVector<int> source;
+  if (narrow) {
+    source.swap(visible_);
+  } else {
+    source.reserve(rows_.size());
+    for (int i = 0; i != rows_.size(); ++i) {
+      source.push_back(i);
+    }
+  }
+  visible_.clear();
+  QVector<bool> allowed(files_.size(), true);
+  if (restricted_) {
+    for (int i = 0; i != files_.size(); ++i) {
+      allowed[i] = allowed_.contains(IncludeGraph::normalise(files_[i].Path));
+    }
+  }
+  // Titles are only shown when something beneath them matches.
+  int pendingFile = -1;
+  int pendingHeading = -1;
+  for (int i : source) {
+    native_row_s const& row = rows_[i];
+    if (!allowed[row.File]) {
+      continue;
+    } else if (row.Native == -1) {
+      pendingFile = i;
+      pendingHeading = -1;
+    } else if (row.Lower.isEmpty()) {
+      pendingHeading = i;
+    } else if (row.Lower.contains(filter_)) {
+      if (pendingFile != -1) {
+        visible_.push_back(pendingFile);
+        pendingFile = -1;
+      }
+      if (pendingHeading != -1) {
+        visible_.push_back(pendingHeading);
+        pendingHeading = -1;
+      }
+      visible_.push_back(i);
+    }
+  }
+}
@@ -0,0 +1,78 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NATIVESMODEL_H
+#define NATIVESMODEL_H
+
+#include <QAbstractListModel>
+#include <QFont>
+#include <QSet>
+#include <QVector>
+
+#include "NativeScanner.h"
+
+// The natives side bar.  Every include contributes a title row followed by its headings and
+// natives, and the whole thing can be narrowed down by typing part of a name.
+class NativesModel: public QAbstractListModel {
+ Q_OBJECT
+
+ public:
+  explicit NativesModel(QObject *parent = 0);
+  ~NativesModel() override;
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+  // `position` is the index amongst the files, including those without any natives.
+  void insertFile(int position, const native_file_s &file);
+  void removeFile(const QString &path);
+
+  // Only show natives from these includes (normalised as by `IncludeGraph`).
+  void restrictFiles(const QSet<QString> &files);
+  void clearRestriction();
+
+ public slots:
+  void setFilter(const QString &filter);
+
+ private:
+  struct native_row_s {
+    int File;
+    int Native;    // `-1` for the file title.
+    QString Lower; // Precomputed for filtering, empty for titles and headings.
+  };
+
+  int firstRow(int file) const;
+  int sourceRow(int row) const;
+  void applyFilter(bool narrow);
+
+  QVector<native_file_s> files_;
+  QVector<native_row_s> rows_;
+
+  // Indexes in to `rows_` that match the current filter.  Unused while there is no filter and no
+  // restriction.
+  bool filtered_ = false;
+  QString filter_;
+  QVector<int> visible_;
+  bool restricted_ = false;
+  QSet<QString> allowed_;
+
+  // One of each, rather than a font per row.
+  QFont fileFont_;
+  QFont headFont_;
+  QFont funcFont_;
+};
+
+#endif // NATIVESMODEL_H
@@ -0,0 +1,176 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include "PawnLexer.h"
+
+PawnLexer::PawnLexer(const QString &text, bool comment)
+  : text_(text),
+    data_(text.constData()),
+    length_(text.length()),
+    comment_(comment)
+{
+}
+
+void PawnLexer::advance() {
+  if (data_[pos_] == '\n') {
+    ++line_;
+    lineStart_ = pos_ + 1;
+    atLineStart_ = true;
+  }
+  ++pos_;
+}
+
+void PawnLexer::skipLine() {
+  while (pos_ < length_ && data_[pos_] != '\n') {
+    ++pos_;
+  }
+}
+
+void PawnLexer::skipComment() {
+  // Up to and including the closing `*/`, if there is one.
+  while (pos_ < length_) {
+    if (data_[pos_] == '*' && pos_ + 1 < length_ && data_[pos_ + 1] == '/') {
+      pos_ += 2;
+      comment_ = false;
+      return;
+    }
+    advance();
+  }
+  comment_ = true;
+}
+
+bool PawnLexer::next(pawn_token_s &token) {
+  if (comment_) {
+    skipComment();
+  }
+  // Whitespace and comments.
+  for ( ; ; ) {
+    while (pos_ < length_ && data_[pos_].isSpace()) {
+      advance();
+    }
+    if (pos_ + 1 < length_ && data_[pos_] == '/' && data_[pos_ + 1] == '/') {
+      skipLine();
+    } else if (pos_ + 1 < length_ && data_[pos_] == '/' && data_[pos_ + 1] == '*') {
+      pos_ += 2;
+      skipComment();
+    } else {
+      break;
+    }
+  }
+  if (pos_ >= length_) {
+    return false;
+  }
+  token.Start = pos_;
+  token.Line = line_;
+  token.Column = pos_ - lineStart_;
+  token.LineStart = atLineStart_;
+  atLineStart_ = false;
+  QChar ch = data_[pos_];
+  if (isSymbolStart(ch)) {
+    token.Type = pawn_token_identifier;
+    while (pos_ < length_ && isSymbolChar(data_[pos_])) {
+      ++pos_;
+    }
+  } else if (ch >= '0' && ch <= '9') {
+    // `0x1F`, `0b101`, `1_000`, `1.5e3` all in one go.
+    token.Type = pawn_token_number;
+    while (pos_ < length_ && (isSymbolChar(data_[pos_]) || data_[pos_] == '.')) {
+      ++pos_;
+    }
+  } else if (ch == '"' || ch == '\'') {
+    // Strings can't span lines, so an unclosed one stops at the end of the line.
+    token.Type = ch == '"' ? pawn_token_string : pawn_token_character;
+    ++pos_;
+    while (pos_ < length_ && data_[pos_] != ch && data_[pos_] != '\n') {
+      if (data_[pos_] == '\\' && pos_ + 1 < length_ && data_[pos_ + 1] != '\n') {
+        ++pos_;
+      }
+      ++pos_;
+    }
+    if (pos_ < length_ && data_[pos_] == ch) {
+      ++pos_;
+    }
+  } else if (ch == '#') {
+    token.Type = pawn_token_directive;
+    ++pos_;
+    while (pos_ < length_ && (data_[pos_] == ' ' || data_[pos_] == '\t')) {
+      ++pos_;
+    }
+    int word = pos_;
+    while (pos_ < length_ && data_[pos_].isLetter()) {
+      ++pos_;
+    }
+    // The arguments of these are file names and messages, not code.
+    QStringRef directive = text_.midRef(word, pos_ - word);
+    if (directive == QLatin1String("include") || directive == QLatin1String("tryinclude")
+        || directive == QLatin1String("pragma") || directive == QLatin1String("error")
+        || directive == QLatin1String("warning")) {
+      token.Length = pos_ - token.Start;
+      skipLine();
+      return true;
+    }
+  } else {
+    token.Type = pawn_token_punctuation;
+    ++pos_;
+  }
+  token.Length = pos_ - token.Start;
+  return true;
+}
+
+QVector<pawn_token_s> PawnLexer::tokenize(const QString &text) {
+  QVector<pawn_token_s> tokens;
+  // Roughly one token every six characters in typical code.
+  tokens.reserve(text.length() / 6);
+  PawnLexer lexer(text);
+  pawn_token_s token;
+  while (lexer.next(token)) {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+QVector<pawn_token_s> PawnLexer::tokenize(const QString &text, const pawn_token_s &from) {
+  QVector<pawn_token_s> tokens;
+  tokens.reserve((text.length() - from.Start) / 6);
+  PawnLexer lexer(text);
+  lexer.pos_ = from.Start;
+  lexer.line_ = from.Line;
+  lexer.lineStart_ = from.Start - from.Column;
+  lexer.atLineStart_ = from.LineStart;
+  pawn_token_s token;
+  while (lexer.next(token)) {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+int PawnLexer::directiveEnd(const QString &text, int start) {
+  int len = text.length();
+  QChar const* data = text.constData();
+  for (int i = start; i < len; ++i) {
+    if (data[i] == '\n') {
+      // Continued on the next line?
+      int j = i;
+      if (j > start && data[j - 1] == '\r') {
+        --j;
+      }
+      if (j > start && data[j - 1] == '\\') {
+        continue;
+      }
+      return i;
+    }
+  }
+  return len;
+}
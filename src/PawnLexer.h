@@ -0,0 +1,88 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PAWNLEXER_H
+#define PAWNLEXER_H
+
+#include <QString>
+#include <QVector>
+
+enum pawn_token_e {
+  pawn_token_identifier,
+  pawn_token_number,
+  pawn_token_string,
+  pawn_token_character,
+  pawn_token_directive,   // `#define` etc, just the `#` and the word.
+  pawn_token_punctuation, // Always a single character.
+};
+
+struct pawn_token_s {
+  pawn_token_e Type;
+  int Start;
+  int Length;
+  int Line;       // From 0.
+  int Column;     // From 0.
+  bool LineStart; // Nothing but whitespace and comments before it on this line.
+};
+
+// Splits Pawn source in to tokens, skipping whitespace and comments.  Shared by everything that
+// needs to know where symbols are, so they all agree on what is code and what isn't.
+class PawnLexer {
+ public:
+  // `comment` starts the text inside a block comment, for lexing one line at a time.
+  explicit PawnLexer(const QString &text, bool comment = false);
+
+  bool next(pawn_token_s &token);
+
+  // Whether the text so far ended in the middle of a block comment.
+  bool inComment() const {
+    return comment_;
+  }
+
+  // Every token at once.
+  static QVector<pawn_token_s> tokenize(const QString &text);
+
+  // Every token from `from` on, where `from` came from lexing this text (or text that is the same
+  // up to there) from the start.  The lexer picks up exactly where it was when it found `from`.
+  static QVector<pawn_token_s> tokenize(const QString &text, const pawn_token_s &from);
+
+  // The offset just past the end of the directive starting at `start`, following `\` line
+  // continuations.
+  static int directiveEnd(const QString &text, int start);
+
+  static bool isSymbolStart(QChar ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || ch == '@';
+  }
+
+  static bool isSymbolChar(QChar ch) {
+    return isSymbolStart(ch) || (ch >= '0' && ch <= '9');
+  }
+
+ private:
+  void advance();
+  void skipLine();
+  void skipComment();
+
+  const QString &text_;
+  QChar const* data_;
+  int length_;
+  int pos_ = 0;
+  int line_ = 0;
+  int lineStart_ = 0;
+  bool atLineStart_ = true;
+  bool comment_;
+};
+
+#endif // PAWNLEXER_H
@@ -0,0 +1,251 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextCodec>
+#include <QtConcurrent>
+
+#include <string.h>
+
+#include "FileLoader.h"
+#include "PawnLexer.h"
+#include "ReferenceIndex.h"
+
+// Rewrites one file on a worker.  A function object so that the names can come along.
+struct rename_writer_s {
+  typedef result_file_s result_type;
+
+  QString From;
+  QString To;
+
+  result_file_s operator()(const QString &path) const {
+    result_file_s file { path, QVector<result_s>(), QString() };
+    QFile in{path};
+    if (!in.open(QFile::ReadOnly)) {
+      file.Error = in.errorString();
+      return file;
+    }
+    qint64 size = in.size();
+    uchar* data = size ? in.map(0, size) : nullptr;
+    if (!data) {
+      return file;
+    }
+    // The index may be older than the file, so find the uses again rather than trusting it.  Names
+    // are ASCII, so the uses can be found in the bytes as they are, whatever the file is encoded
+    // in, and only the lines shown in the results need decoding.
+    const char* bytes = reinterpret_cast<const char*>(data);
+    bool bom = size >= 3 && memcmp(bytes, "\xEF\xBB\xBF", 3) == 0;
+    file_encoding_e encoding = bom ? file_encoding_utf8 : FileLoader::detect(bytes, size);
+    QTextCodec* codec = QTextCodec::codecForName(FileLoader::codecName(encoding));
+    QString text = QString::fromLatin1(bytes, static_cast<int>(size));
+    QVector<int> starts;
+    PawnLexer lexer(text);
+    pawn_token_s token;
+    QVector<pawn_token_s> uses;
+    while (lexer.next(token)) {
+      if (token.Type == pawn_token_identifier && token.Length == From.length()
+          && text.midRef(token.Start, token.Length) == From) {
+        starts.push_back(token.Start);
+        uses.push_back(token);
+      }
+    }
+    // One result for every use, each showing its line with all of the uses on it renamed, and
+    // with columns (in characters, as the editor counts them) moved along by the ones before it.
+    for (int i = 0, n = uses.size(); i != n; ) {
+      int lineStart = uses[i].Start - uses[i].Column;
+      if (lineStart == 0 && bom) {
+        lineStart = 3;
+      }
+      int lineEnd = text.indexOf('\n', uses[i].Start);
+      QByteArray line = text.mid(lineStart, (lineEnd == -1 ? text.length() : lineEnd) - lineStart).toLatin1();
+      if (line.endsWith('\r')) {
+        line.chop(1);
+      }
+      int end = i;
+      while (end != n && uses[end].Line == uses[i].Line) {
+        ++end;
+      }
+      QByteArray to = To.toLatin1();
+      for (int j = end; j-- != i; ) {
+        line.replace(uses[j].Start - lineStart, uses[j].Length, to);
+      }
+      QString decoded = codec->toUnicode(line);
+      for (int j = i; j != end; ++j) {
+        int offset = uses[j].Start - lineStart + (j - i) * (To.length() - From.length());
+        int column = codec->toUnicode(line.constData(), offset).length();
+        file.Results.push_back({ uses[j].Line, column, To.length(), decoded });
+      }
+      i = end;
+    }
+    if (starts.isEmpty()) {
+      in.unmap(data);
+      return file;
+    }
+    // Names are ASCII, so everything between them can be copied across byte for byte.
+    QSaveFile out{path};
+    if (!out.open(QFile::WriteOnly)) {
+      in.unmap(data);
+      file.Error = out.errorString();
+      file.Results.clear();
+      return file;
+    }
+    QByteArray to = To.toLatin1();
+    qint64 last = 0;
+    for (int start : starts) {
+      out.write(bytes + last, start - last);
+      out.write(to);
+      last = start + From.length();
+    }
+    out.write(bytes + last, size - last);
+    // Windows won't replace a file that is still mapped.
+    in.unmap(data);
+    in.close();
+    if (!out.commit()) {
+      file.Error = out.errorString();
+      file.Results.clear();
+    }
+    return file;
+  }
+};
+
+ReferenceIndex::ReferenceIndex(QObject *parent)
+  : QObject(parent)
+{
+  connect(&future_, SIGNAL(finished()), SLOT(finished()));
+}
+
+ReferenceIndex::~ReferenceIndex() {
+  // nothing
+}
+
+reference_file_s ReferenceIndex::parseFile(const QString &path) {
+  QFileInfo info(path);
+  reference_file_s file { path, info.lastModified().toMSecsSinceEpoch(), info.size(), {} };
+  if (file.Size == 0) {
+    return file;
+  }
+  // Decoded as the editor would, so columns count the same characters.
+  loaded_file_s loaded = FileLoader::read(path);
+  if (!loaded.Error.isEmpty()) {
+    return file;
+  }
+  QString const& text = loaded.Text;
+  PawnLexer lexer(text);
+  pawn_token_s token;
+  while (lexer.next(token)) {
+    if (token.Type == pawn_token_identifier) {
+      file.Names[text.mid(token.Start, token.Length)].push_back({ token.Line, token.Column });
+    }
+  }
+  return file;
+}
+
+QHash<QString, reference_file_s> ReferenceIndex::build(const QStringList &files, const QStringList &keep,
+                                                       const QHash<QString, reference_file_s> &known) {
+  QHash<QString, reference_file_s> result;
+  // Not checked against the disk until they are asked for again.
+  for (auto const & path : keep) {
+    auto it = known.constFind(path);
+    if (it != known.constEnd()) {
+      result.insert(path, *it);
+    }
+  }
+  QStringList stale;
+  for (auto const & path : files) {
+    auto it = known.constFind(path);
+    QFileInfo info(path);
+    if (it == known.constEnd() || it->Size != info.size()
+        || it->Modified != info.lastModified().toMSecsSinceEpoch()) {
+      stale.push_back(path);
+    } else {
+      result.insert(path, *it);
+    }
+  }
+  if (!stale.isEmpty()) {
+    QVector<reference_file_s> parsed =
+      QtConcurrent::blockingMapped<QVector<reference_file_s>>(stale, &ReferenceIndex::parseFile);
+    for (auto const & file : parsed) {
+      result.insert(file.Path, file);
+    }
+  }
+  return result;
+}
+
+result_file_s ReferenceIndex::collect(const reference_job_s &job) {
+  result_file_s file { job.Path, QVector<result_s>() };
+  loaded_file_s loaded = FileLoader::read(job.Path);
+  if (!loaded.Error.isEmpty()) {
+    return file;
+  }
+  QString const& text = loaded.Text;
+  // References are in file order, so this is one pass over the file however many there are.
+  int line = 0;
+  int number = 0;
+  for (auto const & reference : job.References) {
+    while (number < reference.Line && line < text.length()) {
+      int next = text.indexOf('\n', line);
+      line = next == -1 ? text.length() : next + 1;
+      ++number;
+    }
+    int eol = text.indexOf('\n', line);
+    QString content = text.mid(line, (eol == -1 ? text.length() : eol) - line);
+    if (content.endsWith('\r')) {
+      content.chop(1);
+    }
+    file.Results.push_back({ reference.Line, reference.Column, job.Length, content });
+  }
+  return file;
+}
+
+QFuture<result_file_s> ReferenceIndex::rename(const QStringList &paths, const QString &from, const QString &to) {
+  return QtConcurrent::mapped(paths, rename_writer_s { from, to });
+}
+
+void ReferenceIndex::update(const QStringList &files, const QStringList &keep) {
+  request_ = files;
+  keep_ = keep;
+  if (future_.isRunning()) {
+    pending_ = true;
+    return;
+  }
+  building_ = request_.toSet();
+  future_.setFuture(QtConcurrent::run(&ReferenceIndex::build, request_, keep_, files_));
+}
+
+QVector<reference_job_s> ReferenceIndex::find(const QString &name) const {
+  QVector<reference_job_s> jobs;
+  for (auto it = files_.constBegin(); it != files_.constEnd(); ++it) {
+    if (!scope_.contains(it.key())) {
+      continue;
+    }
+    auto found = it->Names.constFind(name);
+    if (found != it->Names.constEnd()) {
+      jobs.push_back({ it.key(), name.length(), *found });
+    }
+  }
+  return jobs;
+}
+
+void ReferenceIndex::finished() {
+  files_ = future_.result();
+  scope_ = building_;
+  if (pending_) {
+    pending_ = false;
+    update(request_, keep_);
+  }
+}
@@ -0,0 +1,94 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef REFERENCEINDEX_H
+#define REFERENCEINDEX_H
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+#include "ResultsWidget.h"
+
+struct reference_s {
+  int Line;
+  int Column;
+};
+
+// Where every identifier in one file is used.
+struct reference_file_s {
+  QString Path;
+  qint64 Modified;
+  qint64 Size;
+  QHash<QString, QVector<reference_s>> Names;
+};
+
+// The uses of one name in one file, to be turned in to results.
+struct reference_job_s {
+  QString Path;
+  int Length;
+  QVector<reference_s> References;
+};
+
+// An inverted index of every identifier in the included files that aren't open in the editor (open
+// files have their own `BufferReferences`).  Built in parallel, and only changed files are read
+// again.
+class ReferenceIndex: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit ReferenceIndex(QObject *parent = 0);
+  ~ReferenceIndex() override;
+
+  static reference_file_s parseFile(const QString &path);
+
+  // Blocking, for workers.  Returns the index for `files`, plus whatever of `known` is in `keep`.
+  static QHash<QString, reference_file_s> build(const QStringList &files, const QStringList &keep,
+                                                const QHash<QString, reference_file_s> &known);
+
+  // Reads the lines `job` points at, for showing with the results.  Blocking, for workers.
+  static result_file_s collect(const reference_job_s &job);
+
+  // Renames every use of `from` to `to` in each of `paths`, in the background.  Each file is
+  // streamed straight from a mapping of the old one to a replacement, without ever being decoded or
+  // loaded in to an editor.  Every result is one renamed use.
+  static QFuture<result_file_s> rename(const QStringList &paths, const QString &from, const QString &to);
+
+  // Start indexing `files` in the background.  `keep` are other files that have been indexed and
+  // are worth holding on to, but not searched, such as what the other tabs include.  Requests made
+  // while one is running replace any earlier pending request.
+  void update(const QStringList &files, const QStringList &keep);
+
+  // Every use of `name` in the files last asked for, one job per file.
+  QVector<reference_job_s> find(const QString &name) const;
+
+ private slots:
+  void finished();
+
+ private:
+  QHash<QString, reference_file_s> files_;
+  // What `files_` was built for, which is all `find` looks through.
+  QSet<QString> scope_;
+  QSet<QString> building_;
+  QFutureWatcher<QHash<QString, reference_file_s>> future_;
+  bool pending_ = false;
+  QStringList request_;
+  QStringList keep_;
+};
+
+#endif // REFERENCEINDEX_H
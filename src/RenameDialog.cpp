@@ -0,0 +1,73 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDir>
+#include <QPushButton>
+
+#include "RenameDialog.h"
+#include "ui_RenameDialog.h"
+
+RenameDialog::RenameDialog(const QString &from, const QString &to,
+                           const QVector<rename_file_s> &files, QWidget *parent)
+  : QDialog(parent),
+    ui_(new Ui::RenameDialog),
+    files_(files)
+{
+  ui_->setupUi(this);
+  ui_->label->setText(tr("Rename \"%1\" to \"%2\" in these files?  Open files can be undone from "
+                         "their editors, the rest are saved straight away.").arg(from, to));
+  ui_->buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Rename"));
+  for (auto const & file : files_) {
+    QTreeWidgetItem* item = new QTreeWidgetItem(ui_->files);
+    item->setText(0, file.Path.isEmpty() ? tr("Untitled File") : QDir::toNativeSeparators(file.Path));
+    item->setText(1, QString::number(file.Uses));
+    if (file.Open) {
+      item->setText(2, tr("Open"));
+    } else if (file.Library) {
+      item->setText(2, tr("Library include"));
+    } else {
+      item->setText(2, tr("Saved straight away"));
+    }
+    item->setCheckState(0, file.Library ? Qt::Unchecked : Qt::Checked);
+  }
+  ui_->files->resizeColumnToContents(0);
+  connect(ui_->files, SIGNAL(itemChanged(QTreeWidgetItem*, int)), SLOT(updateCount()));
+  updateCount();
+}
+
+RenameDialog::~RenameDialog() {
+  delete ui_;
+}
+
+QVector<bool> RenameDialog::checked() const {
+  QVector<bool> checked;
+  for (int i = 0; i != ui_->files->topLevelItemCount(); ++i) {
+    checked.push_back(ui_->files->topLevelItem(i)->checkState(0) == Qt::Checked);
+  }
+  return checked;
+}
+
+void RenameDialog::updateCount() {
+  int uses = 0, count = 0;
+  QVector<bool> selected = checked();
+  for (int i = 0; i != selected.size(); ++i) {
+    if (selected[i]) {
+      uses += files_[i].Uses;
+      ++count;
+    }
+  }
+  ui_->count->setText(tr("%1 uses in %2 of %3 files.").arg(uses).arg(count).arg(files_.size()));
+  ui_->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(count != 0);
+}
@@ -0,0 +1,55 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RENAMEDIALOG_H
+#define RENAMEDIALOG_H
+
+#include <QDialog>
+#include <QVector>
+
+namespace Ui {
+  class RenameDialog;
+}
+
+// One file a rename would change.
+struct rename_file_s {
+  QString Path; // Empty for the current unsaved file.
+  int Uses;
+  bool Open;    // Changed in its editor, so it can be undone.
+  bool Library; // In an include directory rather than next to the script, such as the SDK.
+};
+
+// Every file a rename would change, each with a box to leave it out.  Library includes start out
+// unchecked, since they are shared by every script and usually aren't the user's to rename in.
+class RenameDialog: public QDialog {
+ Q_OBJECT
+
+ public:
+  RenameDialog(const QString &from, const QString &to, const QVector<rename_file_s> &files,
+               QWidget *parent = 0);
+  ~RenameDialog() override;
+
+  // Whether each file, in the order given, is still checked.
+  QVector<bool> checked() const;
+
+ private slots:
+  void updateCount();
+
+ private:
+  Ui::RenameDialog *ui_;
+  QVector<rename_file_s> files_;
+};
+
+#endif // RENAMEDIALOG_H
@@ -0,0 +1,136 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDir>
+#include <QKeyEvent>
+
+#include "ResultsWidget.h"
+
+enum results_role_e {
+  results_role_path = Qt::UserRole,
+  results_role_line,
+  results_role_column,
+};
+
+ResultsWidget::ResultsWidget(QWidget *parent)
+  : QTreeWidget(parent)
+{
+  setColumnCount(1);
+  setUniformRowHeights(true);
+  setRootIsDecorated(true);
+  connect(&watcher_, SIGNAL(resultReadyAt(int)), SLOT(resultReadyAt(int)));
+  connect(&watcher_, SIGNAL(finished()), SLOT(finished()));
+  connect(this, SIGNAL(itemActivated(QTreeWidgetItem*, int)), SLOT(itemActivated(QTreeWidgetItem*, int)));
+}
+
+ResultsWidget::~ResultsWidget() {
+  cancel();
+}
+
+void ResultsWidget::start(const QString &title) {
+  cancel();
+  clear();
+  title_ = title;
+  stopped_ = false;
+  files_ = 0;
+  results_ = 0;
+  updateTitle();
+  show();
+}
+
+void ResultsWidget::addFile(const result_file_s &file) {
+  QString name = file.Path.isEmpty() ? tr("Untitled File") : QDir::toNativeSeparators(file.Path);
+  if (!file.Error.isEmpty()) {
+    QTreeWidgetItem* item = new QTreeWidgetItem(this);
+    item->setText(0, QString("%1 - %2").arg(name, file.Error));
+    item->setData(0, results_role_path, file.Path);
+    item->setData(0, results_role_line, -1);
+    return;
+  }
+  if (file.Results.isEmpty()) {
+    return;
+  }
+  QTreeWidgetItem* parent = new QTreeWidgetItem(this);
+  parent->setText(0, QString("%1 (%2)").arg(name).arg(file.Results.size()));
+  parent->setData(0, results_role_path, file.Path);
+  parent->setData(0, results_role_line, -1);
+  QList<QTreeWidgetItem*> children;
+  children.reserve(file.Results.size());
+  for (auto const & result : file.Results) {
+    QTreeWidgetItem* child = new QTreeWidgetItem();
+    child->setText(0, QString("%1: %2").arg(result.Line + 1).arg(result.Text.trimmed()));
+    child->setData(0, results_role_path, file.Path);
+    child->setData(0, results_role_line, result.Line);
+    child->setData(0, results_role_column, result.Column);
+    children.push_back(child);
+  }
+  // All at once, rather than one layout per line.
+  parent->addChildren(children);
+  parent->setExpanded(true);
+  ++files_;
+  results_ += file.Results.size();
+  updateTitle();
+}
+
+void ResultsWidget::watch(const QFuture<result_file_s> &future) {
+  watcher_.setFuture(future);
+  updateTitle();
+}
+
+void ResultsWidget::cancel() {
+  if (watcher_.isRunning()) {
+    watcher_.cancel();
+    watcher_.waitForFinished();
+  }
+  // Don't let results from the old search arrive in the new one.
+  watcher_.setFuture(QFuture<result_file_s>());
+}
+
+void ResultsWidget::keyPressEvent(QKeyEvent *event) {
+  if (event->key() == Qt::Key_Escape && watcher_.isRunning()) {
+    cancel();
+    stopped_ = true;
+    updateTitle();
+    return;
+  }
+  QTreeWidget::keyPressEvent(event);
+}
+
+void ResultsWidget::resultReadyAt(int index) {
+  addFile(watcher_.resultAt(index));
+}
+
+void ResultsWidget::finished() {
+  updateTitle();
+}
+
+void ResultsWidget::itemActivated(QTreeWidgetItem *item, int column) {
+  Q_UNUSED(column);
+  int line = item->data(0, results_role_line).toInt();
+  if (line != -1) {
+    emit activated(item->data(0, results_role_path).toString(), line,
+                   item->data(0, results_role_column).toInt());
+  }
+}
+
+void ResultsWidget::updateTitle() {
+  QString status = tr("%1 - %2 results in %3 files").arg(title_).arg(results_).arg(files_);
+  if (watcher_.isRunning()) {
+    status += tr(" (searching, Esc to stop)");
+  } else if (stopped_) {
+    status += tr(" (stopped)");
+  }
+  setHeaderLabel(status);
+}
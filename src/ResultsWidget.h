@@ -0,0 +1,74 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RESULTSWIDGET_H
+#define RESULTSWIDGET_H
+
+#include <QFutureWatcher>
+#include <QTreeWidget>
+#include <QVector>
+
+// One match, with the text of the line it is on.
+struct result_s {
+  int Line;   // From 0.
+  int Column; // From 0.
+  int Length;
+  QString Text;
+};
+
+struct result_file_s {
+  QString Path; // Empty for the current unsaved file.
+  QVector<result_s> Results;
+  QString Error; // Why the file couldn't be searched or written, if it couldn't.
+};
+
+// Search results grouped by file.  Results can be added directly, or streamed in from a
+// background search as each file is finished.
+class ResultsWidget: public QTreeWidget {
+ Q_OBJECT
+
+ public:
+  explicit ResultsWidget(QWidget *parent = 0);
+  ~ResultsWidget() override;
+
+  // Clear the list for a new search.  Anything still running for the old one is cancelled.
+  void start(const QString &title);
+  void addFile(const result_file_s &file);
+  // Add every result of `future` as it arrives.
+  void watch(const QFuture<result_file_s> &future);
+  void cancel();
+
+ signals:
+  void activated(const QString &path, int line, int column);
+
+ protected:
+  void keyPressEvent(QKeyEvent *event) override;
+
+ private slots:
+  void resultReadyAt(int index);
+  void finished();
+  void itemActivated(QTreeWidgetItem *item, int column);
+
+ private:
+  void updateTitle();
+
+  QFutureWatcher<result_file_s> watcher_;
+  QString title_;
+  bool stopped_ = false;
+  int files_ = 0;
+  int results_ = 0;
+};
+
+#endif // RESULTSWIDGET_H
@@ -0,0 +1,350 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringMatcher>
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SEARCH_SSE2
+#endif
+
+#include "SearchEngine.h"
+
+// How many compiled patterns to keep.  Typing a search compiles one per key press.
+static const int CacheSize = 64;
+
+static bool isWordChar(QChar ch) {
+  return ch.isLetterOrNumber() || ch == '_' || ch == '@';
+}
+
+// Whether `(?x)`, `(?i)` and so on turn `flag` on anywhere in `pattern`, or with `off`, whether
+// `(?-x)` and so on turn it off.
+static bool hasInlineFlag(const QString &pattern, char flag, bool off = false) {
+  for (int i = pattern.indexOf("(?"); i != -1; i = pattern.indexOf("(?", i + 2)) {
+    bool turning = false;
+    for (int j = i + 2; j < pattern.length() && (pattern[j].isLetter() || pattern[j] == '-'); ++j) {
+      if (pattern[j] == '-') {
+        turning = true;
+        continue;
+      }
+      if (pattern[j] == flag && turning == off) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Whether a match could carry on on to the next line, in which case the pattern can't be tried a
+// line at a time.  Anything that might match a line break counts.
+static bool crossesLines(const QString &pattern) {
+  // Without multi-line, `^` and `$` only match at the ends of the whole text, not of each line.
+  if (hasInlineFlag(pattern, 's') || hasInlineFlag(pattern, 'm', true) || pattern.contains("(*")) {
+    return true;
+  }
+  for (int i = 0, n = pattern.length(); i < n; ++i) {
+    QChar ch = pattern[i];
+    if (ch == '\n' || ch == '\r') {
+      return true;
+    } else if (ch == '[' && i + 1 < n && pattern[i + 1] == '^') {
+      return true;
+    } else if (ch == '\\' && i + 1 < n) {
+      // Including the anchors for the ends of the whole text, which every line would look like.
+      char escape = pattern[++i].toLatin1();
+      if (escape && strchr("nrsvRWDHXCNpPxocQ0123456789AzZG", escape)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// `needle` must be shorter than what is left of `haystack`.  Compares the first and last characters
+// of the needle against eight places at once, and only compares the rest where both of those agree.
+static int indexOfExact(const ushort *haystack, int length, const ushort *needle, int n, int from) {
+  int last = length - n;
+  int i = from;
+#ifdef SEARCH_SSE2
+  const __m128i first = _mm_set1_epi16(static_cast<short>(needle[0]));
+  const __m128i tail = _mm_set1_epi16(static_cast<short>(needle[n - 1]));
+  for ( ; i + 7 <= last; i += 8) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + n - 1));
+    int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(a, first), _mm_cmpeq_epi16(b, tail)));
+    for (int lane = 0; mask; ++lane, mask >>= 2) {
+      if ((mask & 3) && memcmp(haystack + i + lane, needle, n * sizeof (ushort)) == 0) {
+        return i + lane;
+      }
+    }
+  }
+#endif
+  for ( ; i <= last; ++i) {
+    if (haystack[i] == needle[0] && haystack[i + n - 1] == needle[n - 1]
+        && memcmp(haystack + i, needle, n * sizeof (ushort)) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Finds one piece of text over and over, without setting up again each time.
+struct literal_finder_s {
+  QString Needle;
+  Qt::CaseSensitivity Cs;
+  QStringMatcher Matcher;
+
+  literal_finder_s(const QString &needle, Qt::CaseSensitivity cs)
+    : Needle(needle),
+      Cs(cs)
+  {
+    if (cs == Qt::CaseInsensitive) {
+      // Case folding isn't one character to one, so leave it to Qt.
+      Matcher.setCaseSensitivity(cs);
+      Matcher.setPattern(needle);
+    }
+  }
+
+  int next(const QString &haystack, int from) const {
+    int n = Needle.length();
+    if (from < 0 || n == 0 || n > haystack.length() - from) {
+      return n == 0 && from >= 0 && from <= haystack.length() ? from : -1;
+    }
+    if (Cs == Qt::CaseInsensitive) {
+      return Matcher.indexIn(haystack, from);
+    }
+    return indexOfExact(haystack.utf16(), haystack.length(), Needle.utf16(), n, from);
+  }
+};
+
+QRegularExpression SearchEngine::pattern(const search_options_s &options) {
+  static QMutex mutex;
+  static QCache<QString, QRegularExpression> cache(CacheSize);
+  QString key = QString("%1%2%3:%4").arg(int(options.MatchCase)).arg(int(options.WholeWords))
+                                    .arg(int(options.RegExp)).arg(options.Text);
+  QMutexLocker lock(&mutex);
+  if (QRegularExpression* cached = cache.object(key)) {
+    return *cached;
+  }
+  QString pattern = options.RegExp ? options.Text : QRegularExpression::escape(options.Text);
+  if (options.WholeWords) {
+    pattern = QString("(?<![\\w@])(?:%1)(?![\\w@])").arg(pattern);
+  }
+  QRegularExpression::PatternOptions flags = QRegularExpression::UseUnicodePropertiesOption
+                                           | QRegularExpression::MultilineOption;
+  if (!options.MatchCase) {
+    flags |= QRegularExpression::CaseInsensitiveOption;
+  }
+  QRegularExpression* compiled = new QRegularExpression(pattern, flags);
+  // Compile it now, not on first use, so every copy shares the compiled (and JIT) version.
+  compiled->optimize();
+  cache.insert(key, compiled);
+  return *compiled;
+}
+
+QString SearchEngine::check(const search_options_s &options) {
+  QRegularExpression expression = pattern(options);
+  return expression.isValid() ? QString() : expression.errorString();
+}
+
+QStringList SearchEngine::requiredLiterals(const QString &pattern) {
+  // Conservative: anything that isn't obviously required (groups, classes, optional characters) is
+  // left out.
+  QStringList runs;
+  QString run;
+  int n = pattern.length();
+  auto flush = [&] {
+    if (!run.isEmpty()) {
+      runs.push_back(run);
+    }
+    run.clear();
+  };
+  // Skips the group or class opened at `i`.  Returns the index of the bracket that closes it.
+  auto skipBracket = [&](int i) {
+    int depth = 0;
+    for ( ; i < n; ++i) {
+      QChar ch = pattern[i];
+      if (ch == '\\') {
+        ++i;
+      } else if (ch == '[') {
+        // `]` straight after `[` or `[^` is part of the class, as are `[:alpha:]` and the like.
+        ++i;
+        if (i < n && pattern[i] == '^') {
+          ++i;
+        }
+        if (i < n && pattern[i] == ']') {
+          ++i;
+        }
+        for ( ; i < n && pattern[i] != ']'; ++i) {
+          if (pattern[i] == '\\') {
+            ++i;
+          } else if (pattern[i] == '[' && i + 1 < n && pattern[i + 1] == ':') {
+            i = pattern.indexOf(":]", i);
+            if (i == -1) {
+              return n;
+            }
+            ++i;
+          }
+        }
+        if (depth == 0) {
+          return i;
+        }
+      } else if (ch == '(') {
+        ++depth;
+      } else if (ch == ')' && --depth == 0) {
+        return i;
+      }
+    }
+    return n;
+  };
+  // With `(?x)` spaces and `#` don't mean what they say.
+  if (hasInlineFlag(pattern, 'x')) {
+    return QStringList();
+  }
+  for (int i = 0; i < n; ++i) {
+    QChar ch = pattern[i];
+    QChar next = i + 1 < n ? pattern[i + 1] : QChar();
+    if (ch == '|') {
+      return QStringList();
+    } else if (ch == '(' || ch == '[') {
+      flush();
+      i = skipBracket(i);
+    } else if (ch == '*' || ch == '?' || ch == '{') {
+      // The previous character might not be there at all.
+      run.chop(1);
+      flush();
+      if (ch == '{') {
+        while (i < n && pattern[i] != '}') {
+          ++i;
+        }
+      }
+    } else if (ch == '+') {
+      // It is there, but the next one might not follow straight after.
+      flush();
+    } else if (ch == '.' || ch == '^' || ch == '$' || ch == ')') {
+      flush();
+    } else if (ch == '\\' && (next == 'k' || next == 'g') && i + 2 < n
+               && (pattern[i + 2] == '<' || pattern[i + 2] == '\'' || pattern[i + 2] == '{')) {
+      // Back references and subroutines by name, `\k<name>`, `\k'name'`, `\g{name}` and so on.
+      // The name is not text to be found.
+      flush();
+      QChar open = pattern[i + 2];
+      QChar close = open == '<' ? '>' : open == '{' ? '}' : '\'';
+      int end = pattern.indexOf(close, i + 3);
+      i = end == -1 ? n : end;
+    } else if (ch == '\\' && next.isLetterOrNumber()) {
+      // `\d`, `\x41`, `\p{L}` and so on.  Skip everything that might be part of it.
+      flush();
+      ++i;
+      while (i + 1 < n && (pattern[i + 1].isLetterOrNumber() || pattern[i + 1] == '{' || pattern[i + 1] == '}')) {
+        ++i;
+      }
+    } else if (ch == '\\') {
+      if (i + 1 < n) {
+        run += next;
+        ++i;
+      }
+    } else {
+      run += ch;
+    }
+    // Lazy and possessive quantifiers.
+    if ((ch == '*' || ch == '?' || ch == '+' || ch == '{') && i + 1 < n
+        && (pattern[i + 1] == '?' || pattern[i + 1] == '+')) {
+      ++i;
+    }
+  }
+  flush();
+  return runs;
+}
+
+find_matches_t SearchEngine::findAll(const QString &text, const search_options_s &options,
+                                     const QAtomicInt *current, int generation) {
+  find_matches_t matches;
+  auto cancelled = [&](int i) {
+    return (i & 255) == 0 && current && current->load() != generation;
+  };
+  if (options.Text.isEmpty()) {
+    return matches;
+  }
+  if (!options.RegExp) {
+    literal_finder_s finder(options.Text, options.MatchCase ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    int length = options.Text.length();
+    int i = 0;
+    for (int at = finder.next(text, 0); at != -1; at = finder.next(text, at + length)) {
+      if (cancelled(++i)) {
+        break;
+      }
+      if (options.WholeWords && ((at > 0 && isWordChar(text[at - 1]))
+                                 || (at + length < text.length() && isWordChar(text[at + length])))) {
+        continue;
+      }
+      matches.push_back({ at, length });
+    }
+    return matches;
+  }
+  QRegularExpression expression = pattern(options);
+  if (!expression.isValid()) {
+    return matches;
+  }
+  // The longest piece of plain text every match has, to look for first.
+  QString literal;
+  for (auto const & run : requiredLiterals(options.Text)) {
+    if (run.length() > literal.length()) {
+      literal = run;
+    }
+  }
+  literal_finder_s finder(literal, options.MatchCase && !hasInlineFlag(options.Text, 'i')
+                                   ? Qt::CaseSensitive : Qt::CaseInsensitive);
+  int at = finder.next(text, 0);
+  if (!literal.isEmpty() && at == -1) {
+    return matches;
+  }
+  if (literal.isEmpty() || crossesLines(options.Text)) {
+    QRegularExpressionMatchIterator it = expression.globalMatch(text);
+    for (int i = 0; it.hasNext() && !cancelled(++i); ) {
+      QRegularExpressionMatch match = it.next();
+      // Patterns like `a*` match nothing everywhere, which isn't useful to list.
+      if (match.capturedLength() != 0) {
+        matches.push_back({ match.capturedStart(), match.capturedLength() });
+      }
+    }
+    return matches;
+  }
+  // Only run the expression over lines that have the text in.
+  for (int i = 0; at != -1 && !cancelled(++i); ) {
+    int start = text.lastIndexOf('\n', at) + 1;
+    int end = text.indexOf('\n', at);
+    if (end == -1) {
+      end = text.length();
+    }
+    QRegularExpressionMatchIterator it = expression.globalMatch(text.midRef(start, end - start));
+    while (it.hasNext()) {
+      QRegularExpressionMatch match = it.next();
+      if (match.capturedLength() != 0) {
+        matches.push_back({ start + match.capturedStart(), match.capturedLength() });
+      }
+    }
+    at = end < text.length() ? finder.next(text, end + 1) : -1;
+  }
+  return matches;
+}
+
+int SearchEngine::indexOf(const QString &haystack, const QString &needle, int from, Qt::CaseSensitivity cs) {
+  return literal_finder_s(needle, cs).next(haystack, from);
+}
@@ -0,0 +1,62 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include <QAtomicInt>
+#include <QPair>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct search_options_s {
+  QString Text;
+  bool MatchCase;
+  bool WholeWords;
+  bool RegExp;
+};
+
+// Start and length of each match, in order.
+typedef QVector<QPair<int, int>> find_matches_t;
+
+// The text searching behind Find, Replace, and Find in Files.  Patterns are compiled once and
+// cached, and regular expressions are only run where the plain text every match must contain has
+// already been found by a much faster scan.  Everything here is safe to call from any thread.
+class SearchEngine {
+ public:
+  // The compiled (and JIT optimised) expression that finds `options`.  Plain text is escaped, and
+  // whole words are wrapped in look-arounds.  `^` and `$` match at the ends of lines.
+  static QRegularExpression pattern(const search_options_s &options);
+
+  // Why `options` can't be searched for, or an empty string if they can.
+  static QString check(const search_options_s &options);
+
+  // Runs of plain text that every match of the regular expression `pattern` contains.  Empty when
+  // there aren't any that are certain, for example when there are alternatives at the top level.
+  static QStringList requiredLiterals(const QString &pattern);
+
+  // Every match in `text`.  Gives up early, returning whatever it has, if `current` stops holding
+  // `generation`.
+  static find_matches_t findAll(const QString &text, const search_options_s &options,
+                                const QAtomicInt *current = nullptr, int generation = 0);
+
+  // Where `needle` next appears in `haystack` at or after `from`, or -1.
+  static int indexOf(const QString &haystack, const QString &needle, int from,
+                     Qt::CaseSensitivity cs = Qt::CaseSensitive);
+};
+
+#endif // SEARCHENGINE_H
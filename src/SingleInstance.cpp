@@ -0,0 +1,148 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QRegularExpression>
+
+#include "SingleInstance.h"
+
+static const quint32 Magic = 0x51494E53; // `QINS`.
+static const quint32 Version = 1;
+
+// Long enough for a busy instance to get to its event loop, short enough not to notice when the
+// last one crashed and left its socket behind.
+static const int Timeout = 1000;
+
+SingleInstance::SingleInstance(QObject *parent)
+  : QObject(parent),
+    server_(new QLocalServer(this))
+{
+  connect(server_, SIGNAL(newConnection()), SLOT(newConnection()));
+}
+
+SingleInstance::~SingleInstance() {
+  // nothing
+}
+
+QString SingleInstance::serverName() {
+  QByteArray home = QDir::homePath().toUtf8();
+  return "qawno-" + QCryptographicHash::hash(home, QCryptographicHash::Md5).toHex().left(16);
+}
+
+open_file_s SingleInstance::parse(const QString &argument) {
+  open_file_s file { argument, 0, 1 };
+  // Windows paths have colons of their own, so only ever split off numbers, and not when there
+  // really is a file called that.
+  static const QRegularExpression position("^(.+?):(\\d+)(?::(\\d+))?$");
+  QRegularExpressionMatch match = position.match(argument);
+  if (match.hasMatch() && !QFileInfo::exists(argument)) {
+    file.Path = match.captured(1);
+    file.Line = match.captured(2).toInt();
+    if (match.lastCapturedIndex() == 3) {
+      file.Column = qMax(match.captured(3).toInt(), 1);
+    }
+  }
+  return file;
+}
+
+bool SingleInstance::forward(const QStringList &arguments) {
+  QLocalSocket socket;
+  socket.connectToServer(serverName());
+  if (!socket.waitForConnected(Timeout)) {
+    return false;
+  }
+  // The other one started somewhere else, so relative paths have to be made absolute here.
+  QStringList absolute;
+  for (auto const & argument : arguments) {
+    open_file_s file = parse(argument);
+    QString path = QFileInfo(file.Path).absoluteFilePath();
+    if (file.Line) {
+      path += QString(":%1:%2").arg(file.Line).arg(file.Column);
+    }
+    absolute.push_back(path);
+  }
+  QByteArray message;
+  QDataStream out(&message, QIODevice::WriteOnly);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << Magic << Version << absolute;
+  socket.write(message);
+  if (!socket.waitForBytesWritten(Timeout)) {
+    return false;
+  }
+  // Only gone once it says it has them, so nothing is lost if it was on its way out.
+  return socket.waitForReadyRead(Timeout) && socket.read(1) == "1";
+}
+
+bool SingleInstance::listen() {
+  if (server_->listen(serverName())) {
+    return true;
+  }
+  // A crash leaves the socket file behind on Unix, but only take it over if nobody answers on it.
+  QLocalSocket socket;
+  socket.connectToServer(serverName());
+  if (socket.waitForConnected(Timeout)) {
+    return false;
+  }
+  QLocalServer::removeServer(serverName());
+  return server_->listen(serverName());
+}
+
+void SingleInstance::newConnection() {
+  while (QLocalSocket* socket = server_->nextPendingConnection()) {
+    connect(socket, SIGNAL(readyRead()), SLOT(readyRead()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+  }
+}
+
+void SingleInstance::readyRead() {
+  QLocalSocket* socket = static_cast<QLocalSocket*>(sender());
+  QDataStream in(socket);
+  in.setVersion(QDataStream::Qt_5_0);
+  // The message may come in pieces, so wait for the rest of it.
+  in.startTransaction();
+  quint32 magic = 0, version = 0;
+  QStringList arguments;
+  in >> magic >> version >> arguments;
+  if (!in.commitTransaction()) {
+    return;
+  }
+  if (magic != Magic || version != Version) {
+    socket->abort();
+    return;
+  }
+  socket->write("1");
+  socket->flush();
+  if (holding_) {
+    // Answered straight away all the same, so the other one can go.
+    held_.push_back(arguments);
+    return;
+  }
+  emit received(arguments);
+}
+
+void SingleInstance::release() {
+  holding_ = false;
+  // Each as if it had only just arrived, in the order they came.
+  QList<QStringList> held;
+  held.swap(held_);
+  for (auto const & arguments : held) {
+    emit received(arguments);
+  }
+}
@@ -0,0 +1,73 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+
+// A file named on the command line, as `path`, `path:line`, or `path:line:column`.
+struct open_file_s {
+  QString Path;
+  int Line;   // From 1, or `0` for wherever it opens.
+  int Column; // From 1.
+};
+
+// Makes sure there is only one Qawno for each user.  Every later one hands its command line over a
+// local socket to the first and quits, long before it would have read any natives or opened any
+// tabs, so opening a file from the file manager is nearly instant and always ends up in the window
+// that already has everything loaded.
+class SingleInstance: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit SingleInstance(QObject *parent = 0);
+  ~SingleInstance() override;
+
+  // Sends `arguments` to the Qawno already running.  Returns `false` if there isn't one (or it
+  // didn't answer), in which case this is it.
+  bool forward(const QStringList &arguments);
+
+  // Starts listening for later ones.  What they send is held on to until `release`, so that nothing
+  // is lost while the window is still being made.
+  bool listen();
+
+  // Sends everything held so far, and from then on sends it as it arrives.
+  void release();
+
+  static open_file_s parse(const QString &argument);
+
+ signals:
+  // Every argument given to a later one, with the paths made absolute.  May be empty, when it was
+  // just started again to bring the window back.
+  void received(const QStringList &arguments);
+
+ private slots:
+  void newConnection();
+  void readyRead();
+
+ private:
+  // One per user, since one user can't open tabs in another's window.
+  static QString serverName();
+
+  QLocalServer *server_;
+  bool holding_ = true;
+  QList<QStringList> held_;
+};
+
+#endif // SINGLEINSTANCE_H
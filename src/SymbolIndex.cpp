@@ -0,0 +1,473 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+#include "FileLoader.h"
+#include "PawnLexer.h"
+#include "SymbolIndex.h"
+
+static const quint32 Magic = 0x5153594D; // `QSYM`.
+static const quint32 Version = 2; // 2: columns in characters, not bytes, for UTF-8 files.
+
+QDataStream &operator<<(QDataStream &out, const symbol_s &symbol) {
+  return out << symbol.Name << qint32(symbol.Kind) << qint32(symbol.Line) << qint32(symbol.Column);
+}
+
+QDataStream &operator>>(QDataStream &in, symbol_s &symbol) {
+  qint32 kind = 0, line = 0, column = 0;
+  in >> symbol.Name >> kind >> line >> column;
+  symbol.Kind = static_cast<symbol_kind_e>(kind);
+  symbol.Line = line;
+  symbol.Column = column;
+  return in;
+}
+
+QDataStream &operator<<(QDataStream &out, const symbol_file_s &file) {
+  return out << file.Path << file.Modified << file.Size << file.Symbols;
+}
+
+QDataStream &operator>>(QDataStream &in, symbol_file_s &file) {
+  return in >> file.Path >> file.Modified >> file.Size >> file.Symbols;
+}
+
+SymbolIndex::SymbolIndex(QObject *parent)
+  : QObject(parent),
+    cachePath_(cachePath())
+{
+  connect(&future_, SIGNAL(finished()), SLOT(finished()));
+}
+
+SymbolIndex::~SymbolIndex() {
+  // nothing
+}
+
+static bool isPunctuation(const QString &text, const pawn_token_s &token, char ch) {
+  return token.Type == pawn_token_punctuation && text[token.Start] == ch;
+}
+
+// `tokens[i]` opens a bracket.  Returns the index just past the one that closes it.
+static int skipGroup(const QString &text, const QVector<pawn_token_s> &tokens, int i) {
+  QChar open = text[tokens[i].Start];
+  QChar close = open == '(' ? ')' : open == '[' ? ']' : '}';
+  int depth = 0;
+  for (int n = tokens.size(); i < n; ++i) {
+    if (tokens[i].Type != pawn_token_punctuation) {
+      continue;
+    }
+    QChar ch = text[tokens[i].Start];
+    if (ch == open) {
+      ++depth;
+    } else if (ch == close && --depth == 0) {
+      return i + 1;
+    }
+  }
+  return i;
+}
+
+QVector<symbol_s> SymbolIndex::parse(const QString &text) {
+  QVector<symbol_s> symbols;
+  parseTokens(text, PawnLexer::tokenize(text), symbols, nullptr);
+  return symbols;
+}
+
+void SymbolIndex::reparse(const QString &text, symbol_buffer_s &buffer) {
+  const QString &old = buffer.Text;
+  int length = qMin(text.length(), old.length());
+  int same = static_cast<int>(std::mismatch(text.constData(), text.constData() + length,
+                                            old.constData()).first - text.constData());
+  if (same == text.length() && same == old.length()) {
+    return;
+  }
+  // The last checkpoint before the first difference is where the parser was when it got there,
+  // except that it may have peeked at a token or two past it to finish the statement before.  So
+  // go back one more, to be sure that nothing it decided before there could change.
+  int from = 0;
+  while (from < buffer.Checkpoints.size() && buffer.Checkpoints[from].Token.Start < same) {
+    ++from;
+  }
+  from = qMax(from - 2, 0);
+  QVector<pawn_token_s> tokens;
+  if (from < buffer.Checkpoints.size()) {
+    symbol_checkpoint_s const& checkpoint = buffer.Checkpoints[from];
+    buffer.Symbols.resize(checkpoint.Symbols);
+    tokens = PawnLexer::tokenize(text, checkpoint.Token);
+  } else {
+    buffer.Symbols.clear();
+    tokens = PawnLexer::tokenize(text);
+  }
+  buffer.Checkpoints.resize(from);
+  buffer.Text = text;
+  parseTokens(text, tokens, buffer.Symbols, &buffer.Checkpoints);
+}
+
+void SymbolIndex::parseTokens(const QString &text, const QVector<pawn_token_s> &tokens,
+                              QVector<symbol_s> &symbols, QVector<symbol_checkpoint_s> *checkpoints) {
+  // Not a real parser, just enough to find where things are declared at the top level.  Anything
+  // inside braces is a function body (or an initialiser, which is skipped over separately).
+  int n = tokens.size();
+  auto word = [&](int i) { return text.midRef(tokens[i].Start, tokens[i].Length); };
+  auto punctuation = [&](int i, char ch) { return i < n && isPunctuation(text, tokens[i], ch); };
+  auto identifier = [&](int i) { return i < n && tokens[i].Type == pawn_token_identifier; };
+  auto skipTag = [&](int i) { return identifier(i) && punctuation(i + 1, ':') ? i + 2 : i; };
+  auto add = [&](int i, symbol_kind_e kind) {
+    symbols.push_back({ word(i).toString(), kind, tokens[i].Line, tokens[i].Column });
+  };
+  int depth = 0;
+  int i = 0;
+  while (i < n) {
+    pawn_token_s const& token = tokens[i];
+    if (checkpoints && depth == 0 && token.LineStart) {
+      // Nothing from before here is carried over, so parsing can start again from this token.
+      checkpoints->push_back({ token, symbols.size() });
+    }
+    if (token.Type == pawn_token_punctuation) {
+      QChar ch = text[token.Start];
+      if (ch == '{') {
+        ++depth;
+      } else if (ch == '}' && depth > 0) {
+        --depth;
+      }
+      ++i;
+      continue;
+    }
+    if (token.Type == pawn_token_directive) {
+      // The whole directive, including any continuation lines, so braces in macros don't count.
+      int end = PawnLexer::directiveEnd(text, token.Start);
+      if (word(i).endsWith(QLatin1String("define")) && identifier(i + 1) && tokens[i + 1].Start < end) {
+        add(i + 1, symbol_kind_define);
+      }
+      ++i;
+      while (i < n && tokens[i].Start < end) {
+        ++i;
+      }
+      continue;
+    }
+    if (depth > 0 || token.Type != pawn_token_identifier) {
+      ++i;
+      continue;
+    }
+    if (word(i) == QLatin1String("enum")) {
+      // `enum Tag:E_NAME (+= 2) { E_ITEM, Float:E_OTHER[3] = 5 }`
+      int j = skipTag(i + 1);
+      if (identifier(j)) {
+        add(j, symbol_kind_enum);
+        ++j;
+      }
+      if (punctuation(j, '(')) {
+        j = skipGroup(text, tokens, j);
+      }
+      if (punctuation(j, '{')) {
+        int end = skipGroup(text, tokens, j);
+        bool expect = true;
+        int nest = 0;
+        for (int k = j + 1; k < end - 1; ++k) {
+          if (tokens[k].Type == pawn_token_punctuation) {
+            QChar ch = text[tokens[k].Start];
+            if (ch == '(' || ch == '[' || ch == '{') {
+              ++nest;
+            } else if (ch == ')' || ch == ']' || ch == '}') {
+              --nest;
+            } else if (nest == 0 && ch == ',') {
+              expect = true;
+            }
+          } else if (nest == 0 && expect && identifier(k)) {
+            if (punctuation(k + 1, ':')) {
+              // A tag, the name comes next.
+              ++k;
+            } else {
+              add(k, symbol_kind_constant);
+              expect = false;
+            }
+          }
+        }
+        j = end;
+      }
+      i = j;
+      continue;
+    }
+    // Declarations: `stock Float:Name(...) {`, `native Name(...);`, `new a, b[3] = {...};` etc.
+    bool isNative = false, isForward = false, isHook = false, isTimer = false, any = false;
+    int j = i;
+    for ( ; identifier(j); ++j) {
+      QStringRef specifier = word(j);
+      if (specifier == QLatin1String("native")) {
+        isNative = true;
+      } else if (specifier == QLatin1String("forward")) {
+        isForward = true;
+      } else if (specifier == QLatin1String("hook")) {
+        // y_hooks: many of these share the name of the callback they hook.
+        isHook = true;
+      } else if (specifier == QLatin1String("timer") || specifier == QLatin1String("task")
+                 || specifier == QLatin1String("ptask")) {
+        isTimer = true;
+      } else if (specifier != QLatin1String("new") && specifier != QLatin1String("static")
+                 && specifier != QLatin1String("const") && specifier != QLatin1String("stock")
+                 && specifier != QLatin1String("public")) {
+        break;
+      }
+      any = true;
+    }
+    // Without a specifier only `Name(...)` at the start of a line can be a definition, rather than
+    // a macro used at the top level.
+    if (!any && !token.LineStart) {
+      ++i;
+      continue;
+    }
+    j = skipTag(j);
+    if (!identifier(j)) {
+      i = qMax(j, i + 1);
+      continue;
+    }
+    int name = j++;
+    if (word(name) == QLatin1String("operator")) {
+      i = j;
+      continue;
+    }
+    if (isTimer && punctuation(j, '[')) {
+      // `timer Name[500](...)`
+      j = skipGroup(text, tokens, j);
+    }
+    if (punctuation(j, '(')) {
+      int after = skipGroup(text, tokens, j);
+      if (isNative) {
+        add(name, symbol_kind_native);
+      } else if (!isForward && !isHook && punctuation(after, '{')) {
+        add(name, symbol_kind_function);
+      }
+      i = after;
+      continue;
+    }
+    if (!any || isNative || isForward || isHook) {
+      i = j;
+      continue;
+    }
+    // Globals.  Semicolons are optional in Pawn, so a new line after something that can end an
+    // expression ends the declaration too.
+    add(name, symbol_kind_variable);
+    int nest = 0;
+    while (j < n) {
+      pawn_token_s const& t = tokens[j];
+      if (t.Type == pawn_token_directive) {
+        break;
+      } else if (t.Type == pawn_token_punctuation) {
+        QChar ch = text[t.Start];
+        if (nest == 0 && ch == ';') {
+          ++j;
+          break;
+        } else if (nest == 0 && ch == ',') {
+          j = skipTag(j + 1);
+          if (identifier(j)) {
+            add(j, symbol_kind_variable);
+            ++j;
+          }
+          continue;
+        } else if (ch == '(' || ch == '[' || ch == '{') {
+          ++nest;
+        } else if (nest > 0 && (ch == ')' || ch == ']' || ch == '}')) {
+          --nest;
+        }
+      } else if (nest == 0 && t.LineStart) {
+        pawn_token_s const& prev = tokens[j - 1];
+        if (prev.Type != pawn_token_punctuation || text[prev.Start] == ')'
+            || text[prev.Start] == ']' || text[prev.Start] == '}') {
+          break;
+        }
+      }
+      ++j;
+    }
+    i = j;
+  }
+}
+
+symbol_file_s SymbolIndex::parseFile(const QString &path) {
+  QFileInfo info(path);
+  symbol_file_s file { path, info.lastModified().toMSecsSinceEpoch(), info.size(), QVector<symbol_s>() };
+  if (file.Size == 0) {
+    return file;
+  }
+  // Decoded the same way as the editor would, so columns count the same characters it shows.
+  loaded_file_s loaded = FileLoader::read(path);
+  if (loaded.Error.isEmpty()) {
+    file.Symbols = parse(loaded.Text);
+  }
+  return file;
+}
+
+QString SymbolIndex::cachePath() {
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/symbols.bin";
+}
+
+QHash<QString, symbol_file_s> SymbolIndex::loadCache(const QString &cachePath) {
+  // The same layout as the natives cache: one mapping, deep-copied out.
+  QHash<QString, symbol_file_s> files;
+  QFile f{cachePath};
+  if (!f.open(QFile::ReadOnly) || f.size() == 0) {
+    return files;
+  }
+  uchar* mapped = f.map(0, f.size());
+  if (!mapped) {
+    return files;
+  }
+  QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<int>(f.size()));
+  QDataStream in(raw);
+  in.setVersion(QDataStream::Qt_5_0);
+  quint32 magic = 0, version = 0;
+  in >> magic >> version;
+  if (magic == Magic && version == Version) {
+    QVector<symbol_file_s> list;
+    in >> list;
+    if (in.status() == QDataStream::Ok) {
+      for (auto const & file : list) {
+        files.insert(file.Path, file);
+      }
+    }
+  }
+  f.unmap(mapped);
+  return files;
+}
+
+bool SymbolIndex::saveCache(const QString &cachePath, const QHash<QString, symbol_file_s> &files) {
+  QDir().mkpath(QFileInfo(cachePath).absolutePath());
+  QSaveFile f{cachePath};
+  if (!f.open(QFile::WriteOnly)) {
+    return false;
+  }
+  QDataStream out(&f);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << Magic << Version << files.values().toVector();
+  return f.commit();
+}
+
+symbol_result_s SymbolIndex::build(const QStringList &files, const QStringList &keep,
+                                   const QHash<QString, QString> &buffers,
+                                   QHash<QString, symbol_file_s> known,
+                                   QHash<QString, symbol_buffer_s> parsed, const QString &cachePath,
+                                   bool loadKnown, bool prune) {
+  if (loadKnown) {
+    // The first build starts from whatever was indexed last run.
+    known = loadCache(cachePath);
+  }
+  bool pruned = false;
+  if (prune) {
+    // Only keep what can still be seen from some open file, or the cache gets every file ever
+    // opened.
+    QSet<QString> reachable = files.toSet() + keep.toSet();
+    for (auto it = known.begin(); it != known.end(); ) {
+      if (reachable.contains(it.key())) {
+        ++it;
+      } else {
+        it = known.erase(it);
+        pruned = true;
+      }
+    }
+  }
+  QStringList stale;
+  for (auto const & path : files) {
+    if (buffers.contains(path)) {
+      continue;
+    }
+    auto it = known.find(path);
+    QFileInfo info(path);
+    if (!info.exists()) {
+      if (it != known.end()) {
+        known.erase(it);
+        pruned = true;
+      }
+    } else if (it == known.end() || it->Size != info.size()
+               || it->Modified != info.lastModified().toMSecsSinceEpoch()) {
+      stale.push_back(path);
+    }
+  }
+  if (!stale.isEmpty()) {
+    QVector<symbol_file_s> fresh =
+      QtConcurrent::blockingMapped<QVector<symbol_file_s>>(stale, &SymbolIndex::parseFile);
+    for (auto const & file : fresh) {
+      known.insert(file.Path, file);
+    }
+  }
+  if (!stale.isEmpty() || pruned) {
+    saveCache(cachePath, known);
+  }
+  symbol_result_s result;
+  for (auto const & path : files) {
+    auto it = known.constFind(path);
+    if (buffers.contains(path) || it == known.constEnd()) {
+      continue;
+    }
+    for (auto const & symbol : it->Symbols) {
+      result.Lookup[symbol.Name].push_back({ path, symbol.Kind, symbol.Line, symbol.Column });
+    }
+  }
+  // Open files are usually small next to the includes, and change all the time, so they are never
+  // cached on disk.  Between builds only the part after the latest edit is parsed again, and the
+  // ones that weren't edited at all not even that.
+  for (auto it = buffers.constBegin(); it != buffers.constEnd(); ++it) {
+    symbol_buffer_s buffer = parsed.value(it.key());
+    reparse(it.value(), buffer);
+    for (auto const & symbol : buffer.Symbols) {
+      result.Lookup[symbol.Name].push_back({ it.key(), symbol.Kind, symbol.Line, symbol.Column });
+    }
+    result.Buffers.insert(it.key(), buffer);
+  }
+  result.Files = known;
+  return result;
+}
+
+void SymbolIndex::update(const QStringList &files, const QStringList &keep,
+                         const QHash<QString, QString> &buffers) {
+  request_ = { files, keep, buffers };
+  if (future_.isRunning()) {
+    pending_ = true;
+    return;
+  }
+  // More arguments than `QtConcurrent::run` will pass along itself.
+  request_s request = request_;
+  QHash<QString, symbol_file_s> known = files_;
+  QHash<QString, symbol_buffer_s> parsed = buffers_;
+  QString cachePath = cachePath_;
+  bool loadKnown = !loaded_;
+  future_.setFuture(QtConcurrent::run([=]() {
+    return build(request.Files, request.Keep, request.Buffers, known, parsed, cachePath, loadKnown, true);
+  }));
+  loaded_ = true;
+  request_.Buffers.clear();
+}
+
+QVector<symbol_location_s> SymbolIndex::find(const QString &name) const {
+  return lookup_.value(name);
+}
+
+void SymbolIndex::finished() {
+  symbol_result_s result = future_.result();
+  files_ = result.Files;
+  buffers_ = result.Buffers;
+  lookup_ = result.Lookup;
+  emit updated();
+  if (pending_) {
+    pending_ = false;
+    update(request_.Files, request_.Keep, request_.Buffers);
+  }
+}
@@ -0,0 +1,146 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SYMBOLINDEX_H
+#define SYMBOLINDEX_H
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+#include "PawnLexer.h"
+
+// In order of preference when one name has several definitions.
+enum symbol_kind_e {
+  symbol_kind_function,
+  symbol_kind_native,
+  symbol_kind_define,
+  symbol_kind_enum,
+  symbol_kind_constant, // Enum items.
+  symbol_kind_variable,
+};
+
+struct symbol_s {
+  QString Name;
+  symbol_kind_e Kind;
+  int Line;   // From 0.
+  int Column; // From 0.
+};
+
+// Everything defined in one file, with what the file looked like when it was parsed.
+struct symbol_file_s {
+  QString Path;
+  qint64 Modified;
+  qint64 Size;
+  QVector<symbol_s> Symbols;
+};
+
+struct symbol_location_s {
+  QString Path; // Normalised, as by `IncludeGraph`.  Empty for an unsaved new file.
+  symbol_kind_e Kind;
+  int Line;
+  int Column;
+};
+
+// A place the parser can start again from: a line at the top level, and how many symbols came
+// before it.
+struct symbol_checkpoint_s {
+  pawn_token_s Token;
+  int Symbols;
+};
+
+// An open file as it was last parsed, so that the next parse can skip the part that hasn't changed.
+struct symbol_buffer_s {
+  QString Text;
+  QVector<symbol_s> Symbols;
+  QVector<symbol_checkpoint_s> Checkpoints;
+};
+
+struct symbol_result_s {
+  QHash<QString, symbol_file_s> Files;  // Only those read from disk, for the cache.
+  QHash<QString, symbol_buffer_s> Buffers;
+  QHash<QString, QVector<symbol_location_s>> Lookup;
+};
+
+// Where every function, native, define, enum, and global in a set of files is defined.  Files are
+// parsed in parallel, and the results kept on disk so that only changed files are read again.
+class SymbolIndex: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit SymbolIndex(QObject *parent = 0);
+  ~SymbolIndex() override;
+
+  // The definitions in some source.
+  static QVector<symbol_s> parse(const QString &text);
+  // The same for the new text of an open file, only parsing from the first top-level line before
+  // where it differs from what `buffer` was last given.
+  static void reparse(const QString &text, symbol_buffer_s &buffer);
+  // The same, straight from disk, with the stamps the cache checks.
+  static symbol_file_s parseFile(const QString &path);
+
+  static QString cachePath();
+  static QHash<QString, symbol_file_s> loadCache(const QString &cachePath);
+  static bool saveCache(const QString &cachePath, const QHash<QString, symbol_file_s> &files);
+
+  // Blocking, for workers.  `buffers` are editor contents that override the disk, keyed by
+  // normalised path, and `parsed` is how they were last parsed.  `known` is reused for any file
+  // that hasn't changed since.  With `loadKnown` set, `known` is read from `cachePath` first.  Any of
+  // `files` that are gone are dropped from `known` and the cache.  With `prune` set, so are files in
+  // neither `files` nor `keep`.
+  static symbol_result_s build(const QStringList &files, const QStringList &keep,
+                               const QHash<QString, QString> &buffers,
+                               QHash<QString, symbol_file_s> known,
+                               QHash<QString, symbol_buffer_s> parsed, const QString &cachePath,
+                               bool loadKnown, bool prune);
+
+  // Start indexing `files` in the background.  `updated` is emitted when it is done.  `keep` are
+  // other files still worth having in the cache, such as what the other tabs include, so that
+  // switching back to them doesn't read everything again.  Requests made while one is running
+  // replace any earlier pending request.
+  void update(const QStringList &files, const QStringList &keep, const QHash<QString, QString> &buffers);
+
+  // Every known definition of `name`.
+  QVector<symbol_location_s> find(const QString &name) const;
+
+ signals:
+  void updated();
+
+ private slots:
+  void finished();
+
+ private:
+  static void parseTokens(const QString &text, const QVector<pawn_token_s> &tokens,
+                          QVector<symbol_s> &symbols, QVector<symbol_checkpoint_s> *checkpoints);
+
+  struct request_s {
+    QStringList Files;
+    QStringList Keep;
+    QHash<QString, QString> Buffers;
+  };
+
+  QHash<QString, symbol_file_s> files_;
+  QHash<QString, symbol_buffer_s> buffers_;
+  QHash<QString, QVector<symbol_location_s>> lookup_;
+  QFutureWatcher<symbol_result_s> future_;
+  QString cachePath_;
+  bool loaded_ = false;
+  bool pending_ = false;
+  request_s request_;
+};
+
+#endif // SYMBOLINDEX_H
@@ -0,0 +1,348 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTextCodec>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+#include <string.h>
+
+#include "FileLoader.h"
+#include "SearchEngine.h"
+#include "TrigramIndex.h"
+
+static const quint32 Magic = 0x51545249; // `QTRI`.
+static const quint32 Version = 2; // 2: UTF-8 files converted to Windows-1251 first.
+
+// How many files to index from the directories, before leaving the rest to be searched without it.
+// Each one is watched, and there are only so many of those to go round.
+static const int MaxFiles = 8000;
+
+// Files bigger than this are de-duplicated with a bitmap of every possible trigram, rather than by
+// sorting every one they contain.
+static const qint64 BitmapSize = 256 * 1024;
+
+QDataStream &operator<<(QDataStream &out, const trigram_file_s &file) {
+  return out << file.Path << file.Modified << file.Size << file.Trigrams;
+}
+
+QDataStream &operator>>(QDataStream &in, trigram_file_s &file) {
+  return in >> file.Path >> file.Modified >> file.Size >> file.Trigrams;
+}
+
+// Maps every Windows-1251 byte to its lower-case version, so Cyrillic folds the same as ASCII.
+static const uchar* lowerBytes() {
+  static const QByteArray table = [] {
+    QTextCodec* codec = QTextCodec::codecForName("Windows-1251");
+    QByteArray bytes(256, 0);
+    for (int i = 0; i != 256; ++i) {
+      bytes[i] = static_cast<char>(i);
+      QString lower = codec->toUnicode(bytes.constData() + i, 1).toLower();
+      if (codec->canEncode(lower)) {
+        QByteArray encoded = codec->fromUnicode(lower);
+        if (encoded.size() == 1) {
+          bytes[i] = encoded[0];
+        }
+      }
+    }
+    return bytes;
+  }();
+  return reinterpret_cast<const uchar*>(table.constData());
+}
+
+static void addTrigrams(const QByteArray &bytes, QVector<quint32> &trigrams) {
+  const uchar* lower = lowerBytes();
+  for (int i = 2; i < bytes.size(); ++i) {
+    trigrams.push_back(lower[uchar(bytes[i - 2])] << 16 | lower[uchar(bytes[i - 1])] << 8 | lower[uchar(bytes[i])]);
+  }
+}
+
+TrigramIndex::TrigramIndex(QObject *parent)
+  : QObject(parent),
+    cachePath_(cachePath())
+{
+  timer_.setSingleShot(true);
+  timer_.setInterval(500);
+  connect(&watcher_, SIGNAL(directoryChanged(QString)), &timer_, SLOT(start()));
+  // Edits in place only change the file, not the directory it is in.
+  connect(&watcher_, SIGNAL(fileChanged(QString)), &timer_, SLOT(start()));
+  connect(&timer_, SIGNAL(timeout()), SLOT(update()));
+  connect(&future_, SIGNAL(finished()), SLOT(finished()));
+}
+
+TrigramIndex::~TrigramIndex() {
+  // nothing
+}
+
+trigram_file_s TrigramIndex::parseFile(const QString &path) {
+  QFileInfo info(path);
+  trigram_file_s file { path, info.lastModified().toMSecsSinceEpoch(), info.size(), {} };
+  QFile f{path};
+  if (!f.open(QFile::ReadOnly) || file.Size < 3) {
+    return file;
+  }
+  QByteArray buffer;
+  uchar* mapped = f.map(0, file.Size);
+  const uchar* data = mapped;
+  qint64 size = file.Size;
+  if (!mapped) {
+    buffer = f.readAll();
+    data = reinterpret_cast<const uchar*>(buffer.constData());
+    size = buffer.size();
+  }
+  const char* bytes = reinterpret_cast<const char*>(data);
+  if ((size >= 3 && memcmp(bytes, "\xEF\xBB\xBF", 3) == 0)
+      || FileLoader::detect(bytes, size) == file_encoding_utf8) {
+    // Searches are turned in to Windows-1251 trigrams, so UTF-8 is too.  Anything that can't be
+    // written that way can't be searched for with the index's help anyway.
+    loaded_file_s decoded;
+    FileLoader::decode(bytes, size, decoded);
+    buffer = QTextCodec::codecForName("Windows-1251")->fromUnicode(decoded.Text);
+    if (mapped) {
+      f.unmap(mapped);
+      mapped = nullptr;
+    }
+    data = reinterpret_cast<const uchar*>(buffer.constData());
+    size = buffer.size();
+  }
+  const uchar* lower = lowerBytes();
+  quint32 trigram = 0;
+  if (size > BitmapSize) {
+    QVector<quint64> seen(1 << 18, 0);
+    for (qint64 i = 0; i != size; ++i) {
+      trigram = (trigram << 8 | lower[data[i]]) & 0xFFFFFF;
+      if (i >= 2) {
+        seen[trigram >> 6] |= Q_UINT64_C(1) << (trigram & 63);
+      }
+    }
+    // Reading the bitmap back in order gives them sorted for free.
+    for (int word = 0; word != seen.size(); ++word) {
+      if (quint64 bits = seen[word]) {
+        for (int bit = 0; bit != 64; ++bit) {
+          if (bits >> bit & 1) {
+            file.Trigrams.push_back(quint32(word) << 6 | bit);
+          }
+        }
+      }
+    }
+  } else {
+    file.Trigrams.reserve(static_cast<int>(size));
+    for (qint64 i = 0; i != size; ++i) {
+      trigram = (trigram << 8 | lower[data[i]]) & 0xFFFFFF;
+      if (i >= 2) {
+        file.Trigrams.push_back(trigram);
+      }
+    }
+    std::sort(file.Trigrams.begin(), file.Trigrams.end());
+    file.Trigrams.erase(std::unique(file.Trigrams.begin(), file.Trigrams.end()), file.Trigrams.end());
+    file.Trigrams.squeeze();
+  }
+  if (mapped) {
+    f.unmap(mapped);
+  }
+  return file;
+}
+
+QVector<quint32> TrigramIndex::required(const search_options_s &options) {
+  QTextCodec* codec = QTextCodec::codecForName("Windows-1251");
+  QStringList runs = options.RegExp ? SearchEngine::requiredLiterals(options.Text) : QStringList(options.Text);
+  QVector<quint32> trigrams;
+  for (auto const & run : runs) {
+    // Text that can't be written in Windows-1251 isn't in the index (UTF-8 files are converted),
+    // so it can't narrow anything down.
+    if (codec->canEncode(run)) {
+      addTrigrams(codec->fromUnicode(run), trigrams);
+    }
+  }
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+  return trigrams;
+}
+
+QString TrigramIndex::cachePath() {
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/trigrams.bin";
+}
+
+QHash<QString, trigram_file_s> TrigramIndex::loadCache(const QString &cachePath) {
+  QHash<QString, trigram_file_s> files;
+  QFile f{cachePath};
+  if (!f.open(QFile::ReadOnly) || f.size() == 0) {
+    return files;
+  }
+  uchar* mapped = f.map(0, f.size());
+  if (!mapped) {
+    return files;
+  }
+  QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<int>(f.size()));
+  QDataStream in(raw);
+  in.setVersion(QDataStream::Qt_5_0);
+  quint32 magic = 0, version = 0;
+  in >> magic >> version;
+  if (magic == Magic && version == Version) {
+    QVector<trigram_file_s> list;
+    in >> list;
+    if (in.status() == QDataStream::Ok) {
+      for (auto const & file : list) {
+        files.insert(file.Path, file);
+      }
+    }
+  }
+  f.unmap(mapped);
+  return files;
+}
+
+bool TrigramIndex::saveCache(const QString &cachePath, const QHash<QString, trigram_file_s> &files) {
+  QDir().mkpath(QFileInfo(cachePath).absolutePath());
+  QSaveFile f{cachePath};
+  if (!f.open(QFile::WriteOnly)) {
+    return false;
+  }
+  QDataStream out(&f);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << Magic << Version << files.values().toVector();
+  return f.commit();
+}
+
+QHash<QString, trigram_file_s> TrigramIndex::build(const QStringList &directories, const QStringList &files,
+                                                   QHash<QString, trigram_file_s> known,
+                                                   const QString &cachePath, bool loadKnown) {
+  if (loadKnown) {
+    known = loadCache(cachePath);
+  }
+  QStringList all = FileSearch::files(directories, MaxFiles);
+  QSet<QString> seen = all.toSet();
+  for (auto const & path : files) {
+    if (!seen.contains(path)) {
+      seen.insert(path);
+      all.push_back(path);
+    }
+  }
+  QHash<QString, trigram_file_s> result;
+  QStringList stale;
+  for (auto const & path : all) {
+    auto it = known.constFind(path);
+    QFileInfo info(path);
+    if (!info.isFile()) {
+      continue;
+    } else if (it == known.constEnd() || it->Size != info.size()
+        || it->Modified != info.lastModified().toMSecsSinceEpoch()) {
+      stale.push_back(path);
+    } else {
+      result.insert(path, *it);
+    }
+  }
+  if (!stale.isEmpty()) {
+    QVector<trigram_file_s> parsed =
+      QtConcurrent::blockingMapped<QVector<trigram_file_s>>(stale, &TrigramIndex::parseFile);
+    for (auto const & file : parsed) {
+      result.insert(file.Path, file);
+    }
+  }
+  // Deleted files are dropped too, as are files that are no longer open or included.
+  if (!stale.isEmpty() || result.size() != known.size()) {
+    saveCache(cachePath, result);
+  }
+  return result;
+}
+
+bool TrigramIndex::mayContain(const QHash<QString, trigram_file_s> &index, const QString &path,
+                              const QVector<quint32> &trigrams) {
+  if (trigrams.isEmpty()) {
+    return true;
+  }
+  auto it = index.constFind(path);
+  if (it == index.constEnd()) {
+    return true;
+  }
+  QFileInfo info(path);
+  if (it->Size != info.size() || it->Modified != info.lastModified().toMSecsSinceEpoch()) {
+    return true;
+  }
+  for (quint32 trigram : trigrams) {
+    if (!std::binary_search(it->Trigrams.constBegin(), it->Trigrams.constEnd(), trigram)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TrigramIndex::setSources(QStringList directories, QStringList files) {
+  directories.sort();
+  files.sort();
+  if (directories == directories_ && files == sources_) {
+    return;
+  }
+  directories_ = directories;
+  sources_ = files;
+  update();
+}
+
+const QHash<QString, trigram_file_s> &TrigramIndex::files() const {
+  return files_;
+}
+
+void TrigramIndex::refresh() {
+  timer_.start();
+}
+
+void TrigramIndex::update() {
+  if (future_.isRunning()) {
+    pending_ = true;
+    return;
+  }
+  future_.setFuture(QtConcurrent::run(&TrigramIndex::build, directories_, sources_, files_, cachePath_,
+                                      !loaded_));
+  loaded_ = true;
+}
+
+void TrigramIndex::finished() {
+  files_ = future_.result();
+  // Watch every file, for edits, and every directory with a file in, for new, removed, and renamed
+  // files.  Only what has changed since last time is added or taken off.
+  QSet<QString> wanted = directories_.toSet();
+  for (auto it = files_.constBegin(); it != files_.constEnd(); ++it) {
+    wanted.insert(it.key());
+    wanted.insert(QFileInfo(it.key()).absolutePath());
+  }
+  QSet<QString> watched = (watcher_.directories() + watcher_.files()).toSet();
+  QStringList gone = (watched - wanted).toList();
+  if (!gone.isEmpty()) {
+    watcher_.removePaths(gone);
+  }
+  // Indexed files were there a moment ago on the worker, but the directories asked for might not be.
+  QSet<QString> requested = directories_.toSet();
+  QStringList added;
+  for (auto const & path : wanted - watched) {
+    if (!requested.contains(path) || QFileInfo(path).isDir()) {
+      added.push_back(path);
+    }
+  }
+  if (!added.isEmpty()) {
+    watcher_.addPaths(added);
+  }
+  if (pending_) {
+    pending_ = false;
+    update();
+  }
+}
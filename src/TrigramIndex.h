@@ -0,0 +1,99 @@
+// This file is part of qawno.
+//
+// qawno is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// qawno is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with qawno. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include "FileSearch.h"
+
+// Every run of three bytes in one file, with what the file looked like when it was read.
+struct trigram_file_s {
+  QString Path;
+  qint64 Modified;
+  qint64 Size;
+  QVector<quint32> Trigrams; // Sorted, and lower-cased so that one index serves either case.
+};
+
+// An index of which three-byte sequences appear in each Pawn file in a few directories (and the
+// ones below them), plus any others they include, so that Find in Files only has to read the files
+// that could possibly match.  Only the first several thousand files are indexed, so a script saved
+// somewhere like the home folder doesn't mean reading everything under it; the rest are simply
+// searched without the help.  Kept on disk between runs, and every indexed file and directory is
+// watched, so it is brought up to date a changed file at a time as they change.
+class TrigramIndex: public QObject {
+ Q_OBJECT
+
+ public:
+  explicit TrigramIndex(QObject *parent = 0);
+  ~TrigramIndex() override;
+
+  static trigram_file_s parseFile(const QString &path);
+
+  // The trigrams any match for `options` must contain.  Empty when the search can't be narrowed
+  // down (short text, or a pattern with alternatives).
+  static QVector<quint32> required(const search_options_s &options);
+
+  static QString cachePath();
+  static QHash<QString, trigram_file_s> loadCache(const QString &cachePath);
+  static bool saveCache(const QString &cachePath, const QHash<QString, trigram_file_s> &files);
+
+  // Blocking, for workers.  Returns the index for the files in `directories` and every one of
+  // `files`, reusing `known` for any that haven't changed.  With `loadKnown` set, `known` is
+  // read from `cachePath` first.
+  static QHash<QString, trigram_file_s> build(const QStringList &directories, const QStringList &files,
+                                              QHash<QString, trigram_file_s> known,
+                                              const QString &cachePath, bool loadKnown);
+
+  // Whether the file at `path` could contain all of `trigrams`, according to `index`.  Always true
+  // for files that aren't indexed yet or have changed since they were.  Checks the file's stamps,
+  // so is for workers.
+  static bool mayContain(const QHash<QString, trigram_file_s> &index, const QString &path,
+                         const QVector<quint32> &trigrams);
+
+  // Index (and watch) the files in these directories, plus these files.  Does nothing if they are
+  // the ones already indexed.
+  void setSources(QStringList directories, QStringList files);
+
+  // What has been indexed so far, to hand to `mayContain` on a worker.
+  const QHash<QString, trigram_file_s> &files() const;
+
+  // Check for changes soon, for files that were changed before they were being watched.
+  void refresh();
+
+ private slots:
+  void update();
+  void finished();
+
+ private:
+  QHash<QString, trigram_file_s> files_;
+  QFutureWatcher<QHash<QString, trigram_file_s>> future_;
+  QFileSystemWatcher watcher_;
+  QTimer timer_;
+  QStringList directories_;
+  QStringList sources_;
+  QString cachePath_;
+  bool loaded_ = false;
+  bool pending_ = false;
+};
+
+#endif // TRIGRAMINDEX_H
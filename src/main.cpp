@@ -15,10 +15,13 @@
 
 #include <QApplication>
 #include <QCoreApplication>
+#include <QSettings>
 #include <QTranslator>
 
 #include <qawno.h>
+#include "CommandLine.h"
 #include "MainWindow.h"
+#include "SingleInstance.h"
 
 #include <string.h>
 
@@ -36,17 +39,52 @@ public:
   }
 };
 
-int main(int argc, char **argv) {
-  QApplication app(argc, argv);
-
+// The same settings and caches with or without a window.
+static void setApplicationDetails() {
   QCoreApplication::setApplicationName("Qawno");
   QCoreApplication::setApplicationVersion(QAWNO_VERSION_STRING);
   QCoreApplication::setOrganizationName("Zeex");
   QCoreApplication::setOrganizationDomain("zeex.github.io");
   QCoreApplication::installTranslator(new ColourTranslator());
+}
+
+int main(int argc, char **argv) {
+  if (CommandLine::wanted(argc, argv)) {
+    // No `QApplication`, so no display is needed.
+    QCoreApplication app(argc, argv);
+    setApplicationDetails();
+    return CommandLine::run();
+  }
+
+  // Before anything else, so a second launch is gone before it has done anything it doesn't need.
+  // Only a `QCoreApplication` for that, so it doesn't even connect to the display or load the
+  // platform plugins first.
+  bool single = false;
+  {
+    QCoreApplication forwarding(argc, argv);
+    setApplicationDetails();
+    single = QSettings().value("SingleInstance", true).toBool();
+    if (single && SingleInstance().forward(forwarding.arguments().mid(1))) {
+      return 0;
+    }
+  }
+
+  QApplication app(argc, argv);
+  setApplicationDetails();
+
+  // Listening already, so a launch while the window is being made (which can take a while with a
+  // big session, or sit waiting on the crash recovery question) doesn't start a second Qawno.
+  SingleInstance instance;
+  if (single) {
+    instance.listen();
+  }
 
   MainWindow mainWindow;
   mainWindow.show();
+  if (single) {
+    QObject::connect(&instance, SIGNAL(received(QStringList)), &mainWindow, SLOT(openFiles(QStringList)));
+    instance.release();
+  }
 
   return app.exec();
 }